@@ -109,13 +109,20 @@ int osal_thread_create(void *thandle, int stacksize, void *func, void *param)
    pthread_attr_init(&attr);
    pthread_attr_setstacksize(&attr, stacksize);
    ret = pthread_create(threadp, &attr, func, param);
-   if(ret < 0)
+   pthread_attr_destroy(&attr);
+   /* pthread_create returns an error number, not -1 */
+   if(ret != 0)
    {
       return 0;
    }
    return 1;
 }
 
+int osal_thread_join(void *thandle)
+{
+   return pthread_join(*(pthread_t *)thandle, NULL) == 0;
+}
+
 int osal_thread_create_rt(void *thandle, int stacksize, void *func, void *param)
 {
    int                  ret;
@@ -128,7 +135,7 @@ int osal_thread_create_rt(void *thandle, int stacksize, void *func, void *param)
    pthread_attr_setstacksize(&attr, stacksize);
    ret = pthread_create(threadp, &attr, func, param);
    pthread_attr_destroy(&attr);
-   if(ret < 0)
+   if(ret != 0)
    {
       return 0;
    }
@@ -263,6 +263,25 @@ int ecx_outframe_red(ecx_portt *port, int idx)
    	return rval;
 }
 
+/** Transmit a batch of buffers. This driver has no batched send, the frames
+ * are transmitted one by one with ecx_outframe_red().
+ * @param[in] port        = port context struct
+ * @param[in] idxlist     = indexes in tx buffer array, in transmit order
+ * @param[in] n           = number of indexes in idxlist
+ * @return number of frames passed to the driver
+ */
+int ecx_outframe_multi(ecx_portt *port, const uint8 *idxlist, int n)
+{
+   int i;
+
+   for (i = 0; i < n; i++)
+   {
+      ecx_outframe_red(port, idxlist[i]);
+   }
+
+   return n;
+}
+
 /** Non blocking read of socket. Put frame in temporary buffer.
  * @param[in] port        = port context struct
  * @param[in] stacknumber = 0=primary 1=secondary stack
@@ -544,6 +563,11 @@ int ec_outframe_red(int idx)
    return ecx_outframe_red(&ecx_port, idx);
 }
 
+int ec_outframe_multi(const uint8 *idxlist, int n)
+{
+   return ecx_outframe_multi(&ecx_port, idxlist, n);
+}
+
 int ec_inframe(int idx, int stacknumber)
 {
    return ecx_inframe(&ecx_port, idx, stacknumber);
@@ -49,6 +49,31 @@ typedef struct
    	ec_bufT tempinbuf;
 } ecx_redportt;
 
+/** destination of the process data of a pending frame, kept for the portable
+ * core, this driver leaves the data in the rx buffer */
+typedef struct
+{
+   /** destination, NULL to keep the data in the rx buffer */
+   uint8       *dest;
+   /** offset of the data in the frame without ethernet header */
+   uint16      offset;
+   /** data length */
+   uint16      length;
+   /** work counter the frame has to return with, 0 = not checked */
+   uint16      expectedwkc;
+   /** data was copied to the destination on receive, always FALSE here */
+   boolean     done;
+} ec_rxdestt;
+
+/** payload copies made by the receive path */
+typedef struct
+{
+   /** number of copies */
+   uint64      copies;
+   /** bytes copied */
+   uint64      bytes;
+} ec_copystatt;
+
 /** pointer structure to buffers, vars and mutexes for port instantiation */
 typedef struct
 {
@@ -78,6 +103,10 @@ typedef struct
    	int redstate;
    	/** pointer to redundancy port and buffers */
    	ecx_redportt *redport;
+   	/** direct receive destinations, set by the process data send */
+   	ec_rxdestt rxdest[EC_MAXBUF];
+   	/** receive copy statistics */
+   	ec_copystatt copystat;
 
 	/** Device id in the device pool */
 	int dev_id;
@@ -98,6 +127,7 @@ void ec_setbufstat(int idx, int bufstat);
 int ec_getindex(void);
 int ec_outframe(int idx, int sock);
 int ec_outframe_red(int idx);
+int ec_outframe_multi(const uint8 *idxlist, int n);
 int ec_waitinframe(int idx, int timeout);
 int ec_srconfirm(int idx,int timeout);
 int ec_inframe(int idx, int stacknumber);
@@ -110,6 +140,7 @@ void ecx_setbufstat(ecx_portt *port, int idx, int bufstat);
 int ecx_getindex(ecx_portt *port);
 int ecx_outframe(ecx_portt *port, int idx, int sock);
 int ecx_outframe_red(ecx_portt *port, int idx);
+int ecx_outframe_multi(ecx_portt *port, const uint8 *idxlist, int n);
 int ecx_waitinframe(ecx_portt *port, int idx, int timeout);
 int ecx_srconfirm(ecx_portt *port, int idx,int timeout);
 
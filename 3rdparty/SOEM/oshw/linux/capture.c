@@ -0,0 +1,285 @@
+/*
+ * Licensed under the GNU General Public License version 2 with exceptions. See
+ * LICENSE file in the project root for full license information
+ */
+
+/** \file
+ * \brief
+ * Capture ring of EtherCAT frames.
+ *
+ * Every frame sent or received by a port is copied with a timestamp into a
+ * preallocated ring that keeps the most recent frames. Writing is lock free
+ * and does not allocate, so it can stay enabled in the realtime loop. A slot
+ * is reserved with an atomic increment and guarded by a sequence number, odd
+ * while the slot is written. The ring is written to a pcapng file from a non
+ * realtime thread, records that are overwritten during the dump are skipped.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "oshw.h"
+#include "osal.h"
+#include "capture.h"
+
+/** pcapng block types */
+#define PCAPNG_SHB   0x0A0D0D0A
+#define PCAPNG_IDB   0x00000001
+#define PCAPNG_EPB   0x00000006
+/** pcapng option codes */
+#define PCAPNG_OPT_END       0
+#define PCAPNG_OPT_IFNAME    2
+#define PCAPNG_OPT_TSRESOL   9
+#define PCAPNG_OPT_EPBFLAGS  2
+/** pcapng link type ethernet */
+#define PCAPNG_LINKTYPE_ETH  1
+
+/** Allocate capture ring of a port. Call before cyclic operation.
+ * @param[in] port        = port context struct
+ * @param[in] nframes     = number of frames kept, 0 disables capture
+ * @return >0 if OK
+ */
+int ecx_capture_init(ecx_portt *port, int nframes)
+{
+   ec_capturet *cap;
+
+   ecx_capture_close(port);
+   if (nframes <= 0)
+   {
+      return 1;
+   }
+   cap = calloc(1, sizeof(ec_capturet));
+   if (cap == NULL)
+   {
+      return 0;
+   }
+   cap->rec = calloc(nframes, sizeof(ec_capturerect));
+   if (cap->rec == NULL)
+   {
+      free(cap);
+      return 0;
+   }
+   cap->size = nframes;
+   __atomic_store_n(&(port->capture), cap, __ATOMIC_RELEASE);
+
+   return 1;
+}
+
+/** Release capture ring of a port. Call when cyclic operation has stopped.
+ * @param[in] port        = port context struct
+ */
+void ecx_capture_close(ecx_portt *port)
+{
+   ec_capturet *cap;
+
+   cap = __atomic_exchange_n(&(port->capture), NULL, __ATOMIC_ACQ_REL);
+   if (cap)
+   {
+      free(cap->rec);
+      free(cap);
+   }
+}
+
+/** Copy frame into capture ring. Lock free, does nothing if capture is disabled.
+ * @param[in] port        = port context struct
+ * @param[in] flags       = EC_CAPTURE_ flags
+ * @param[in] frame       = frame including ethernet header
+ * @param[in] length      = frame length
+ */
+void ecx_capture(ecx_portt *port, uint32 flags, const void *frame, int length)
+{
+   ec_capturet *cap;
+   ec_capturerect *rec;
+   struct timespec ts;
+   uint64 pos;
+
+   cap = __atomic_load_n(&(port->capture), __ATOMIC_ACQUIRE);
+   if ((cap == NULL) || (length <= 0))
+   {
+      return;
+   }
+   if (length > (int)sizeof(ec_bufT))
+   {
+      length = sizeof(ec_bufT);
+   }
+   clock_gettime(CLOCK_REALTIME, &ts);
+   pos = __atomic_fetch_add(&(cap->head), 1, __ATOMIC_RELAXED);
+   rec = &(cap->rec[pos % cap->size]);
+   __atomic_store_n(&(rec->seq), 2 * pos + 1, __ATOMIC_RELAXED);
+   __atomic_thread_fence(__ATOMIC_RELEASE);
+   rec->time = (uint64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+   rec->flags = flags;
+   rec->length = length;
+   memcpy(&(rec->frame), frame, length);
+   __atomic_store_n(&(rec->seq), 2 * pos + 2, __ATOMIC_RELEASE);
+}
+
+static int pcapng_write_idb(FILE *f, const char *name)
+{
+   uint32 hdr[4];
+   uint16 opt[2];
+   uint8 tsresol[4] = {9, 0, 0, 0};
+   uint8 namebuf[32];
+   uint32 namelen, padlen, total;
+
+   namelen = strlen(name);
+   if (namelen > sizeof(namebuf))
+   {
+      namelen = sizeof(namebuf);
+   }
+   padlen = (namelen + 3) & ~3U;
+   memset(namebuf, 0, sizeof(namebuf));
+   memcpy(namebuf, name, namelen);
+   total = 16 + 4 + padlen + 4 + 4 + 4 + 4;
+   hdr[0] = PCAPNG_IDB;
+   hdr[1] = total;
+   hdr[2] = PCAPNG_LINKTYPE_ETH;
+   hdr[3] = sizeof(ec_bufT);
+   fwrite(hdr, sizeof(hdr), 1, f);
+   opt[0] = PCAPNG_OPT_IFNAME;
+   opt[1] = namelen;
+   fwrite(opt, sizeof(opt), 1, f);
+   fwrite(namebuf, padlen, 1, f);
+   opt[0] = PCAPNG_OPT_TSRESOL;
+   opt[1] = 1;
+   fwrite(opt, sizeof(opt), 1, f);
+   fwrite(tsresol, sizeof(tsresol), 1, f);
+   opt[0] = PCAPNG_OPT_END;
+   opt[1] = 0;
+   fwrite(opt, sizeof(opt), 1, f);
+
+   return (fwrite(&total, sizeof(total), 1, f) == 1);
+}
+
+static int pcapng_write_epb(FILE *f, const ec_capturerect *rec)
+{
+   uint32 hdr[7];
+   uint16 opt[2];
+   uint32 epbflags, total, padlen;
+   static const uint8 pad[4] = {0, 0, 0, 0};
+
+   padlen = (rec->length + 3) & ~3U;
+   total = 28 + padlen + 4 + 4 + 4 + 4;
+   hdr[0] = PCAPNG_EPB;
+   hdr[1] = total;
+   hdr[2] = (rec->flags & EC_CAPTURE_SECONDARY) ? 1 : 0;
+   hdr[3] = (uint32)(rec->time >> 32);
+   hdr[4] = (uint32)rec->time;
+   hdr[5] = rec->length;
+   hdr[6] = rec->length;
+   fwrite(hdr, sizeof(hdr), 1, f);
+   fwrite(&(rec->frame), rec->length, 1, f);
+   fwrite(pad, padlen - rec->length, 1, f);
+   /* direction: 1 = inbound, 2 = outbound */
+   epbflags = (rec->flags & EC_CAPTURE_TX) ? 2 : 1;
+   opt[0] = PCAPNG_OPT_EPBFLAGS;
+   opt[1] = sizeof(epbflags);
+   fwrite(opt, sizeof(opt), 1, f);
+   fwrite(&epbflags, sizeof(epbflags), 1, f);
+   opt[0] = PCAPNG_OPT_END;
+   opt[1] = 0;
+   fwrite(opt, sizeof(opt), 1, f);
+
+   return (fwrite(&total, sizeof(total), 1, f) == 1);
+}
+
+/** Write capture ring to pcapng file, oldest frame first. Do not call from
+ * the realtime thread, the file is written synchronously.
+ * Interface 0 is the primary port, interface 1 the secondary port.
+ * @param[in] port        = port context struct
+ * @param[in] filename    = pcapng file to create
+ * @return number of frames written, -1 on error
+ */
+int ecx_capture_dump(ecx_portt *port, const char *filename)
+{
+   ec_capturet *cap;
+   ec_capturerect *rec;
+   FILE *f;
+   uint64 head, pos, seq;
+   uint32 shb[7];
+   int cnt;
+
+   cap = __atomic_load_n(&(port->capture), __ATOMIC_ACQUIRE);
+   if (cap == NULL)
+   {
+      return -1;
+   }
+   rec = malloc(sizeof(ec_capturerect));
+   if (rec == NULL)
+   {
+      return -1;
+   }
+   f = fopen(filename, "wb");
+   if (f == NULL)
+   {
+      free(rec);
+      return -1;
+   }
+   shb[0] = PCAPNG_SHB;
+   shb[1] = sizeof(shb);
+   shb[2] = 0x1A2B3C4D;
+   shb[3] = 0x00000001; /* version 1.0 */
+   shb[4] = 0xFFFFFFFF; /* section length unknown */
+   shb[5] = 0xFFFFFFFF;
+   shb[6] = sizeof(shb);
+   fwrite(shb, sizeof(shb), 1, f);
+   pcapng_write_idb(f, "primary");
+   pcapng_write_idb(f, "secondary");
+
+   cnt = 0;
+   head = __atomic_load_n(&(cap->head), __ATOMIC_ACQUIRE);
+   pos = (head > cap->size) ? head - cap->size : 0;
+   for (; pos < head; pos++)
+   {
+      ec_capturerect *src = &(cap->rec[pos % cap->size]);
+      seq = __atomic_load_n(&(src->seq), __ATOMIC_ACQUIRE);
+      if (seq != 2 * pos + 2)
+      {
+         /* being written or already overwritten */
+         continue;
+      }
+      rec->time = src->time;
+      rec->flags = src->flags;
+      rec->length = src->length;
+      if ((rec->length <= 0) || (rec->length > (int)sizeof(ec_bufT)))
+      {
+         continue;
+      }
+      memcpy(&(rec->frame), &(src->frame), rec->length);
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      if (__atomic_load_n(&(src->seq), __ATOMIC_RELAXED) != seq)
+      {
+         continue;
+      }
+      if (pcapng_write_epb(f, rec))
+      {
+         cnt++;
+      }
+   }
+   free(rec);
+   if (fclose(f) != 0)
+   {
+      return -1;
+   }
+
+   return cnt;
+}
+
+#ifdef EC_VER1
+int ec_capture_init(int nframes)
+{
+   return ecx_capture_init(&ecx_port, nframes);
+}
+
+void ec_capture_close(void)
+{
+   ecx_capture_close(&ecx_port);
+}
+
+int ec_capture_dump(const char *filename)
+{
+   return ecx_capture_dump(&ecx_port, filename);
+}
+#endif
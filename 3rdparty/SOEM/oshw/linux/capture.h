@@ -0,0 +1,68 @@
+/*
+ * Licensed under the GNU General Public License version 2 with exceptions. See
+ * LICENSE file in the project root for full license information
+ */
+
+/** \file
+ * \brief
+ * Headerfile for capture.c
+ */
+
+#ifndef _capture_
+#define _capture_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "nicdrv.h"
+
+/** capture record direction flags */
+#define EC_CAPTURE_RX        0x01
+#define EC_CAPTURE_TX        0x02
+/** capture record came from the secondary port */
+#define EC_CAPTURE_SECONDARY 0x04
+
+/** one captured frame */
+typedef struct
+{
+   /** 2 * position + 2 when valid, odd while being written */
+   uint64      seq;
+   /** time of capture, CLOCK_REALTIME in ns */
+   uint64      time;
+   /** EC_CAPTURE_ flags */
+   uint32      flags;
+   /** frame length */
+   int32       length;
+   /** frame including ethernet header */
+   ec_bufT     frame;
+} ec_capturerect;
+
+/** preallocated ring of the most recent frames */
+struct ec_capture
+{
+   /** number of records */
+   uint32      size;
+   /** total number of records ever written */
+   uint64      head;
+   /** records */
+   ec_capturerect *rec;
+};
+
+int ecx_capture_init(ecx_portt *port, int nframes);
+void ecx_capture_close(ecx_portt *port);
+void ecx_capture(ecx_portt *port, uint32 flags, const void *frame, int length);
+int ecx_capture_dump(ecx_portt *port, const char *filename);
+
+#ifdef EC_VER1
+int ec_capture_init(int nframes);
+void ec_capture_close(void);
+int ec_capture_dump(const char *filename);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
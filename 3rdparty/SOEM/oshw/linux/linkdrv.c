@@ -0,0 +1,988 @@
+/*
+ * Licensed under the GNU General Public License version 2 with exceptions. See
+ * LICENSE file in the project root for full license information
+ */
+
+/** \file
+ * \brief
+ * EtherCAT link layer drivers.
+ *
+ * The port layer in nicdrv.c does the frame index bookkeeping, the links
+ * below only move complete ethernet frames. The link is chosen by the URI
+ * scheme of the interface name:
+ *
+ * - raw:eth0    PF_PACKET socket, the default if no scheme is given. Also
+ *               used for veth pairs. A socket filter passes only EtherCAT
+ *               frames of this master.
+ * - mmap:eth0   PF_PACKET socket with TPACKET_V2 rx and tx rings. Receive
+ *               polls the ring without system calls.
+ * - tap:ec0     TAP device, for a slave simulator on the other side.
+ * - mem:name    in-process channel. The first opener gets endpoint 0, the
+ *               second endpoint 1. Frames go to the other endpoint or loop
+ *               back if it is not open or the channel is broken. A hook can
+ *               process the frames as slaves would.
+ * - pcap:file   replay of a pcap or pcapng capture. Frames sent by the slaves
+ *               are returned in file order with the index of the frame that
+ *               is waiting for an answer. Transmit is discarded.
+ */
+
+#define _GNU_SOURCE
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <linux/if_packet.h>
+#include <linux/filter.h>
+#include <linux/if_tun.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "oshw.h"
+#include "osal.h"
+#include "linkdrv.h"
+
+/** max. number of mem link channels */
+#define EC_MEMLINK_MAXCH   4
+/** max. length of mem link channel name */
+#define EC_MEMLINK_MAXNAME 32
+/** frames per mmap ring */
+#define EC_MMAP_FRAMES     64
+/** size of one mmap ring frame */
+#define EC_MMAP_FRAMESIZE  2048
+/** size of one mmap ring block */
+#define EC_MMAP_BLOCKSIZE  4096
+
+/*---------------------------------------------------------------------------
+ * raw link
+ *--------------------------------------------------------------------------*/
+
+/** Attach classic BPF filter to socket. The kernel passes only EtherCAT frames
+ * with the source MAC word 1 of the primary or secondary port and a length that
+ * fits in a buffer, other traffic on a shared NIC never wakes up the master.
+ * @param[in] sock        = socket handle
+ * @return >0 if succeeded
+ */
+static int ec_raw_filter(int sock)
+{
+   struct sock_filter code[] =
+   {
+      /* ethertype */
+      BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 12),
+      BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ETH_P_ECAT, 0, 7),
+      /* source MAC word 1 */
+      BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 8),
+      BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, priMAC[1], 1, 0),
+      BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, secMAC[1], 0, 4),
+      /* frame length */
+      BPF_STMT(BPF_LD | BPF_W | BPF_LEN, 0),
+      BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, ETH_HEADERSIZE + EC_HEADERSIZE + EC_WKCSIZE, 0, 2),
+      BPF_JUMP(BPF_JMP | BPF_JGT | BPF_K, sizeof(ec_bufT), 1, 0),
+      BPF_STMT(BPF_RET | BPF_K, 0xffffffff),
+      BPF_STMT(BPF_RET | BPF_K, 0),
+   };
+   struct sock_fprog prog;
+
+   prog.len = sizeof(code) / sizeof(code[0]);
+   prog.filter = code;
+
+   return (setsockopt(sock, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) == 0);
+}
+
+/** Kernel receive counters of a PF_PACKET socket, reset on every call. */
+static int ec_raw_stats(ec_stackT *stack, uint32 *packets, uint32 *drops)
+{
+   struct tpacket_stats st;
+   socklen_t len = sizeof(st);
+
+   if (getsockopt(*stack->sock, SOL_PACKET, PACKET_STATISTICS, &st, &len) < 0)
+   {
+      return 0;
+   }
+   *packets = st.tp_packets;
+   *drops = st.tp_drops;
+
+   return 1;
+}
+
+/** Open PF_PACKET socket bound to NIC.
+ * @param[in] ifname      = Name of NIC device, f.e. "eth0"
+ * @param[in] rings       = if >0 then setup rx and tx rings before bind
+ * @param[out] psock      = socket handle
+ * @return >0 if succeeded
+ */
+static int ec_raw_open(const char *ifname, int rings, int *psock)
+{
+   int i;
+   int r, ifindex;
+   struct timeval timeout;
+   struct ifreq ifr;
+   struct sockaddr_ll sll;
+   struct tpacket_req req;
+
+   /* we use RAW packet socket, with packet type ETH_P_ECAT */
+   *psock = socket(PF_PACKET, SOCK_RAW, htons(ETH_P_ECAT));
+   if (*psock < 0)
+   {
+      return 0;
+   }
+   /* filter before bind, so no foreign frame gets queued */
+   if (!ec_raw_filter(*psock))
+   {
+      close(*psock);
+      *psock = -1;
+      return 0;
+   }
+
+   timeout.tv_sec =  0;
+   timeout.tv_usec = 1;
+   r = setsockopt(*psock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+   r = setsockopt(*psock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+   i = 1;
+   r = setsockopt(*psock, SOL_SOCKET, SO_DONTROUTE, &i, sizeof(i));
+   if (rings)
+   {
+      i = TPACKET_V2;
+      r = setsockopt(*psock, SOL_PACKET, PACKET_VERSION, &i, sizeof(i));
+      req.tp_block_size = EC_MMAP_BLOCKSIZE;
+      req.tp_frame_size = EC_MMAP_FRAMESIZE;
+      req.tp_frame_nr = EC_MMAP_FRAMES;
+      req.tp_block_nr = (EC_MMAP_FRAMES * EC_MMAP_FRAMESIZE) / EC_MMAP_BLOCKSIZE;
+      r |= setsockopt(*psock, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req));
+      r |= setsockopt(*psock, SOL_PACKET, PACKET_TX_RING, &req, sizeof(req));
+      if (r)
+      {
+         close(*psock);
+         *psock = -1;
+         return 0;
+      }
+   }
+   /* connect socket to NIC by name */
+   strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
+   ifr.ifr_name[IFNAMSIZ - 1] = '\0';
+   r = ioctl(*psock, SIOCGIFINDEX, &ifr);
+   ifindex = ifr.ifr_ifindex;
+   ifr.ifr_flags = 0;
+   /* reset flags of NIC interface */
+   r = ioctl(*psock, SIOCGIFFLAGS, &ifr);
+   /* set flags of NIC interface, here promiscuous and broadcast */
+   ifr.ifr_flags = ifr.ifr_flags | IFF_PROMISC | IFF_BROADCAST;
+   r = ioctl(*psock, SIOCSIFFLAGS, &ifr);
+   /* bind socket to protocol, in this case RAW EtherCAT */
+   memset(&sll, 0, sizeof(sll));
+   sll.sll_family = AF_PACKET;
+   sll.sll_ifindex = ifindex;
+   sll.sll_protocol = htons(ETH_P_ECAT);
+   r = bind(*psock, (struct sockaddr *)&sll, sizeof(sll));
+
+   return (r == 0);
+}
+
+static int ec_raw_setup(ec_stackT *stack, const char *name)
+{
+   stack->linkdata = NULL;
+   return ec_raw_open(name, 0, stack->sock);
+}
+
+static void ec_raw_close(ec_stackT *stack)
+{
+   if (*stack->sock >= 0)
+   {
+      close(*stack->sock);
+      *stack->sock = -1;
+   }
+}
+
+static int ec_raw_send(ec_stackT *stack, const void *frame, int length)
+{
+   return send(*stack->sock, frame, length, 0);
+}
+
+static int ec_raw_sendmulti(ec_stackT *stack, void * const *frames, const int *lengths, int n)
+{
+   struct mmsghdr msgs[EC_MAXBUF];
+   struct iovec iovecs[EC_MAXBUF];
+   int i, sent;
+
+   if (n > EC_MAXBUF)
+   {
+      n = EC_MAXBUF;
+   }
+   memset(msgs, 0, sizeof(struct mmsghdr) * n);
+   for (i = 0; i < n; i++)
+   {
+      iovecs[i].iov_base = frames[i];
+      iovecs[i].iov_len = lengths[i];
+      msgs[i].msg_hdr.msg_iov = &iovecs[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+   }
+   sent = sendmmsg(*stack->sock, msgs, n, 0);
+
+   return (sent < 0) ? 0 : sent;
+}
+
+static int ec_raw_recv(ec_stackT *stack, void *buf, int length)
+{
+   return recv(*stack->sock, buf, length, 0);
+}
+
+static int ec_raw_recvmulti(ec_stackT *stack, ec_bufT *bufs, int *lengths, int n)
+{
+   struct mmsghdr msgs[EC_MAXBUF];
+   struct iovec iovecs[EC_MAXBUF];
+   int i, rcvd;
+
+   if (n > EC_MAXBUF)
+   {
+      n = EC_MAXBUF;
+   }
+   memset(msgs, 0, sizeof(struct mmsghdr) * n);
+   for (i = 0; i < n; i++)
+   {
+      iovecs[i].iov_base = &(bufs[i]);
+      iovecs[i].iov_len = sizeof(ec_bufT);
+      msgs[i].msg_hdr.msg_iov = &iovecs[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+   }
+   /* wait (SO_RCVTIMEO) for the first frame only, then take what is queued */
+   rcvd = recvmmsg(*stack->sock, msgs, n, MSG_WAITFORONE, NULL);
+   for (i = 0; i < rcvd; i++)
+   {
+      lengths[i] = msgs[i].msg_len;
+   }
+
+   return (rcvd < 0) ? 0 : rcvd;
+}
+
+const ec_linkt ec_link_raw =
+{
+   "raw",
+   ec_raw_setup,
+   ec_raw_close,
+   ec_raw_send,
+   ec_raw_sendmulti,
+   ec_raw_recv,
+   ec_raw_recvmulti,
+   ec_raw_stats
+};
+
+/*---------------------------------------------------------------------------
+ * mmap link
+ *--------------------------------------------------------------------------*/
+
+/** private data of mmap link */
+typedef struct
+{
+   uint8 *ring;
+   uint8 *rxring;
+   uint8 *txring;
+   int   rxhead;
+   int   txhead;
+} ec_mmaplinkt;
+
+static int ec_mmap_setup(ec_stackT *stack, const char *name)
+{
+   ec_mmaplinkt *ml;
+   size_t size;
+
+   stack->linkdata = NULL;
+   if (!ec_raw_open(name, 1, stack->sock))
+   {
+      return 0;
+   }
+   ml = calloc(1, sizeof(ec_mmaplinkt));
+   if (ml == NULL)
+   {
+      ec_raw_close(stack);
+      return 0;
+   }
+   size = EC_MMAP_FRAMES * EC_MMAP_FRAMESIZE;
+   /* rx ring is followed by the tx ring in one mapping */
+   ml->ring = mmap(NULL, 2 * size, PROT_READ | PROT_WRITE, MAP_SHARED, *stack->sock, 0);
+   if (ml->ring == MAP_FAILED)
+   {
+      free(ml);
+      ec_raw_close(stack);
+      return 0;
+   }
+   ml->rxring = ml->ring;
+   ml->txring = ml->ring + size;
+   stack->linkdata = ml;
+
+   return 1;
+}
+
+static void ec_mmap_close(ec_stackT *stack)
+{
+   ec_mmaplinkt *ml = stack->linkdata;
+
+   if (ml)
+   {
+      munmap(ml->ring, 2 * EC_MMAP_FRAMES * EC_MMAP_FRAMESIZE);
+      free(ml);
+      stack->linkdata = NULL;
+   }
+   ec_raw_close(stack);
+}
+
+/** Put frame in next free tx ring slot, without kicking the kernel.
+ * @return bytes queued or -1 if ring is full
+ */
+static int ec_mmap_queue(ec_mmaplinkt *ml, const void *frame, int length)
+{
+   struct tpacket2_hdr *hdr;
+
+   hdr = (struct tpacket2_hdr *)(ml->txring + ml->txhead * EC_MMAP_FRAMESIZE);
+   if (hdr->tp_status != TP_STATUS_AVAILABLE)
+   {
+      return -1;
+   }
+   memcpy((uint8 *)hdr + TPACKET2_HDRLEN - sizeof(struct sockaddr_ll), frame, length);
+   hdr->tp_len = length;
+   __sync_synchronize();
+   hdr->tp_status = TP_STATUS_SEND_REQUEST;
+   ml->txhead = (ml->txhead + 1) % EC_MMAP_FRAMES;
+
+   return length;
+}
+
+static int ec_mmap_send(ec_stackT *stack, const void *frame, int length)
+{
+   int rval;
+
+   rval = ec_mmap_queue(stack->linkdata, frame, length);
+   if ((rval > 0) && (send(*stack->sock, NULL, 0, MSG_DONTWAIT) < 0))
+   {
+      rval = -1;
+   }
+
+   return rval;
+}
+
+static int ec_mmap_sendmulti(ec_stackT *stack, void * const *frames, const int *lengths, int n)
+{
+   int i;
+
+   for (i = 0; i < n; i++)
+   {
+      if (ec_mmap_queue(stack->linkdata, frames[i], lengths[i]) < 0)
+      {
+         break;
+      }
+   }
+   /* one kick transmits all queued slots */
+   if ((i > 0) && (send(*stack->sock, NULL, 0, MSG_DONTWAIT) < 0))
+   {
+      i = 0;
+   }
+
+   return i;
+}
+
+static int ec_mmap_recv(ec_stackT *stack, void *buf, int length)
+{
+   ec_mmaplinkt *ml = stack->linkdata;
+   struct tpacket2_hdr *hdr;
+   int l;
+
+   hdr = (struct tpacket2_hdr *)(ml->rxring + ml->rxhead * EC_MMAP_FRAMESIZE);
+   if (!(hdr->tp_status & TP_STATUS_USER))
+   {
+      return 0;
+   }
+   __sync_synchronize();
+   l = hdr->tp_snaplen;
+   if (l > length)
+   {
+      l = length;
+   }
+   memcpy(buf, (uint8 *)hdr + hdr->tp_mac, l);
+   __sync_synchronize();
+   /* hand slot back to kernel */
+   hdr->tp_status = TP_STATUS_KERNEL;
+   ml->rxhead = (ml->rxhead + 1) % EC_MMAP_FRAMES;
+
+   return l;
+}
+
+static int ec_mmap_recvmulti(ec_stackT *stack, ec_bufT *bufs, int *lengths, int n)
+{
+   int i;
+
+   for (i = 0; i < n; i++)
+   {
+      lengths[i] = ec_mmap_recv(stack, &(bufs[i]), sizeof(ec_bufT));
+      if (lengths[i] <= 0)
+      {
+         break;
+      }
+   }
+
+   return i;
+}
+
+const ec_linkt ec_link_mmap =
+{
+   "mmap",
+   ec_mmap_setup,
+   ec_mmap_close,
+   ec_mmap_send,
+   ec_mmap_sendmulti,
+   ec_mmap_recv,
+   ec_mmap_recvmulti,
+   ec_raw_stats
+};
+
+/*---------------------------------------------------------------------------
+ * tap link
+ *--------------------------------------------------------------------------*/
+
+static int ec_tap_setup(ec_stackT *stack, const char *name)
+{
+   struct ifreq ifr;
+   int fd, s;
+
+   stack->linkdata = NULL;
+   *stack->sock = open("/dev/net/tun", O_RDWR | O_NONBLOCK);
+   if (*stack->sock < 0)
+   {
+      return 0;
+   }
+   memset(&ifr, 0, sizeof(ifr));
+   ifr.ifr_flags = IFF_TAP | IFF_NO_PI;
+   strncpy(ifr.ifr_name, name, IFNAMSIZ - 1);
+   if (ioctl(*stack->sock, TUNSETIFF, &ifr) < 0)
+   {
+      ec_raw_close(stack);
+      return 0;
+   }
+   /* bring tap interface up */
+   fd = socket(AF_INET, SOCK_DGRAM, 0);
+   if (fd >= 0)
+   {
+      s = ioctl(fd, SIOCGIFFLAGS, &ifr);
+      ifr.ifr_flags |= IFF_UP;
+      if (s == 0)
+      {
+         s = ioctl(fd, SIOCSIFFLAGS, &ifr);
+      }
+      close(fd);
+   }
+
+   return 1;
+}
+
+static int ec_tap_send(ec_stackT *stack, const void *frame, int length)
+{
+   return write(*stack->sock, frame, length);
+}
+
+static int ec_tap_recv(ec_stackT *stack, void *buf, int length)
+{
+   return read(*stack->sock, buf, length);
+}
+
+const ec_linkt ec_link_tap =
+{
+   "tap",
+   ec_tap_setup,
+   ec_raw_close,
+   ec_tap_send,
+   NULL,
+   ec_tap_recv,
+   NULL,
+   NULL
+};
+
+/*---------------------------------------------------------------------------
+ * mem link
+ *--------------------------------------------------------------------------*/
+
+/** frames in flight towards one mem link endpoint */
+typedef struct
+{
+   ec_bufT frame[EC_MAXBUF];
+   int     length[EC_MAXBUF];
+   int     head;
+   int     count;
+   int     open;
+} ec_memendpointt;
+
+/** in-process channel with two endpoints */
+typedef struct
+{
+   char             name[EC_MEMLINK_MAXNAME];
+   int              used;
+   int              broken;
+   ec_memlink_hookt hook;
+   void             *arg;
+   ec_memendpointt  ep[2];
+} ec_memchannelt;
+
+/** private data of mem link */
+typedef struct
+{
+   ec_memchannelt *ch;
+   int            ep;
+} ec_memlinkt;
+
+static ec_memchannelt  ec_memch[EC_MEMLINK_MAXCH];
+static pthread_mutex_t ec_memch_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/** Find channel by name, create it if not found. Call with mutex locked. */
+static ec_memchannelt *ec_memlink_channel(const char *name)
+{
+   int i;
+
+   for (i = 0; i < EC_MEMLINK_MAXCH; i++)
+   {
+      if (ec_memch[i].used && (strncmp(ec_memch[i].name, name, EC_MEMLINK_MAXNAME - 1) == 0))
+      {
+         return &ec_memch[i];
+      }
+   }
+   for (i = 0; i < EC_MEMLINK_MAXCH; i++)
+   {
+      if (!ec_memch[i].used)
+      {
+         memset(&ec_memch[i], 0, sizeof(ec_memchannelt));
+         strncpy(ec_memch[i].name, name, EC_MEMLINK_MAXNAME - 1);
+         ec_memch[i].used = 1;
+         return &ec_memch[i];
+      }
+   }
+
+   return NULL;
+}
+
+/** Set simulator hook of a mem link channel.
+ * @param[in] name   = channel name, "" for "mem:"
+ * @param[in] hook   = hook function, NULL for plain loopback
+ * @param[in] arg    = argument passed to hook
+ * @return >0 if OK
+ */
+int ec_memlink_sethook(const char *name, ec_memlink_hookt hook, void *arg)
+{
+   ec_memchannelt *ch;
+
+   pthread_mutex_lock(&ec_memch_mutex);
+   ch = ec_memlink_channel(name);
+   if (ch)
+   {
+      ch->hook = hook;
+      ch->arg = arg;
+   }
+   pthread_mutex_unlock(&ec_memch_mutex);
+
+   return (ch != NULL);
+}
+
+/** Simulate a broken connection between the endpoints of a mem link channel.
+ * While broken every endpoint gets its own frames back.
+ * @param[in] name   = channel name
+ * @param[in] broken = 1 to break, 0 to restore
+ * @return >0 if OK
+ */
+int ec_memlink_setbroken(const char *name, int broken)
+{
+   ec_memchannelt *ch;
+
+   pthread_mutex_lock(&ec_memch_mutex);
+   ch = ec_memlink_channel(name);
+   if (ch)
+   {
+      ch->broken = broken;
+   }
+   pthread_mutex_unlock(&ec_memch_mutex);
+
+   return (ch != NULL);
+}
+
+static int ec_mem_setup(ec_stackT *stack, const char *name)
+{
+   ec_memlinkt *ml;
+   ec_memchannelt *ch;
+   int ep;
+
+   stack->linkdata = NULL;
+   *stack->sock = -1;
+   ml = calloc(1, sizeof(ec_memlinkt));
+   if (ml == NULL)
+   {
+      return 0;
+   }
+   pthread_mutex_lock(&ec_memch_mutex);
+   ch = ec_memlink_channel(name);
+   ep = -1;
+   if (ch)
+   {
+      ep = ch->ep[0].open ? (ch->ep[1].open ? -1 : 1) : 0;
+   }
+   if (ep >= 0)
+   {
+      ch->ep[ep].open = 1;
+      ch->ep[ep].head = 0;
+      ch->ep[ep].count = 0;
+      ml->ch = ch;
+      ml->ep = ep;
+      stack->linkdata = ml;
+   }
+   pthread_mutex_unlock(&ec_memch_mutex);
+   if (stack->linkdata == NULL)
+   {
+      free(ml);
+      return 0;
+   }
+
+   return 1;
+}
+
+static void ec_mem_close(ec_stackT *stack)
+{
+   ec_memlinkt *ml = stack->linkdata;
+
+   if (ml)
+   {
+      pthread_mutex_lock(&ec_memch_mutex);
+      ml->ch->ep[ml->ep].open = 0;
+      ml->ch->ep[ml->ep].count = 0;
+      pthread_mutex_unlock(&ec_memch_mutex);
+      free(ml);
+      stack->linkdata = NULL;
+   }
+}
+
+static int ec_mem_send(ec_stackT *stack, const void *frame, int length)
+{
+   ec_memlinkt *ml = stack->linkdata;
+   ec_memchannelt *ch = ml->ch;
+   ec_memendpointt *dst;
+   int to, slot, rval;
+
+   if ((length <= 0) || (length > (int)sizeof(ec_bufT)))
+   {
+      return -1;
+   }
+   pthread_mutex_lock(&ec_memch_mutex);
+   to = 1 - ml->ep;
+   if (ch->broken || !ch->ep[to].open)
+   {
+      to = ml->ep;
+   }
+   dst = &(ch->ep[to]);
+   rval = -1;
+   if (dst->count < EC_MAXBUF)
+   {
+      slot = (dst->head + dst->count) % EC_MAXBUF;
+      memcpy(&(dst->frame[slot]), frame, length);
+      dst->length[slot] = length;
+      if (!ch->hook || (ch->hook(&(dst->frame[slot]), length, ml->ep, to, ch->arg) >= 0))
+      {
+         dst->count++;
+      }
+      rval = length;
+   }
+   pthread_mutex_unlock(&ec_memch_mutex);
+
+   return rval;
+}
+
+static int ec_mem_recv(ec_stackT *stack, void *buf, int length)
+{
+   ec_memlinkt *ml = stack->linkdata;
+   ec_memendpointt *ep;
+   int l = 0;
+
+   pthread_mutex_lock(&ec_memch_mutex);
+   ep = &(ml->ch->ep[ml->ep]);
+   if (ep->count)
+   {
+      l = ep->length[ep->head];
+      if (l > length)
+      {
+         l = length;
+      }
+      memcpy(buf, &(ep->frame[ep->head]), l);
+      ep->head = (ep->head + 1) % EC_MAXBUF;
+      ep->count--;
+   }
+   pthread_mutex_unlock(&ec_memch_mutex);
+
+   return l;
+}
+
+const ec_linkt ec_link_mem =
+{
+   "mem",
+   ec_mem_setup,
+   ec_mem_close,
+   ec_mem_send,
+   NULL,
+   ec_mem_recv,
+   NULL,
+   NULL
+};
+
+/*---------------------------------------------------------------------------
+ * pcap replay link
+ *--------------------------------------------------------------------------*/
+
+/** private data of pcap link */
+typedef struct
+{
+   uint8  *file;
+   uint8  **frame;
+   int    *length;
+   int    nframe;
+   int    next;
+   /** indexes of transmitted frames waiting for an answer */
+   uint8  pending[EC_MAXBUF];
+   int    npending;
+} ec_pcaplinkt;
+
+static uint32 ec_pcap_u32(const uint8 *p, int swap)
+{
+   uint32 v;
+
+   memcpy(&v, p, sizeof(v));
+   return swap ? __builtin_bswap32(v) : v;
+}
+
+/** Add frame to replay list if it was sent by the slaves. Slaves set the
+ * locally administered bit in the first source MAC byte. */
+static void ec_pcap_add(ec_pcaplinkt *pl, uint8 *frame, int length)
+{
+   ec_etherheadert *ehp = (ec_etherheadert *)frame;
+
+   if ((length >= (int)(ETH_HEADERSIZE + EC_HEADERSIZE + EC_WKCSIZE)) &&
+       (length <= (int)sizeof(ec_bufT)) &&
+       (ehp->etype == htons(ETH_P_ECAT)) &&
+       (frame[6] & 0x02))
+   {
+      pl->frame[pl->nframe] = frame;
+      pl->length[pl->nframe] = length;
+      pl->nframe++;
+   }
+}
+
+/** Index frames of a classic pcap or a pcapng file. */
+static void ec_pcap_parse(ec_pcaplinkt *pl, long size)
+{
+   uint8 *p = pl->file;
+   uint32 magic, btype, blen, caplen;
+   int swap;
+   long pos;
+
+   if (size < 24)
+   {
+      return;
+   }
+   memcpy(&magic, p, sizeof(magic));
+   if ((magic == 0xa1b2c3d4) || (magic == 0xa1b23c4d) ||
+       (magic == 0xd4c3b2a1) || (magic == 0x4d3cb2a1))
+   {
+      /* classic pcap: 24 byte file header, 16 byte record headers */
+      swap = (magic == 0xd4c3b2a1) || (magic == 0x4d3cb2a1);
+      pos = 24;
+      while (pos + 16 <= size)
+      {
+         caplen = ec_pcap_u32(p + pos + 8, swap);
+         if (pos + 16 + (long)caplen > size)
+         {
+            break;
+         }
+         ec_pcap_add(pl, p + pos + 16, caplen);
+         pos += 16 + caplen;
+      }
+   }
+   else if (magic == 0x0a0d0d0a)
+   {
+      /* pcapng: byte order from section header magic */
+      swap = (ec_pcap_u32(p + 8, 0) != 0x1a2b3c4d);
+      pos = 0;
+      while (pos + 12 <= size)
+      {
+         btype = ec_pcap_u32(p + pos, swap);
+         blen = ec_pcap_u32(p + pos + 4, swap);
+         if ((blen < 12) || (pos + (long)blen > size))
+         {
+            break;
+         }
+         /* enhanced packet block */
+         if ((btype == 6) && (blen >= 32))
+         {
+            caplen = ec_pcap_u32(p + pos + 20, swap);
+            if (28 + caplen <= blen)
+            {
+               ec_pcap_add(pl, p + pos + 28, caplen);
+            }
+         }
+         pos += blen;
+      }
+   }
+}
+
+static void ec_pcap_close(ec_stackT *stack)
+{
+   ec_pcaplinkt *pl = stack->linkdata;
+
+   if (pl)
+   {
+      free(pl->file);
+      free(pl->frame);
+      free(pl->length);
+      free(pl);
+      stack->linkdata = NULL;
+   }
+}
+
+static int ec_pcap_setup(ec_stackT *stack, const char *name)
+{
+   ec_pcaplinkt *pl;
+   FILE *fp;
+   long size;
+
+   stack->linkdata = NULL;
+   *stack->sock = -1;
+   fp = fopen(name, "rb");
+   if (fp == NULL)
+   {
+      return 0;
+   }
+   pl = calloc(1, sizeof(ec_pcaplinkt));
+   fseek(fp, 0, SEEK_END);
+   size = ftell(fp);
+   fseek(fp, 0, SEEK_SET);
+   if (pl && (size > 0))
+   {
+      stack->linkdata = pl;
+      pl->file = malloc(size);
+      /* a frame needs at least 30 bytes, this bounds the frame list */
+      pl->frame = malloc(sizeof(uint8 *) * (size / 30 + 1));
+      pl->length = malloc(sizeof(int) * (size / 30 + 1));
+      if (pl->file && pl->frame && pl->length && (fread(pl->file, 1, size, fp) == (size_t)size))
+      {
+         ec_pcap_parse(pl, size);
+      }
+   }
+   fclose(fp);
+   if (!pl || (pl->nframe == 0))
+   {
+      if (pl && !stack->linkdata)
+      {
+         free(pl);
+      }
+      ec_pcap_close(stack);
+      return 0;
+   }
+
+   return 1;
+}
+
+static int ec_pcap_send(ec_stackT *stack, const void *frame, int length)
+{
+   ec_pcaplinkt *pl = stack->linkdata;
+
+   if (length < (int)(ETH_HEADERSIZE + EC_HEADERSIZE))
+   {
+      return -1;
+   }
+   if (pl->npending < EC_MAXBUF)
+   {
+      pl->pending[pl->npending++] = ((const ec_comt *)((const uint8 *)frame + ETH_HEADERSIZE))->index;
+   }
+
+   return length;
+}
+
+static int ec_pcap_recv(ec_stackT *stack, void *buf, int length)
+{
+   ec_pcaplinkt *pl = stack->linkdata;
+   uint8 *p = buf;
+   uint16 dlength;
+   int l, pos;
+
+   if (pl->npending == 0)
+   {
+      return 0;
+   }
+   l = pl->length[pl->next];
+   if (l > length)
+   {
+      l = length;
+   }
+   memcpy(buf, pl->frame[pl->next], l);
+   pl->next = (pl->next + 1) % pl->nframe;
+   /* patch index of every datagram to the oldest frame waiting for an answer */
+   pos = ETH_HEADERSIZE + EC_ELENGTHSIZE;
+   do
+   {
+      p[pos + 1] = pl->pending[0];
+      memcpy(&dlength, &p[pos + 6], sizeof(dlength));
+      dlength = etohs(dlength);
+      pos += EC_HEADERSIZE - EC_ELENGTHSIZE + (dlength & 0x07ff) + EC_WKCSIZE;
+   } while ((dlength & EC_DATAGRAMFOLLOWS) && (pos + (int)EC_HEADERSIZE <= l));
+   pl->npending--;
+   memmove(&pl->pending[0], &pl->pending[1], pl->npending);
+
+   return l;
+}
+
+const ec_linkt ec_link_pcap =
+{
+   "pcap",
+   ec_pcap_setup,
+   ec_pcap_close,
+   ec_pcap_send,
+   NULL,
+   ec_pcap_recv,
+   NULL,
+   NULL
+};
+
+/*---------------------------------------------------------------------------
+ * link selection
+ *--------------------------------------------------------------------------*/
+
+static const ec_linkt * const ec_links[] =
+{
+   &ec_link_raw,
+   &ec_link_mmap,
+   &ec_link_tap,
+   &ec_link_mem,
+   &ec_link_pcap
+};
+
+/** Select link by URI scheme of the interface name.
+ * @param[in] ifname   = interface URI, f.e. "mmap:eth0" or plain "eth0"
+ * @param[out] name    = part of ifname after the scheme
+ * @return link operations, raw link if there is no known scheme
+ */
+const ec_linkt *ec_link_find(const char *ifname, const char **name)
+{
+   const char *colon;
+   size_t i, l;
+
+   colon = strchr(ifname, ':');
+   if (colon)
+   {
+      l = colon - ifname;
+      for (i = 0; i < sizeof(ec_links) / sizeof(ec_links[0]); i++)
+      {
+         if ((strlen(ec_links[i]->scheme) == l) && (strncmp(ec_links[i]->scheme, ifname, l) == 0))
+         {
+            *name = colon + 1;
+            return ec_links[i];
+         }
+      }
+   }
+   /* no scheme, or an alias interface like "eth0:1" */
+   *name = ifname;
+
+   return &ec_link_raw;
+}
@@ -0,0 +1,67 @@
+/*
+ * Licensed under the GNU General Public License version 2 with exceptions. See
+ * LICENSE file in the project root for full license information
+ */
+
+/** \file
+ * \brief
+ * Headerfile for linkdrv.c
+ */
+
+#ifndef _linkdrvh_
+#define _linkdrvh_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "nicdrv.h"
+
+/** Link layer operations of one port stack. The index bookkeeping in nicdrv.c
+ * is common, a link only moves complete ethernet frames. A link is selected by
+ * the URI scheme of the interface name passed to ecx_setupnic(), f.e.
+ * "raw:eth0". A name without known scheme uses the raw link.
+ */
+struct ec_link
+{
+   /** URI scheme without colon, f.e. "raw" */
+   const char *scheme;
+   /** open link, name is the URI part after the colon. @return >0 if OK */
+   int  (*setup)(ec_stackT *stack, const char *name);
+   /** close link and free link private data */
+   void (*close)(ec_stackT *stack);
+   /** transmit one frame. @return bytes sent or -1 */
+   int  (*send)(ec_stackT *stack, const void *frame, int length);
+   /** transmit n frames at once, NULL if not supported. @return frames sent */
+   int  (*sendmulti)(ec_stackT *stack, void * const *frames, const int *lengths, int n);
+   /** non blocking receive of one frame. @return bytes received or <=0 */
+   int  (*recv)(ec_stackT *stack, void *buf, int length);
+   /** non blocking receive of up to n frames, NULL if not supported. @return frames received */
+   int  (*recvmulti)(ec_stackT *stack, ec_bufT *bufs, int *lengths, int n);
+   /** kernel receive counters since last call, NULL if not supported. @return >0 if OK */
+   int  (*stats)(ec_stackT *stack, uint32 *packets, uint32 *drops);
+};
+
+extern const ec_linkt ec_link_raw;
+extern const ec_linkt ec_link_mmap;
+extern const ec_linkt ec_link_tap;
+extern const ec_linkt ec_link_mem;
+extern const ec_linkt ec_link_pcap;
+
+/** Simulator hook of a mem link channel. Called for every frame before it is
+ * delivered. from/to are the endpoint numbers (0 = first opened, 1 = second).
+ * The hook may modify the frame in place, like slaves do on the wire.
+ * @return 0 to deliver the frame, <0 to drop it
+ */
+typedef int (*ec_memlink_hookt)(void *frame, int length, int from, int to, void *arg);
+
+const ec_linkt *ec_link_find(const char *ifname, const char **name);
+int ec_memlink_sethook(const char *name, ec_memlink_hookt hook, void *arg);
+int ec_memlink_setbroken(const char *name, int broken);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -28,6 +28,13 @@
  * packets. The software layer will detect the possible failure modes and
  * compensate. If needed the packets from interface A are resent through interface B.
  * This layer if fully transparent for the higher layers.
+ *
+ * Cyclic process data that needs more than one frame is transmitted with a
+ * single sendmmsg() call and drained with recvmmsg(), so a segmented process
+ * image costs one syscall per direction instead of one per frame.
+ *
+ * The frames are moved by a link layer driver (linkdrv.c) that is selected
+ * by the URI scheme of the interface name, f.e. "raw:eth0" or "mem:".
  */
 
 #include <sys/types.h>
@@ -46,6 +53,8 @@
 
 #include "oshw.h"
 #include "osal.h"
+#include "linkdrv.h"
+#include "capture.h"
 
 /** Redundancy modes */
 enum
@@ -83,18 +92,18 @@ static void ecx_clear_rxbufstat(int *rxbufstat)
 
 /** Basic setup to connect NIC to socket.
  * @param[in] port        = port context struct
- * @param[in] ifname      = Name of NIC device, f.e. "eth0"
+ * @param[in] ifname      = Name of NIC device, f.e. "eth0", optionally with
+ *                          link URI scheme, f.e. "mmap:eth0" or "mem:"
  * @param[in] secondary   = if >0 then use secondary stack instead of primary
  * @return >0 if succeeded
  */
 int ecx_setupnic(ecx_portt *port, const char *ifname, int secondary)
 {
    int i;
-   int r, rval, ifindex;
-   struct timeval timeout;
-   struct ifreq ifr;
-   struct sockaddr_ll sll;
+   int rval;
    int *psock;
+   ec_stackT *stack;
+   const char *name;
    pthread_mutexattr_t mutexattr;
 
    rval = 0;
@@ -115,6 +124,7 @@ int ecx_setupnic(ecx_portt *port, const char *ifname, int secondary)
          port->redport->stack.rxbufstat   = &(port->redport->rxbufstat);
          port->redport->stack.rxsa        = &(port->redport->rxsa);
          ecx_clear_rxbufstat(&(port->redport->rxbufstat[0]));
+         stack = &(port->redport->stack);
       }
       else
       {
@@ -132,6 +142,10 @@ int ecx_setupnic(ecx_portt *port, const char *ifname, int secondary)
       port->sockhandle        = -1;
       port->lastidx           = 0;
       port->redstate          = ECT_RED_NONE;
+      memset(&(port->redstat), 0, sizeof(port->redstat));
+      memset(&(port->rxstat), 0, sizeof(port->rxstat));
+      memset(&(port->rxdest), 0, sizeof(port->rxdest));
+      memset(&(port->copystat), 0, sizeof(port->copystat));
       port->stack.sock        = &(port->sockhandle);
       port->stack.txbuf       = &(port->txbuf);
       port->stack.txbuflength = &(port->txbuflength);
@@ -141,32 +155,13 @@ int ecx_setupnic(ecx_portt *port, const char *ifname, int secondary)
       port->stack.rxsa        = &(port->rxsa);
       ecx_clear_rxbufstat(&(port->rxbufstat[0]));
       psock = &(port->sockhandle);
+      stack = &(port->stack);
    }
-   /* we use RAW packet socket, with packet type ETH_P_ECAT */
-   *psock = socket(PF_PACKET, SOCK_RAW, htons(ETH_P_ECAT));
-
-   timeout.tv_sec =  0;
-   timeout.tv_usec = 1;
-   r = setsockopt(*psock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
-   r = setsockopt(*psock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
-   i = 1;
-   r = setsockopt(*psock, SOL_SOCKET, SO_DONTROUTE, &i, sizeof(i));
-   /* connect socket to NIC by name */
-   strcpy(ifr.ifr_name, ifname);
-   r = ioctl(*psock, SIOCGIFINDEX, &ifr);
-   ifindex = ifr.ifr_ifindex;
-   strcpy(ifr.ifr_name, ifname);
-   ifr.ifr_flags = 0;
-   /* reset flags of NIC interface */
-   r = ioctl(*psock, SIOCGIFFLAGS, &ifr);
-   /* set flags of NIC interface, here promiscuous and broadcast */
-   ifr.ifr_flags = ifr.ifr_flags | IFF_PROMISC | IFF_BROADCAST;
-   r = ioctl(*psock, SIOCSIFFLAGS, &ifr);
-   /* bind socket to protocol, in this case RAW EtherCAT */
-   sll.sll_family = AF_PACKET;
-   sll.sll_ifindex = ifindex;
-   sll.sll_protocol = htons(ETH_P_ECAT);
-   r = bind(*psock, (struct sockaddr *)&sll, sizeof(sll));
+   /* select link layer by URI scheme and open it */
+   stack->link = ec_link_find(ifname, &name);
+   stack->linkdata = NULL;
+   *psock = -1;
+   rval = stack->link->setup(stack, name);
    /* setup ethernet headers in tx buffers so we don't have to repeat it */
    for (i = 0; i < EC_MAXBUF; i++)
    {
@@ -174,7 +169,6 @@ int ecx_setupnic(ecx_portt *port, const char *ifname, int secondary)
       port->rxbufstat[i] = EC_BUF_EMPTY;
    }
    ec_setupheader(&(port->txbuf2));
-   if (r == 0) rval = 1;
 
    return rval;
 }
@@ -185,10 +179,16 @@ int ecx_setupnic(ecx_portt *port, const char *ifname, int secondary)
  */
 int ecx_closenic(ecx_portt *port)
 {
-   if (port->sockhandle >= 0)
-      close(port->sockhandle);
-   if ((port->redport) && (port->redport->sockhandle >= 0))
-      close(port->redport->sockhandle);
+   if (port->stack.link)
+   {
+      port->stack.link->close(&(port->stack));
+      port->stack.link = NULL;
+   }
+   if ((port->redport) && (port->redport->stack.link))
+   {
+      port->redport->stack.link->close(&(port->redport->stack));
+      port->redport->stack.link = NULL;
+   }
 
    return 0;
 }
@@ -242,6 +242,8 @@ int ecx_getindex(ecx_portt *port)
    port->rxbufstat[idx] = EC_BUF_ALLOC;
    if (port->redstate != ECT_RED_NONE)
       port->redport->rxbufstat[idx] = EC_BUF_ALLOC;
+   port->rxdest[idx].dest = NULL;
+   port->rxdest[idx].done = FALSE;
    port->lastidx = idx;
 
    pthread_mutex_unlock( &(port->getindex_mutex) );
@@ -282,11 +284,15 @@ int ecx_outframe(ecx_portt *port, int idx, int stacknumber)
    }
    lp = (*stack->txbuflength)[idx];
    (*stack->rxbufstat)[idx] = EC_BUF_TX;
-   rval = send(*stack->sock, (*stack->txbuf)[idx], lp, 0);
+   rval = stack->link->send(stack, (*stack->txbuf)[idx], lp);
    if (rval == -1)
    {
       (*stack->rxbufstat)[idx] = EC_BUF_EMPTY;
    }
+   else
+   {
+      ecx_capture(port, EC_CAPTURE_TX | (stacknumber ? EC_CAPTURE_SECONDARY : 0), (*stack->txbuf)[idx], lp);
+   }
 
    return rval;
 }
@@ -319,16 +325,78 @@ int ecx_outframe_red(ecx_portt *port, int idx)
       ehp->sa1 = htons(secMAC[1]);
       /* transmit over secondary socket */
       port->redport->rxbufstat[idx] = EC_BUF_TX;
-      if (send(port->redport->sockhandle, &(port->txbuf2), port->txbuflength2 , 0) == -1)
+      if (port->redport->stack.link->send(&(port->redport->stack), &(port->txbuf2), port->txbuflength2) == -1)
       {
          port->redport->rxbufstat[idx] = EC_BUF_EMPTY;
       }
+      else
+      {
+         ecx_capture(port, EC_CAPTURE_TX | EC_CAPTURE_SECONDARY, &(port->txbuf2), port->txbuflength2);
+      }
       pthread_mutex_unlock( &(port->tx_mutex) );
    }
 
    return rval;
 }
 
+/** Transmit a batch of buffers over socket with one system call (non blocking).
+ * Used for segmented process data where all frames of a cycle are ready at once.
+ * In redundant mode every frame also needs the dummy frame on the secondary
+ * socket, so the batch falls back to ecx_outframe_red() per frame.
+ * @param[in] port        = port context struct
+ * @param[in] idxlist     = indexes in tx buffer array, in transmit order
+ * @param[in] n           = number of indexes in idxlist
+ * @return number of frames transmitted
+ */
+int ecx_outframe_multi(ecx_portt *port, const uint8 *idxlist, int n)
+{
+   void *frames[EC_MAXBUF];
+   int lengths[EC_MAXBUF];
+   ec_etherheadert *ehp;
+   int i, sent;
+
+   if (n > EC_MAXBUF)
+   {
+      n = EC_MAXBUF;
+   }
+   if ((port->redstate != ECT_RED_NONE) || (port->stack.link->sendmulti == NULL))
+   {
+      sent = 0;
+      for (i = 0; i < n; i++)
+      {
+         if (ecx_outframe_red(port, idxlist[i]) > 0)
+         {
+            sent++;
+         }
+      }
+      return sent;
+   }
+   for (i = 0; i < n; i++)
+   {
+      ehp = (ec_etherheadert *)&(port->txbuf[idxlist[i]]);
+      /* rewrite MAC source address 1 to primary */
+      ehp->sa1 = htons(priMAC[1]);
+      frames[i] = &(port->txbuf[idxlist[i]]);
+      lengths[i] = port->txbuflength[idxlist[i]];
+      port->rxbufstat[idxlist[i]] = EC_BUF_TX;
+   }
+   sent = port->stack.link->sendmulti(&(port->stack), frames, lengths, n);
+   for (i = 0; i < sent; i++)
+   {
+      ecx_capture(port, EC_CAPTURE_TX, frames[i], lengths[i]);
+   }
+   /* frames not accepted by the link are retried one by one */
+   for (i = sent; i < n; i++)
+   {
+      if (ecx_outframe(port, idxlist[i], 0) > 0)
+      {
+         sent++;
+      }
+   }
+
+   return sent;
+}
+
 /** Non blocking read of socket. Put frame in temporary buffer.
  * @param[in] port        = port context struct
  * @param[in] stacknumber = 0=primary 1=secondary stack
@@ -348,21 +416,153 @@ static int ecx_recvpkt(ecx_portt *port, int stacknumber)
       stack = &(port->redport->stack);
    }
    lp = sizeof(port->tempinbuf);
-   bytesrx = recv(*stack->sock, (*stack->tempbuf), lp, 0);
+   bytesrx = stack->link->recv(stack, (*stack->tempbuf), lp);
    port->tempinbufs = bytesrx;
+   if (bytesrx > 0)
+   {
+      port->copystat.copies++;
+      port->copystat.bytes += bytesrx;
+      ecx_capture(port, EC_CAPTURE_RX | (stacknumber ? EC_CAPTURE_SECONDARY : 0), (*stack->tempbuf), bytesrx);
+   }
 
    return (bytesrx > 0);
 }
 
+/** Copy a received frame to the rx buffer of its index. If a destination is
+ * registered for the index, the datagram header and work counter are checked
+ * in place and the process data goes straight to the destination, the rx
+ * buffer only gets the headers, work counter and DC datagram. A frame with a
+ * low work counter carries invalid data of the slaves that did not process
+ * it and is kept in the rx buffer. Not used in redundant mode, where frames of
+ * both ports are combined in the rx buffers.
+ * @param[in] port        = port context struct
+ * @param[in] stack       = stack the frame was received on
+ * @param[in] idx         = index of frame
+ * @param[in] frame       = received frame including ethernet header
+ */
+static void ecx_rxcopy(ecx_portt *port, ec_stackT *stack, int idx, ec_bufT *frame)
+{
+   ec_rxdestt *rxdest = &(port->rxdest[idx]);
+   uint8 *rxbuf = (*stack->rxbuf)[idx];
+   uint8 *src = &(*frame)[ETH_HEADERSIZE];
+   ec_comt *rxp = (ec_comt *)src;
+   ec_comt *txp = (ec_comt *)&((*stack->txbuf)[idx][ETH_HEADERSIZE]);
+   int length = (*stack->txbuflength)[idx] - ETH_HEADERSIZE;
+   int tail;
+   int direct = FALSE;
+   uint16 le_wkc;
+
+   /* returned frame must have the layout of the transmitted one */
+   if (rxdest->dest && (port->redstate == ECT_RED_NONE) &&
+       (rxp->elength == txp->elength) && (rxp->command == txp->command) && (rxp->dlength == txp->dlength))
+   {
+      memcpy(&le_wkc, &src[EC_HEADERSIZE + (etohs(rxp->dlength) & 0x07ff)], EC_WKCSIZE);
+      direct = !rxdest->expectedwkc || (etohs(le_wkc) == rxdest->expectedwkc);
+   }
+   if (direct)
+   {
+      memcpy(rxbuf, src, rxdest->offset);
+      memcpy(rxdest->dest, &src[rxdest->offset], rxdest->length);
+      tail = rxdest->offset + rxdest->length;
+      memcpy(&rxbuf[tail], &src[tail], length - tail);
+      rxdest->done = TRUE;
+      port->copystat.copies++;
+      port->copystat.bytes += rxdest->length;
+   }
+   else
+   {
+      memcpy(rxbuf, src, length);
+      port->copystat.copies++;
+      port->copystat.bytes += length;
+   }
+}
+
+/** Store one received frame in the rx buffer of its index.
+ * @param[in] port        = port context struct
+ * @param[in] idx         = requested index of frame
+ * @param[in] stacknumber = 0=primary 1=secondary stack
+ * @param[in] frame       = received frame including ethernet header
+ * @return Workcounter if the frame has the requested index, otherwise
+ * EC_OTHERFRAME.
+ */
+static int ecx_rxframe(ecx_portt *port, int idx, int stacknumber, ec_bufT *frame)
+{
+   uint16  l;
+   int     rval;
+   int     idxf;
+   ec_etherheadert *ehp;
+   ec_comt *ecp;
+   ec_stackT *stack;
+   ec_bufT *rxbuf;
+
+   if (!stacknumber)
+   {
+      stack = &(port->stack);
+   }
+   else
+   {
+      stack = &(port->redport->stack);
+   }
+   rval = EC_OTHERFRAME;
+   ehp =(ec_etherheadert*)(frame);
+   /* check if it is an EtherCAT frame */
+   if (ehp->etype == htons(ETH_P_ECAT))
+   {
+      ecp =(ec_comt*)(&(*frame)[ETH_HEADERSIZE]);
+      l = etohs(ecp->elength) & 0x0fff;
+      idxf = ecp->index;
+      /* found index equals requested index ? */
+      if (idxf == idx)
+      {
+         rxbuf = &(*stack->rxbuf)[idx];
+         /* yes, put it in the buffer array (strip ethernet header) */
+         ecx_rxcopy(port, stack, idx, frame);
+         /* return WKC */
+         rval = ((*rxbuf)[l] + ((uint16)((*rxbuf)[l + 1]) << 8));
+         /* mark as completed */
+         (*stack->rxbufstat)[idx] = EC_BUF_COMPLETE;
+         /* store MAC source word 1 for redundant routing info */
+         (*stack->rxsa)[idx] = ntohs(ehp->sa1);
+      }
+      else
+      {
+         /* check if index exist and someone is waiting for it */
+         if (idxf < EC_MAXBUF && (*stack->rxbufstat)[idxf] == EC_BUF_TX)
+         {
+            /* put it in the buffer array (strip ethernet header) */
+            ecx_rxcopy(port, stack, idxf, frame);
+            /* mark as received */
+            (*stack->rxbufstat)[idxf] = EC_BUF_RCVD;
+            (*stack->rxsa)[idxf] = ntohs(ehp->sa1);
+         }
+         else
+         {
+            /* strange things happened */
+            port->rxstat.otherframes++;
+         }
+      }
+   }
+   else
+   {
+      /* should have been dropped by the socket filter */
+      port->rxstat.otherframes++;
+   }
+
+   return rval;
+}
+
 /** Non blocking receive frame function. Uses RX buffer and index to combine
  * read frame with transmitted frame. To compensate for received frames that
  * are out-of-order all frames are stored in their respective indexed buffer.
  * If a frame was placed in the buffer previously, the function retrieves it
  * from that buffer index without calling ec_recvpkt. If the requested index
- * is not already in the buffer it calls ec_recvpkt to fetch it. There are
+ * is not already in the buffer it reads from the socket. There are
  * three options now, 1 no frame read, so exit. 2 frame read but other
  * than requested index, store in buffer and exit. 3 frame read with matching
  * index, store in buffer, set completed flag in buffer status and exit.
+ * In single NIC mode all pending frames are read at once if the link
+ * supports it (recvmmsg), so the remaining frames of a segmented cycle are
+ * already buffered when they are requested.
  *
  * @param[in] port        = port context struct
  * @param[in] idx         = requested index of frame
@@ -374,9 +574,7 @@ int ecx_inframe(ecx_portt *port, int idx, int stacknumber)
 {
    uint16  l;
    int     rval;
-   int     idxf;
-   ec_etherheadert *ehp;
-   ec_comt *ecp;
+   int     i, n, wkc;
    ec_stackT *stack;
    ec_bufT *rxbuf;
 
@@ -402,48 +600,28 @@ int ecx_inframe(ecx_portt *port, int idx, int stacknumber)
    else
    {
       pthread_mutex_lock(&(port->rx_mutex));
-      /* non blocking call to retrieve frame from socket */
-      if (ecx_recvpkt(port, stacknumber))
+      if (!stacknumber && (port->redstate == ECT_RED_NONE) && (port->stack.link->recvmulti != NULL))
       {
-         rval = EC_OTHERFRAME;
-         ehp =(ec_etherheadert*)(stack->tempbuf);
-         /* check if it is an EtherCAT frame */
-         if (ehp->etype == htons(ETH_P_ECAT))
+         /* non blocking call to retrieve all pending frames from socket */
+         n = port->stack.link->recvmulti(&(port->stack), port->rxbatch, port->rxbatchlength, EC_MAXBUF);
+         port->tempinbufs = n;
+         for (i = 0; i < n; i++)
          {
-            ecp =(ec_comt*)(&(*stack->tempbuf)[ETH_HEADERSIZE]);
-            l = etohs(ecp->elength) & 0x0fff;
-            idxf = ecp->index;
-            /* found index equals requested index ? */
-            if (idxf == idx)
-            {
-               /* yes, put it in the buffer array (strip ethernet header) */
-               memcpy(rxbuf, &(*stack->tempbuf)[ETH_HEADERSIZE], (*stack->txbuflength)[idx] - ETH_HEADERSIZE);
-               /* return WKC */
-               rval = ((*rxbuf)[l] + ((uint16)((*rxbuf)[l + 1]) << 8));
-               /* mark as completed */
-               (*stack->rxbufstat)[idx] = EC_BUF_COMPLETE;
-               /* store MAC source word 1 for redundant routing info */
-               (*stack->rxsa)[idx] = ntohs(ehp->sa1);
-            }
-            else
+            port->copystat.copies++;
+            port->copystat.bytes += port->rxbatchlength[i];
+            ecx_capture(port, EC_CAPTURE_RX, &(port->rxbatch[i]), port->rxbatchlength[i]);
+            wkc = ecx_rxframe(port, idx, stacknumber, &(port->rxbatch[i]));
+            if ((wkc > EC_NOFRAME) || (rval == EC_NOFRAME))
             {
-               /* check if index exist and someone is waiting for it */
-               if (idxf < EC_MAXBUF && (*stack->rxbufstat)[idxf] == EC_BUF_TX)
-               {
-                  rxbuf = &(*stack->rxbuf)[idxf];
-                  /* put it in the buffer array (strip ethernet header) */
-                  memcpy(rxbuf, &(*stack->tempbuf)[ETH_HEADERSIZE], (*stack->txbuflength)[idxf] - ETH_HEADERSIZE);
-                  /* mark as received */
-                  (*stack->rxbufstat)[idxf] = EC_BUF_RCVD;
-                  (*stack->rxsa)[idxf] = ntohs(ehp->sa1);
-               }
-               else
-               {
-                  /* strange things happened */
-               }
+               rval = wkc;
             }
          }
       }
+      /* non blocking call to retrieve frame from socket */
+      else if (ecx_recvpkt(port, stacknumber))
+      {
+         rval = ecx_rxframe(port, idx, stacknumber, stack->tempbuf);
+      }
       pthread_mutex_unlock( &(port->rx_mutex) );
 
    }
@@ -470,6 +648,7 @@ static int ecx_waitinframe_red(ecx_portt *port, int idx, osal_timert *timer)
    int wkc  = EC_NOFRAME;
    int wkc2 = EC_NOFRAME;
    int primrx, secrx;
+   struct timespec t0, t1;
 
    /* if not in redundant mode then always assume secondary is OK */
    if (port->redstate == ECT_RED_NONE)
@@ -519,6 +698,7 @@ static int ecx_waitinframe_red(ecx_portt *port, int idx, osal_timert *timer)
             /* copy primary rx to tx buffer */
             memcpy(&(port->txbuf[idx][ETH_HEADERSIZE]), &(port->rxbuf[idx]), port->txbuflength[idx] - ETH_HEADERSIZE);
          }
+         clock_gettime(CLOCK_MONOTONIC, &t0);
          osal_timer_start (&timer2, EC_TIMEOUTRET);
          /* resend secondary tx */
          ecx_outframe(port, idx, 1);
@@ -533,6 +713,17 @@ static int ecx_waitinframe_red(ecx_portt *port, int idx, osal_timert *timer)
             memcpy(&(port->rxbuf[idx]), &(port->redport->rxbuf[idx]), port->txbuflength[idx] - ETH_HEADERSIZE);
             wkc = wkc2;
          }
+         clock_gettime(CLOCK_MONOTONIC, &t1);
+         port->redstat.resends++;
+         port->redstat.extratime += (uint64)(t1.tv_sec - t0.tv_sec) * 1000000000ULL
+                                  + t1.tv_nsec - t0.tv_nsec;
+      }
+      /* ring is closed only if each frame returned on the opposite port */
+      port->redstat.rxports = (primrx ? EC_REDRX_PRIMARY : 0) | (secrx ? EC_REDRX_SECONDARY : 0);
+      port->redstat.linebreak = !((primrx == RX_SEC) && (secrx == RX_PRIM));
+      if (port->redstat.linebreak)
+      {
+         port->redstat.linebreaks++;
       }
    }
 
@@ -597,6 +788,31 @@ int ecx_srconfirm(ecx_portt *port, int idx, int timeout)
    return wkc;
 }
 
+/** Update and return receive statistics of the primary and secondary port.
+ * Frames rejected by the socket filter are not counted, the kernel keeps no
+ * counter for them.
+ * @param[in] port        = port context struct
+ * @param[out] stats      = receive statistics
+ */
+void ecx_rxstats(ecx_portt *port, ec_rxstatt *stats)
+{
+   uint32 packets, drops;
+
+   if (port->stack.link && port->stack.link->stats &&
+       port->stack.link->stats(&(port->stack), &packets, &drops))
+   {
+      port->rxstat.packets += packets;
+      port->rxstat.drops += drops;
+   }
+   if (port->redport && port->redport->stack.link && port->redport->stack.link->stats &&
+       port->redport->stack.link->stats(&(port->redport->stack), &packets, &drops))
+   {
+      port->rxstat.packets += packets;
+      port->rxstat.drops += drops;
+   }
+   *stats = port->rxstat;
+}
+
 #ifdef EC_VER1
 int ec_setupnic(const char *ifname, int secondary)
 {
@@ -608,6 +824,11 @@ int ec_closenic(void)
    return ecx_closenic(&ecx_port);
 }
 
+void ec_rxstats(ec_rxstatt *stats)
+{
+   ecx_rxstats(&ecx_port, stats);
+}
+
 int ec_getindex(void)
 {
    return ecx_getindex(&ecx_port);
@@ -628,6 +849,11 @@ int ec_outframe_red(int idx)
    return ecx_outframe_red(&ecx_port, idx);
 }
 
+int ec_outframe_multi(const uint8 *idxlist, int n)
+{
+   return ecx_outframe_multi(&ecx_port, idxlist, n);
+}
+
 int ec_inframe(int idx, int stacknumber)
 {
    return ecx_inframe(&ecx_port, idx, stacknumber);
@@ -18,9 +18,17 @@ extern "C"
 
 #include <pthread.h>
 
+/** link layer operations, see linkdrv.h */
+typedef struct ec_link ec_linkt;
+typedef struct ec_capture ec_capturet;
+
 /** pointer structure to Tx and Rx stacks */
-typedef struct
+typedef struct ec_stack
 {
+   /** link layer used by this stack */
+   const ec_linkt *link;
+   /** link private data */
+   void        *linkdata;
    /** socket connection used */
    int         *sock;
    /** tx buffer */
@@ -52,6 +60,60 @@ typedef struct
    ec_bufT tempinbuf;
 } ecx_redportt;
 
+/** redundancy diagnostics of a port, updated by every received frame */
+typedef struct
+{
+   /** ports the last frame returned on, EC_REDRX_PRIMARY | EC_REDRX_SECONDARY */
+   int         rxports;
+   /** ring was open on the last frame */
+   boolean     linebreak;
+   /** number of frames that found the ring open */
+   uint32      linebreaks;
+   /** number of frames resent over the secondary port */
+   uint32      resends;
+   /** accumulated time spent in resends in ns */
+   uint64      extratime;
+} ec_redstatt;
+
+/** redundancy receive port flags */
+#define EC_REDRX_PRIMARY   0x01
+#define EC_REDRX_SECONDARY 0x02
+
+/** receive statistics of a port */
+typedef struct
+{
+   /** frames passed to the socket by the kernel */
+   uint64      packets;
+   /** frames dropped by the kernel, socket queue full */
+   uint64      drops;
+   /** frames received that did not belong to a pending index */
+   uint64      otherframes;
+} ec_rxstatt;
+
+/** destination of the process data of a pending frame */
+typedef struct
+{
+   /** destination, NULL to keep the data in the rx buffer */
+   uint8       *dest;
+   /** offset of the data in the frame without ethernet header */
+   uint16      offset;
+   /** data length */
+   uint16      length;
+   /** work counter the frame has to return with, otherwise the data stays in the rx buffer, 0 = not checked */
+   uint16      expectedwkc;
+   /** data was copied to the destination on receive */
+   boolean     done;
+} ec_rxdestt;
+
+/** payload copies made by the receive path */
+typedef struct
+{
+   /** number of copies */
+   uint64      copies;
+   /** bytes copied */
+   uint64      bytes;
+} ec_copystatt;
+
 /** pointer structure to buffers, vars and mutexes for port instantiation */
 typedef struct
 {
@@ -67,6 +129,10 @@ typedef struct
    ec_bufT tempinbuf;
    /** temporary rx buffer status */
    int tempinbufs;
+   /** batch rx buffers, filled by one recvmmsg call */
+   ec_bufT rxbatch[EC_MAXBUF];
+   /** batch rx buffer lengths */
+   int rxbatchlength[EC_MAXBUF];
    /** transmit buffers */
    ec_bufT txbuf[EC_MAXBUF];
    /** transmit buffer lengths */
@@ -81,6 +147,16 @@ typedef struct
    int redstate;
    /** pointer to redundancy port and buffers */
    ecx_redportt *redport;
+   /** redundancy diagnostics */
+   ec_redstatt redstat;
+   /** receive statistics */
+   ec_rxstatt rxstat;
+   /** direct receive destinations */
+   ec_rxdestt rxdest[EC_MAXBUF];
+   /** receive copy statistics */
+   ec_copystatt copystat;
+   /** capture ring of recent frames, NULL if disabled */
+   ec_capturet *capture;
    pthread_mutex_t getindex_mutex;
    pthread_mutex_t tx_mutex;
    pthread_mutex_t rx_mutex;
@@ -95,10 +171,12 @@ extern ecx_redportt  ecx_redport;
 
 int ec_setupnic(const char * ifname, int secondary);
 int ec_closenic(void);
+void ec_rxstats(ec_rxstatt *stats);
 void ec_setbufstat(int idx, int bufstat);
 int ec_getindex(void);
 int ec_outframe(int idx, int sock);
 int ec_outframe_red(int idx);
+int ec_outframe_multi(const uint8 *idxlist, int n);
 int ec_waitinframe(int idx, int timeout);
 int ec_srconfirm(int idx,int timeout);
 #endif
@@ -106,10 +184,12 @@ int ec_srconfirm(int idx,int timeout);
 void ec_setupheader(void *p);
 int ecx_setupnic(ecx_portt *port, const char * ifname, int secondary);
 int ecx_closenic(ecx_portt *port);
+void ecx_rxstats(ecx_portt *port, ec_rxstatt *stats);
 void ecx_setbufstat(ecx_portt *port, int idx, int bufstat);
 int ecx_getindex(ecx_portt *port);
 int ecx_outframe(ecx_portt *port, int idx, int sock);
 int ecx_outframe_red(ecx_portt *port, int idx);
+int ecx_outframe_multi(ecx_portt *port, const uint8 *idxlist, int n);
 int ecx_waitinframe(ecx_portt *port, int idx, int timeout);
 int ecx_srconfirm(ecx_portt *port, int idx,int timeout);
 
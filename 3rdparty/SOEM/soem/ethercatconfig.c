@@ -12,6 +12,7 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "osal.h"
 #include "oshw.h"
@@ -23,19 +24,16 @@
 #include "ethercatconfig.h"
 
 
+/** one mapper thread, the mapper state lives on the stack of the configuring
+ * thread so several contexts can be configured at the same time */
 typedef struct
 {
    int thread_n;
-   int running;
+   int nthreads;
    ecx_contextt *context;
-   uint16 slave;
+   uint8 group;
 } ecx_mapt_t;
 
-ecx_mapt_t ecx_mapt[EC_MAX_MAPT];
-#if EC_MAX_MAPT > 1
-OSAL_THREAD_HANDLE ecx_threadh[EC_MAX_MAPT];
-#endif
-
 #ifdef EC_VER1
 /** Slave configuration structure */
 typedef const struct
@@ -803,85 +801,68 @@ static int ecx_map_sm(ecx_contextt *context, uint16 slave)
 }
 
 #if EC_MAX_MAPT > 1
+/** Mapper thread n reads the CoE/SoE mapping of slave n + 1, n + 1 + nthreads,
+ * and so on. The mailbox round trips of the slaves overlap, each thread uses
+ * its own PDO assign buffers of the context (thread_n).
+ */
 OSAL_THREAD_FUNC ecx_mapper_thread(void *param)
 {
    ecx_mapt_t *maptp;
-   maptp = param;
-   ecx_map_coe_soe(maptp->context, maptp->slave, maptp->thread_n);
-   maptp->running = 0;
-}
+   int slave;
 
-static int ecx_find_mapt(void)
-{
-   int p;
-   p = 0;
-   while((p < EC_MAX_MAPT) && ecx_mapt[p].running)
-   {
-      p++;
-   }
-   if(p < EC_MAX_MAPT)
-   {
-      return p;
-   }
-   else
+   maptp = param;
+   for (slave = maptp->thread_n + 1; slave <= *(maptp->context->slavecount); slave += maptp->nthreads)
    {
-      return -1;
+      if (!maptp->group || (maptp->group == maptp->context->slavelist[slave].group))
+      {
+         ecx_map_coe_soe(maptp->context, (uint16)slave, maptp->thread_n);
+      }
    }
 }
 #endif
 
-static int ecx_get_threadcount(void)
-{
-   int thrc, thrn;
-   thrc = 0;
-   for(thrn = 0 ; thrn < EC_MAX_MAPT ; thrn++)
-   {
-      thrc += ecx_mapt[thrn].running;
-   }
-   return thrc;
-}
-
 static void ecx_config_find_mappings(ecx_contextt *context, uint8 group)
 {
-   int thrn, thrc;
    uint16 slave;
+#if EC_MAX_MAPT > 1
+   ecx_mapt_t mapt[EC_MAX_MAPT];
+   OSAL_THREAD_HANDLE threadh[EC_MAX_MAPT];
+   boolean started[EC_MAX_MAPT];
+   int thrn, nthreads;
 
-   for (thrn = 0; thrn < EC_MAX_MAPT; thrn++)
+   /* find CoE and SoE mapping of slaves in multiple threads */
+   nthreads = (*(context->slavecount) < EC_MAX_MAPT) ? *(context->slavecount) : EC_MAX_MAPT;
+   for (thrn = 0; thrn < nthreads; thrn++)
    {
-      ecx_mapt[thrn].running = 0;
+      mapt[thrn].context = context;
+      mapt[thrn].group = group;
+      mapt[thrn].thread_n = thrn;
+      mapt[thrn].nthreads = nthreads;
+      started[thrn] = osal_thread_create(&(threadh[thrn]), 128000, &ecx_mapper_thread, &(mapt[thrn]));
+      if (!started[thrn])
+      {
+         /* no thread, map its slaves here */
+         ecx_mapper_thread(&(mapt[thrn]));
+      }
    }
-   /* find CoE and SoE mapping of slaves in multiple threads */
-   for (slave = 1; slave <= *(context->slavecount); slave++)
+   /* wait for all threads to finish and release their stacks */
+   for (thrn = 0; thrn < nthreads; thrn++)
    {
-      if (!group || (group == context->slavelist[slave].group))
+      if (started[thrn])
       {
-#if EC_MAX_MAPT > 1
-            /* multi-threaded version */
-            while ((thrn = ecx_find_mapt()) < 0)
-            {
-               osal_usleep(1000);
-            }
-            ecx_mapt[thrn].context = context;
-            ecx_mapt[thrn].slave = slave;
-            ecx_mapt[thrn].thread_n = thrn;
-            ecx_mapt[thrn].running = 1;
-            osal_thread_create(&(ecx_threadh[thrn]), 128000,
-               &ecx_mapper_thread, &(ecx_mapt[thrn]));
-#else
-            /* serialised version */
-            ecx_map_coe_soe(context, slave, 0);
-#endif
+         osal_thread_join(&(threadh[thrn]));
       }
    }
-   /* wait for all threads to finish */
-   do
+#else
+   /* serialised version */
+   for (slave = 1; slave <= *(context->slavecount); slave++)
    {
-      thrc = ecx_get_threadcount();
-      if (thrc)
+      if (!group || (group == context->slavelist[slave].group))
       {
-         osal_usleep(1000);
+         ecx_map_coe_soe(context, slave, 0);
       }
-   } while (thrc);
+   }
+#endif
    /* find SII mapping of slave and program SM */
    for (slave = 1; slave <= *(context->slavecount); slave++)
    {
@@ -893,6 +874,16 @@ static void ecx_config_find_mappings(ecx_contextt *context, uint8 group)
    }
 }
 
+/** Address of offset in an IOmap. Computed on integers: the IOmap of a sizing
+ * pass in ecx_config_map_group_alloc() is no object, pointer arithmetic on it
+ * would be undefined. The addresses are only stored, never dereferenced,
+ * until the group is rebased to a real IOmap.
+ */
+static uint8 *ecx_iomap_address(void *pIOmap, uint32 offset)
+{
+   return (uint8 *)((uintptr_t)pIOmap + offset);
+}
+
 static void ecx_config_create_input_mappings(ecx_contextt *context, void *pIOmap, 
    uint8 group, int16 slave, uint32 * LogAddr, uint8 * BitPos)
 {
@@ -1010,15 +1001,14 @@ static void ecx_config_create_input_mappings(ecx_contextt *context, void *pIOmap
          if (group)
          {
             context->slavelist[slave].inputs =
-               (uint8 *)(pIOmap) + 
-               etohl(context->slavelist[slave].FMMU[FMMUc].LogStart) - 
-               context->grouplist[group].logstartaddr;
+               ecx_iomap_address(pIOmap,
+               etohl(context->slavelist[slave].FMMU[FMMUc].LogStart) - context->grouplist[group].logstartaddr);
          }
          else
          {
             context->slavelist[slave].inputs =
-               (uint8 *)(pIOmap) +
-               etohl(context->slavelist[slave].FMMU[FMMUc].LogStart);
+               ecx_iomap_address(pIOmap,
+               etohl(context->slavelist[slave].FMMU[FMMUc].LogStart));
          }
          context->slavelist[slave].Istartbit =
             context->slavelist[slave].FMMU[FMMUc].LogStartbit;
@@ -1138,15 +1128,14 @@ static void ecx_config_create_output_mappings(ecx_contextt *context, void *pIOma
          if (group)
          {
             context->slavelist[slave].outputs =
-               (uint8 *)(pIOmap) + 
-               etohl(context->slavelist[slave].FMMU[FMMUc].LogStart) - 
-               context->grouplist[group].logstartaddr;
+               ecx_iomap_address(pIOmap,
+               etohl(context->slavelist[slave].FMMU[FMMUc].LogStart) - context->grouplist[group].logstartaddr);
          }
          else
          {
             context->slavelist[slave].outputs =
-               (uint8 *)(pIOmap) + 
-               etohl(context->slavelist[slave].FMMU[FMMUc].LogStart);
+               ecx_iomap_address(pIOmap,
+               etohl(context->slavelist[slave].FMMU[FMMUc].LogStart));
          }
          context->slavelist[slave].Ostartbit =
             context->slavelist[slave].FMMU[FMMUc].LogStartbit;
@@ -1185,6 +1174,7 @@ int ecx_config_map_group(ecx_contextt *context, void *pIOmap, uint8 group)
       LogAddr = context->grouplist[group].logstartaddr;
       oLogAddr = LogAddr;
       BitPos = 0;
+      ecx_invalidate_plan(context, group);
       context->grouplist[group].nsegments = 0;
       context->grouplist[group].outputsWKC = 0;
       context->grouplist[group].inputsWKC = 0;
@@ -1319,13 +1309,13 @@ int ecx_config_map_group(ecx_contextt *context, void *pIOmap, uint8 group)
       }
       context->grouplist[group].IOsegment[currentsegment] = segmentsize;
       context->grouplist[group].nsegments = currentsegment + 1;
-      context->grouplist[group].inputs = (uint8 *)(pIOmap) + context->grouplist[group].Obytes;
+      context->grouplist[group].inputs = ecx_iomap_address(pIOmap, context->grouplist[group].Obytes);
       context->grouplist[group].Ibytes = LogAddr - 
          context->grouplist[group].logstartaddr - 
          context->grouplist[group].Obytes;
       if (!group)
       {
-         context->slavelist[0].inputs = (uint8 *)(pIOmap) + context->slavelist[0].Obytes;
+         context->slavelist[0].inputs = ecx_iomap_address(pIOmap, context->slavelist[0].Obytes);
          context->slavelist[0].Ibytes = LogAddr - 
             context->grouplist[group].logstartaddr - 
             context->slavelist[0].Obytes; /* store input bytes in master record */
@@ -1366,6 +1356,7 @@ int ecx_config_overlap_map_group(ecx_contextt *context, void *pIOmap, uint8 grou
       siLogAddr = mLogAddr;
       soLogAddr = mLogAddr;
       BitPos = 0;
+      ecx_invalidate_plan(context, group);
       context->grouplist[group].nsegments = 0;
       context->grouplist[group].outputsWKC = 0;
       context->grouplist[group].inputsWKC = 0;
@@ -1452,12 +1443,13 @@ int ecx_config_overlap_map_group(ecx_contextt *context, void *pIOmap, uint8 grou
       context->grouplist[group].Obytes = soLogAddr - context->grouplist[group].logstartaddr;
       context->grouplist[group].Ibytes = siLogAddr - context->grouplist[group].logstartaddr;
       context->grouplist[group].outputs = pIOmap;
-      context->grouplist[group].inputs = (uint8 *)pIOmap + context->grouplist[group].Obytes;
+      context->grouplist[group].inputs = ecx_iomap_address(pIOmap, context->grouplist[group].Obytes);
 
       /* Move calculated inputs with OBytes offset*/
       for (slave = 1; slave <= *(context->slavecount); slave++)
       {
-         context->slavelist[slave].inputs += context->grouplist[group].Obytes;
+         context->slavelist[slave].inputs =
+            ecx_iomap_address(context->slavelist[slave].inputs, context->grouplist[group].Obytes);
       }
 
       if (!group)
@@ -1465,7 +1457,7 @@ int ecx_config_overlap_map_group(ecx_contextt *context, void *pIOmap, uint8 grou
          /* store output bytes in master record */
          context->slavelist[0].outputs = pIOmap;
          context->slavelist[0].Obytes = soLogAddr - context->grouplist[group].logstartaddr; 
-         context->slavelist[0].inputs = (uint8 *)pIOmap + context->slavelist[0].Obytes;
+         context->slavelist[0].inputs = ecx_iomap_address(pIOmap, context->slavelist[0].Obytes);
          context->slavelist[0].Ibytes = siLogAddr - context->grouplist[group].logstartaddr;
       }
 
@@ -1596,6 +1588,102 @@ int ecx_reconfig_slave(ecx_contextt *context, uint16 slave, int timeout)
    return state;
 }
 
+/** Move the process image of a mapped group to another IOmap. Mapping only
+ * computes the slave and group pointers relative to pIOmap, it does not touch
+ * the IOmap itself, so a group can be mapped first and the IOmap allocated
+ * when the size is known.
+ *
+ * @param[in]  context    = context struct
+ * @param[out] pIOmap     = pointer to new IOmap, at least the mapped size
+ * @param[in]  group      = group to move, 0 = all groups
+ * @return >0 if OK
+ */
+int ecx_config_rebase_group(ecx_contextt *context, void *pIOmap, uint8 group)
+{
+   ec_groupt *grp;
+   uintptr_t oldmap;
+   uint16 slave;
+
+   if ((group >= context->maxgroup) || (pIOmap == NULL))
+   {
+      return 0;
+   }
+   grp = &(context->grouplist[group]);
+   oldmap = (uintptr_t)grp->outputs;
+   if (!oldmap)
+   {
+      return 0;
+   }
+   for (slave = 1; slave <= *(context->slavecount); slave++)
+   {
+      if (!group || (group == context->slavelist[slave].group))
+      {
+         if (context->slavelist[slave].outputs)
+         {
+            context->slavelist[slave].outputs =
+               ecx_iomap_address(pIOmap, (uint32)((uintptr_t)context->slavelist[slave].outputs - oldmap));
+         }
+         if (context->slavelist[slave].inputs)
+         {
+            context->slavelist[slave].inputs =
+               ecx_iomap_address(pIOmap, (uint32)((uintptr_t)context->slavelist[slave].inputs - oldmap));
+         }
+      }
+   }
+   grp->inputs = ecx_iomap_address(pIOmap, (uint32)((uintptr_t)grp->inputs - oldmap));
+   grp->outputs = pIOmap;
+   if (!group)
+   {
+      context->slavelist[0].outputs = grp->outputs;
+      context->slavelist[0].inputs = grp->inputs;
+   }
+   ecx_invalidate_plan(context, group);
+
+   return 1;
+}
+
+/** Map all PDOs in one group of slaves to an IOmap allocated with the exact
+ * size of the mapping, instead of a worst case sized IOmap of the caller.
+ * Allocate before going to operational, the IOmap lives until freed by the
+ * caller with free().
+ *
+ * @param[in]  context    = context struct
+ * @param[in]  group      = group to map, 0 = all groups
+ * @param[in]  overlap    = TRUE to map outputs and inputs overlapping
+ * @param[out] size       = IOmap size
+ * @return pointer to IOmap, NULL if nothing was mapped or out of memory
+ */
+void *ecx_config_map_group_alloc(ecx_contextt *context, uint8 group, boolean overlap, int *size)
+{
+   /* any address but NULL, which marks a slave without data, see ecx_iomap_address() */
+   void *sizing = (void *)(uintptr_t)EC_MAXLRWDATA;
+   void *pIOmap;
+   int n;
+
+   *size = 0;
+   if (overlap)
+   {
+      n = ecx_config_overlap_map_group(context, sizing, group);
+   }
+   else
+   {
+      n = ecx_config_map_group(context, sizing, group);
+   }
+   if (n <= 0)
+   {
+      return NULL;
+   }
+   pIOmap = calloc(1, n);
+   if (pIOmap == NULL)
+   {
+      return NULL;
+   }
+   ecx_config_rebase_group(context, pIOmap, group);
+   *size = n;
+
+   return pIOmap;
+}
+
 #ifdef EC_VER1
 /** Enumerate and init all slaves.
  *
@@ -1656,6 +1744,30 @@ int ec_config_overlap_map(void *pIOmap)
    return ec_config_overlap_map_group(pIOmap, 0);
 }
 
+/** Move the process image of a mapped group to another IOmap.
+ *
+ * @param[out] pIOmap     = pointer to new IOmap
+ * @param[in]  group      = group to move, 0 = all groups
+ * @return >0 if OK
+ * @see ecx_config_rebase_group
+ */
+int ec_config_rebase_group(void *pIOmap, uint8 group)
+{
+   return ecx_config_rebase_group(&ecx_context, pIOmap, group);
+}
+
+/** Map all PDOs from slaves to an IOmap allocated with the exact size.
+ *
+ * @param[in]  overlap    = TRUE to map outputs and inputs overlapping
+ * @param[out] size       = IOmap size
+ * @return pointer to IOmap, free with free()
+ * @see ecx_config_map_group_alloc
+ */
+void *ec_config_map_alloc(boolean overlap, int *size)
+{
+   return ecx_config_map_group_alloc(&ecx_context, 0, overlap, size);
+}
+
 /** Enumerate / map and init all slaves.
  *
  * @param[in] usetable    = TRUE when using configtable to init slaves, FALSE otherwise
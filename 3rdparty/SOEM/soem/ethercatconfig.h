@@ -27,6 +27,8 @@ int ec_config_map_group(void *pIOmap, uint8 group);
 int ec_config_overlap_map_group(void *pIOmap, uint8 group);
 int ec_config(uint8 usetable, void *pIOmap);
 int ec_config_overlap(uint8 usetable, void *pIOmap);
+int ec_config_rebase_group(void *pIOmap, uint8 group);
+void *ec_config_map_alloc(boolean overlap, int *size);
 int ec_recover_slave(uint16 slave, int timeout);
 int ec_reconfig_slave(uint16 slave, int timeout);
 #endif
@@ -34,6 +36,8 @@ int ec_reconfig_slave(uint16 slave, int timeout);
 int ecx_config_init(ecx_contextt *context, uint8 usetable);
 int ecx_config_map_group(ecx_contextt *context, void *pIOmap, uint8 group);
 int ecx_config_overlap_map_group(ecx_contextt *context, void *pIOmap, uint8 group);
+int ecx_config_rebase_group(ecx_contextt *context, void *pIOmap, uint8 group);
+void *ecx_config_map_group_alloc(ecx_contextt *context, uint8 group, boolean overlap, int *size);
 int ecx_recover_slave(ecx_contextt *context, uint16 slave, int timeout);
 int ecx_reconfig_slave(ecx_contextt *context, uint16 slave, int timeout);
 
@@ -265,6 +265,11 @@ boolean ecx_configdc(ecx_contextt *context)
 
    context->slavelist[0].hasdc = FALSE;
    context->grouplist[0].hasdc = FALSE;
+   /* DC datagram of the cyclic frames changes */
+   for (i = 0; i < context->maxgroup; i++)
+   {
+      ecx_invalidate_plan(context, (uint8)i);
+   }
    ht = 0;
 
    ecx_BWR(context->port, 0, ECT_REG_DCTIME0, sizeof(ht), &ht, EC_TIMEOUTRET);  /* latch DCrecvTimeA of all slaves */
@@ -430,6 +435,67 @@ boolean ecx_configdc(ecx_contextt *context)
    return context->slavelist[0].hasdc;
 }
 
+/** frames of the static drift compensation in flight at the same time */
+#define EC_DCDRIFTFRAMES 4
+
+/**
+ * Static drift compensation before the cyclic process data starts. The
+ * system time of the reference clock is distributed count times with FRMW
+ * datagrams. As many datagrams as fit go into one frame and several frames
+ * are in flight, so the 15000 datagrams recommended by ETG.1000 take a few
+ * hundred frames instead of 15000 round trips.
+ *
+ * @param[in]  context        = context struct
+ * @param[in]  count          = number of FRMW datagrams
+ * @return number of datagrams in frames that returned, 0 if there is no DC slave
+ */
+int ecx_dcdrift(ecx_contextt *context, int count)
+{
+   ecx_portt *port = context->port;
+   uint16 refadr;
+   int perframe, nframes, frame, i, done;
+   uint8 idx[EC_DCDRIFTFRAMES];
+   int n[EC_DCDRIFTFRAMES];
+   int64 t = 0;
+
+   if (!context->slavelist[0].hasdc)
+   {
+      return 0;
+   }
+   refadr = context->slavelist[context->slavelist[0].DCnext].configadr;
+   perframe = (EC_MAXLRWDATA + EC_HEADERSIZE) / (EC_HEADERSIZE - EC_ELENGTHSIZE + sizeof(t) + EC_WKCSIZE);
+   done = 0;
+   while (count > 0)
+   {
+      nframes = 0;
+      while ((count > 0) && (nframes < EC_DCDRIFTFRAMES))
+      {
+         n[nframes] = (count > perframe) ? perframe : count;
+         idx[nframes] = ecx_getindex(port);
+         ecx_setupdatagram(port, &(port->txbuf[idx[nframes]]), EC_CMD_FRMW, idx[nframes],
+            refadr, ECT_REG_DCSYSTIME, sizeof(t), &t);
+         for (i = 1; i < n[nframes]; i++)
+         {
+            ecx_adddatagram(port, &(port->txbuf[idx[nframes]]), EC_CMD_FRMW, idx[nframes], (i < (n[nframes] - 1)),
+               refadr, ECT_REG_DCSYSTIME, sizeof(t), &t);
+         }
+         ecx_outframe_red(port, idx[nframes]);
+         count -= n[nframes];
+         nframes++;
+      }
+      for (frame = 0; frame < nframes; frame++)
+      {
+         if (ecx_waitinframe(port, idx[frame], EC_TIMEOUTRET) > EC_NOFRAME)
+         {
+            done += n[frame];
+         }
+         ecx_setbufstat(port, idx[frame], EC_BUF_EMPTY);
+      }
+   }
+
+   return done;
+}
+
 #ifdef EC_VER1
 void ec_dcsync0(uint16 slave, boolean act, uint32 CyclTime, int32 CyclShift)
 {
@@ -445,4 +511,9 @@ boolean ec_configdc(void)
 {
    return ecx_configdc(&ecx_context);
 }
+
+int ec_dcdrift(int count)
+{
+   return ecx_dcdrift(&ecx_context, count);
+}
 #endif
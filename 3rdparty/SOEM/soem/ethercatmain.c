@@ -120,7 +120,8 @@ ecx_contextt  ecx_context = {
     &ec_FMMU,           // .eepFMMU       =
     NULL,               // .FOEhook()
     NULL,               // .EOEhook()
-    0                   // .manualstatechange
+    0,                  // .manualstatechange
+    NULL                // .siicache
 };
 #endif
 
@@ -153,6 +154,12 @@ void ec_free_adapters (ec_adaptert * adapter)
  */
 void ecx_pusherror(ecx_contextt *context, const ec_errort *Ec)
 {
+#if EC_MAX_MAPT > 1
+   /* mailbox errors can be pushed by several mapper threads at once */
+   while (__atomic_test_and_set(&(context->elist->lock), __ATOMIC_ACQUIRE))
+   {
+   }
+#endif
    context->elist->Error[context->elist->head] = *Ec;
    context->elist->Error[context->elist->head].Signal = TRUE;
    context->elist->head++;
@@ -168,6 +175,9 @@ void ecx_pusherror(ecx_contextt *context, const ec_errort *Ec)
    {
       context->elist->tail = 0;
    }
+#if EC_MAX_MAPT > 1
+   __atomic_clear(&(context->elist->lock), __ATOMIC_RELEASE);
+#endif
    *(context->ecaterror) = TRUE;
 }
 
@@ -323,9 +333,149 @@ void ecx_close(ecx_contextt *context)
    ecx_closenic(context->port);
 };
 
+/** Read one EEPROM chunk of 4 or 8 bytes into a cache buffer and mark it in
+ *  the bitmap of the buffer.
+ *  @param[in] context = context struct
+ *  @param[in] slave   = slave number
+ *  @param[in] address = eeprom address in bytes
+ *  @param[out] buf    = cache buffer of EC_MAXEEPBUF bytes
+ *  @param[out] map    = bitmap of buf
+ */
+static void ecx_siireadchunk(ecx_contextt *context, uint16 slave, uint16 address, uint8 *buf, uint32 *map)
+{
+   uint16 configadr, eadr;
+   uint64 edat64;
+   uint32 edat32;
+   uint16 mapw, mapb;
+   int lp,cnt;
+
+   configadr = context->slavelist[slave].configadr;
+   ecx_eeprom2master(context, slave); /* set eeprom control to master */
+   eadr = address >> 1;
+   edat64 = ecx_readeepromFP (context, configadr, eadr, EC_TIMEOUTEEP);
+   /* 8 byte response */
+   if (context->slavelist[slave].eep_8byte)
+   {
+      put_unaligned64(edat64, &(buf[eadr << 1]));
+      cnt = 8;
+   }
+   /* 4 byte response */
+   else
+   {
+      edat32 = (uint32)edat64;
+      put_unaligned32(edat32, &(buf[eadr << 1]));
+      cnt = 4;
+   }
+   /* find bitmap location */
+   mapw = eadr >> 4;
+   mapb = (eadr << 1) - (mapw << 5);
+   for(lp = 0 ; lp < cnt ; lp++)
+   {
+      /* set bitmap for each byte that is read */
+      map[mapw] |= (1 << mapb);
+      mapb++;
+      if (mapb > 31)
+      {
+         mapb = 0;
+         mapw++;
+      }
+   }
+}
+
+/** Find the SII cache image of a slave. On first use for a slave the image of
+ *  its vendor, product and revision is looked up and checked against EEPROM
+ *  words 0x3E..0x41 of the slave. A new image is started if there is none, an
+ *  image loaded from disk that does not match is restarted.
+ *  @param[in] context = context struct
+ *  @param[in] slave   = slave number
+ *  @return image of the slave, NULL if the slave is not cached
+ */
+ec_siiimaget *ecx_siicache_image(ecx_contextt *context, uint16 slave)
+{
+   ec_siicachet *cache = context->siicache;
+   ec_slavet *sl = &(context->slavelist[slave]);
+   ec_siiimaget *img = NULL;
+   uint8 check[8];
+   uint64 edat64;
+   uint32 edat32;
+   uint16 configadr;
+   int i;
+
+   if ((cache == NULL) || (slave < 1) || (slave > *(context->slavecount)))
+   {
+      return NULL;
+   }
+   if (sl->siiimage)
+   {
+      return (sl->siiimage > 0) ? &(cache->image[sl->siiimage - 1]) : NULL;
+   }
+   sl->siiimage = -1;
+   /* identity is not read yet */
+   if (!sl->eep_man && !sl->eep_id)
+   {
+      return NULL;
+   }
+   configadr = sl->configadr;
+   ecx_eeprom2master(context, slave);
+   edat64 = ecx_readeepromFP(context, configadr, ECT_SII_START - 2, EC_TIMEOUTEEP);
+   if (!sl->eep_8byte)
+   {
+      edat32 = (uint32)edat64;
+      put_unaligned32(edat32, &check[0]);
+      edat32 = (uint32)ecx_readeepromFP(context, configadr, ECT_SII_START, EC_TIMEOUTEEP);
+      put_unaligned32(edat32, &check[4]);
+   }
+   else
+   {
+      put_unaligned64(edat64, &check[0]);
+   }
+   for (i = 0; i < cache->nimages; i++)
+   {
+      if ((cache->image[i].man == sl->eep_man) && (cache->image[i].id == sl->eep_id) &&
+          (cache->image[i].rev == sl->eep_rev))
+      {
+         img = &(cache->image[i]);
+         break;
+      }
+   }
+   if (img && (memcmp(img->check, check, sizeof(check)) != 0))
+   {
+      if (img->used)
+      {
+         /* same type with another EEPROM content in this network, read it directly */
+         return NULL;
+      }
+      /* image from disk is stale */
+      memset(img->map, 0, sizeof(img->map));
+      memcpy(img->check, check, sizeof(check));
+      img->dirty = TRUE;
+   }
+   if (img == NULL)
+   {
+      if (cache->nimages >= EC_MAXSIICACHE)
+      {
+         return NULL;
+      }
+      i = cache->nimages++;
+      img = &(cache->image[i]);
+      memset(img, 0, sizeof(ec_siiimaget));
+      img->man = sl->eep_man;
+      img->id = sl->eep_id;
+      img->rev = sl->eep_rev;
+      memcpy(img->check, check, sizeof(check));
+      img->dirty = TRUE;
+   }
+   img->used = TRUE;
+   sl->siiimage = (int16)(i + 1);
+
+   return img;
+}
+
 /** Read one byte from slave EEPROM via cache.
  *  If the cache location is empty then a read request is made to the slave.
  *  Depending on the slave capabilities the request is 4 or 8 bytes.
+ *  With a SII cache in the context, the categories are shared by all slaves of
+ *  the same type, only the config area is read per slave.
  *  @param[in] context = context struct
  *  @param[in] slave   = slave number
  *  @param[in] address = eeprom address in bytes (slave uses words)
@@ -333,14 +483,28 @@ void ecx_close(ecx_contextt *context)
  */
 uint8 ecx_siigetbyte(ecx_contextt *context, uint16 slave, uint16 address)
 {
-   uint16 configadr, eadr;
-   uint64 edat64;
-   uint32 edat32;
    uint16 mapw, mapb;
-   int lp,cnt;
    uint8 retval;
+   ec_siiimaget *img;
 
    retval = 0xff;
+   if ((address >= EC_SIICACHESTART) && (address < EC_MAXEEPBUF) &&
+       ((img = ecx_siicache_image(context, slave)) != NULL))
+   {
+      mapw = address >> 5;
+      mapb = address - (mapw << 5);
+      if (img->map[mapw] & (uint32)(1 << mapb))
+      {
+         context->siicache->hits++;
+      }
+      else
+      {
+         ecx_siireadchunk(context, slave, address, img->buf, img->map);
+         context->siicache->reads++;
+         img->dirty = TRUE;
+      }
+      return img->buf[address];
+   }
    if (slave != context->esislave) /* not the same slave? */
    {
       memset(context->esimap, 0x00, EC_MAXEEPBITMAP * sizeof(uint32)); /* clear esibuf cache map */
@@ -350,47 +514,12 @@ uint8 ecx_siigetbyte(ecx_contextt *context, uint16 slave, uint16 address)
    {
       mapw = address >> 5;
       mapb = address - (mapw << 5);
-      if (context->esimap[mapw] & (uint32)(1 << mapb))
-      {
-         /* byte is already in buffer */
-         retval = context->esibuf[address];
-      }
-      else
+      if (!(context->esimap[mapw] & (uint32)(1 << mapb)))
       {
          /* byte is not in buffer, put it there */
-         configadr = context->slavelist[slave].configadr;
-         ecx_eeprom2master(context, slave); /* set eeprom control to master */
-         eadr = address >> 1;
-         edat64 = ecx_readeepromFP (context, configadr, eadr, EC_TIMEOUTEEP);
-         /* 8 byte response */
-         if (context->slavelist[slave].eep_8byte)
-         {
-            put_unaligned64(edat64, &(context->esibuf[eadr << 1]));
-            cnt = 8;
-         }
-         /* 4 byte response */
-         else
-         {
-            edat32 = (uint32)edat64;
-            put_unaligned32(edat32, &(context->esibuf[eadr << 1]));
-            cnt = 4;
-         }
-         /* find bitmap location */
-         mapw = eadr >> 4;
-         mapb = (eadr << 1) - (mapw << 5);
-         for(lp = 0 ; lp < cnt ; lp++)
-         {
-            /* set bitmap for each byte that is read */
-            context->esimap[mapw] |= (1 << mapb);
-            mapb++;
-            if (mapb > 31)
-            {
-               mapb = 0;
-               mapw++;
-            }
-         }
-         retval = context->esibuf[address];
+         ecx_siireadchunk(context, slave, address, context->esibuf, context->esimap);
       }
+      retval = context->esibuf[address];
    }
 
    return retval;
@@ -716,15 +845,113 @@ int ecx_FPRD_multi(ecx_contextt *context, int n, uint16 *configlst, ec_alstatust
    return wkc;
 }
 
+/** Read AL status and AL status code of all slaves in ec_slave.
+ * The FPRDs are packed into as few frames as possible, a full frame holds
+ * the status of about 80 slaves. All frames are sent before the first one is
+ * waited for, a lost frame is repeated until timeout.
+ * @param[in] context = context struct
+ * @param[in] timeout = Timeout in us
+ * @return lowest state found, 0 if a slave did not answer
+ */
+int ecx_readalstatus(ecx_contextt *context, int timeout)
+{
+   ecx_portt *port = context->port;
+   int perframe, nframes, frame, i, wkc;
+   uint16 slave, fslave, lowest;
+   uint8 idx[EC_MAXBUF / 2];
+   int first[EC_MAXBUF / 2];
+   int n[EC_MAXBUF / 2];
+   int datapos[EC_MAXBUF / 2][(EC_MAXLRWDATA + EC_HEADERSIZE) / EC_STATUSDGSIZE];
+   ec_alstatust slstat;
+
+   perframe = (EC_MAXLRWDATA + EC_HEADERSIZE) / EC_STATUSDGSIZE;
+   context->slavelist[0].ALstatuscode = 0;
+   lowest = 0xff;
+   fslave = 1;
+   while (fslave <= *(context->slavecount))
+   {
+      /* frames of this pass, all in flight at the same time */
+      nframes = 0;
+      while ((fslave <= *(context->slavecount)) && (nframes < (EC_MAXBUF / 2)))
+      {
+         first[nframes] = fslave;
+         n[nframes] = *(context->slavecount) - fslave + 1;
+         if (n[nframes] > perframe)
+         {
+            n[nframes] = perframe;
+         }
+         idx[nframes] = ecx_getindex(port);
+         slstat.alstatus = 0;
+         slstat.unused = 0;
+         slstat.alstatuscode = 0;
+         for (i = 0; i < n[nframes]; i++)
+         {
+            slave = fslave + i;
+            if (i == 0)
+            {
+               ecx_setupdatagram(port, &(port->txbuf[idx[nframes]]), EC_CMD_FPRD, idx[nframes],
+                  context->slavelist[slave].configadr, ECT_REG_ALSTAT, sizeof(slstat), &slstat);
+               datapos[nframes][i] = EC_HEADERSIZE;
+            }
+            else
+            {
+               datapos[nframes][i] = ecx_adddatagram(port, &(port->txbuf[idx[nframes]]), EC_CMD_FPRD, idx[nframes],
+                  (i < (n[nframes] - 1)), context->slavelist[slave].configadr, ECT_REG_ALSTAT,
+                  sizeof(slstat), &slstat);
+            }
+         }
+         ecx_outframe_red(port, idx[nframes]);
+         fslave += n[nframes];
+         nframes++;
+      }
+      for (frame = 0; frame < nframes; frame++)
+      {
+         wkc = ecx_waitinframe(port, idx[frame], timeout);
+         if (wkc <= EC_NOFRAME)
+         {
+            /* frame lost, repeat it */
+            wkc = ecx_srconfirm(port, idx[frame], timeout);
+         }
+         for (i = 0; i < n[frame]; i++)
+         {
+            slave = first[frame] + i;
+            slstat.alstatus = 0;
+            slstat.alstatuscode = 0;
+            if (wkc > EC_NOFRAME)
+            {
+               uint16 dgwkc;
+               memcpy(&slstat, &(port->rxbuf[idx[frame]][datapos[frame][i]]), sizeof(slstat));
+               memcpy(&dgwkc, &(port->rxbuf[idx[frame]][datapos[frame][i] + sizeof(slstat)]), EC_WKCSIZE);
+               if (etohs(dgwkc) == 0)
+               {
+                  /* slave did not answer */
+                  slstat.alstatus = 0;
+                  slstat.alstatuscode = 0;
+               }
+            }
+            context->slavelist[slave].state = etohs(slstat.alstatus);
+            context->slavelist[slave].ALstatuscode = etohs(slstat.alstatuscode);
+            if ((context->slavelist[slave].state & 0xf) < lowest)
+            {
+               lowest = (context->slavelist[slave].state & 0xf);
+            }
+            context->slavelist[0].ALstatuscode |= context->slavelist[slave].ALstatuscode;
+         }
+         ecx_setbufstat(port, idx[frame], EC_BUF_EMPTY);
+      }
+   }
+   context->slavelist[0].state = lowest;
+
+   return lowest;
+}
+
 /** Read all slave states in ec_slave.
  * @param[in] context = context struct
  * @return lowest state found
  */
 int ecx_readstate(ecx_contextt *context)
 {
-   uint16 slave, fslave, lslave, configadr, lowest, rval, bitwisestate;
-   ec_alstatust sl[MAX_FPRD_MULTI];
-   uint16 slca[MAX_FPRD_MULTI];
+   uint16 slave, lowest, rval, bitwisestate;
    boolean noerrorflag, allslavessamestate;
    boolean allslavespresent = FALSE;
    int wkc;
@@ -783,41 +1010,8 @@ int ecx_readstate(ecx_contextt *context)
    else
    {
       /* Not all slaves have the same state or at least one is in error so one datagram per slave
-       * is needed. */
-      context->slavelist[0].ALstatuscode = 0;
-      lowest = 0xff;
-      fslave = 1;
-      do
-      {
-         lslave = *(context->slavecount);
-         if ((lslave - fslave) >= MAX_FPRD_MULTI)
-         {
-            lslave = fslave + MAX_FPRD_MULTI - 1;
-         }
-         for (slave = fslave; slave <= lslave; slave++)
-         {
-            const ec_alstatust zero = { 0, 0, 0 };
-
-            configadr = context->slavelist[slave].configadr;
-            slca[slave - fslave] = configadr;
-            sl[slave - fslave] = zero;
-         }
-         ecx_FPRD_multi(context, (lslave - fslave) + 1, &(slca[0]), &(sl[0]), EC_TIMEOUTRET3);
-         for (slave = fslave; slave <= lslave; slave++)
-         {
-            configadr = context->slavelist[slave].configadr;
-            rval = etohs(sl[slave - fslave].alstatus);
-            context->slavelist[slave].ALstatuscode = etohs(sl[slave - fslave].alstatuscode);
-            if ((rval & 0xf) < lowest)
-            {
-               lowest = (rval & 0xf);
-            }
-            context->slavelist[slave].state = rval;
-            context->slavelist[0].ALstatuscode |= context->slavelist[slave].ALstatuscode;
-         }
-         fslave = lslave + 1;
-      } while (lslave < *(context->slavecount));
-      context->slavelist[0].state = lowest;
+       * is needed, packed into as few frames as possible. */
+      lowest = ecx_readalstatus(context, EC_TIMEOUTRET3);
    }
   
    return lowest;
@@ -1681,32 +1875,449 @@ static void ecx_clearindex(ecx_contextt *context)  {
 
 }
 
-/** Transmit processdata to slaves.
+/** Invalidate the compiled cyclic frames of a group. The plan is rebuilt on
+ * the next transmit. Called by the configuration functions, call it after
+ * changing the group IO mapping or DC setup by hand.
+ * @param[in]  context        = context struct
+ * @param[in]  group          = group number
+ */
+void ecx_invalidate_plan(ecx_contextt *context, uint8 group)
+{
+   context->grouplist[group].plan.valid = FALSE;
+}
+
+/** Receive the inputs of a group directly into a buffer of Ibytes size, f.e.
+ * a shared memory image. The input part of each returned frame is copied
+ * once from the receive buffer to dest, the inputs in the IOmap are no longer
+ * updated. The data is written before the work counter is known.
+ * @param[in]  context        = context struct
+ * @param[in]  group          = group number
+ * @param[in]  dest           = destination of the inputs, NULL to use the IOmap
+ */
+void ecx_set_inputs_destination(ecx_contextt *context, uint8 group, void *dest)
+{
+   context->grouplist[group].inputsdest = dest;
+   ecx_invalidate_plan(context, group);
+}
+
+/** Start reading a register of the slaves behind the process data.
+ * @param[in]  reg            = register read of the plan
+ * @param[in]  ADO            = register address
+ * @param[in]  length         = register length
+ * @param[in]  dconly         = only slaves with DC
+ * @param[in]  decimation     = cycles between datagrams, 0 = off
+ */
+static void ecx_plan_setreg(ec_planregt *reg, uint16 ADO, uint16 length, boolean dconly, uint16 decimation)
+{
+   reg->ADO = ADO;
+   reg->length = length;
+   reg->dconly = dconly;
+   reg->decimation = decimation;
+   reg->cycle = 0;
+   reg->next = 1;
+   reg->n = 0;
+}
+
+/** Let the cyclic frames of a group carry the AL status of the slaves. Every
+ * decimation cycles the last frame of the cycle gets FPRDs of AL status and AL
+ * status code for as many slaves as fit behind the process data, the next
+ * time for the following slaves, until all slaves are read and the sweep
+ * starts again. The result is in cyclicstate and cyclicALstatuscode of the
+ * slaves, see ecx_readstate_cyclic().
+ * @param[in]  context        = context struct
+ * @param[in]  group          = group number
+ * @param[in]  decimation     = cycles between status datagrams, 0 = off
+ */
+void ecx_set_status_decimation(ecx_contextt *context, uint8 group, uint16 decimation)
+{
+   ecx_plan_setreg(&(context->grouplist[group].plan.status), ECT_REG_ALSTAT, sizeof(ec_alstatust),
+                   FALSE, decimation);
+}
+
+/** Let the cyclic frames of a group carry the system time difference
+ * (0x092C) of the DC slaves, in the same way as the AL status, see
+ * ecx_set_status_decimation(). The result is in cyclicdctimediff of the
+ * slaves, see ecx_readdctime_cyclic().
+ * @param[in]  context        = context struct
+ * @param[in]  group          = group number
+ * @param[in]  decimation     = cycles between time difference datagrams, 0 = off
+ */
+void ecx_set_dctime_decimation(ecx_contextt *context, uint8 group, uint16 decimation)
+{
+   ecx_plan_setreg(&(context->grouplist[group].plan.dctime), ECT_REG_DCSYSDIFF, sizeof(uint32),
+                   TRUE, decimation);
+}
+
+/** Take the AL status of all slaves from the status datagrams of the cyclic
+ * frames, see ecx_set_status_decimation(). Sends no frame, so the supervision
+ * of the slaves needs no round trips of its own while the cyclic task runs.
+ * @param[in]  context        = context struct
+ * @param[in]  group          = group number
+ * @return lowest state found, 0 if a slave did not answer, -1 if no sweep
+ * completed since the last call
+ */
+int ecx_readstate_cyclic(ecx_contextt *context, uint8 group)
+{
+   ec_planregt *reg = &(context->grouplist[group].plan.status);
+   uint32 sweeps = reg->sweeps;
+   uint16 slave, lowest;
+
+   if (!reg->decimation || (sweeps == reg->taken))
+   {
+      return -1;
+   }
+   reg->taken = sweeps;
+   context->slavelist[0].ALstatuscode = 0;
+   lowest = 0xff;
+   for (slave = 1; slave <= *(context->slavecount); slave++)
+   {
+      context->slavelist[slave].state = context->slavelist[slave].cyclicstate;
+      context->slavelist[slave].ALstatuscode = context->slavelist[slave].cyclicALstatuscode;
+      if ((context->slavelist[slave].state & 0xf) < lowest)
+      {
+         lowest = (context->slavelist[slave].state & 0xf);
+      }
+      context->slavelist[0].ALstatuscode |= context->slavelist[slave].ALstatuscode;
+   }
+   context->slavelist[0].state = lowest;
+
+   return lowest;
+}
+
+/** Check for a new sweep of the system time difference of the DC slaves, see
+ * ecx_set_dctime_decimation(). The values are in cyclicdctimediff of the slaves.
+ * @param[in]  context        = context struct
+ * @param[in]  group          = group number
+ * @return number of completed sweeps since the last call, 0 if none
+ */
+int ecx_readdctime_cyclic(ecx_contextt *context, uint8 group)
+{
+   ec_planregt *reg = &(context->grouplist[group].plan.dctime);
+   uint32 sweeps = reg->sweeps;
+   int n;
+
+   if (!reg->decimation)
+   {
+      return 0;
+   }
+   n = (int)(sweeps - reg->taken);
+   reg->taken = sweeps;
+
+   return n;
+}
+
+/** Count a cycle of a register read of the plan.
+ * @param[in]  reg            = register read of the plan
+ * @return TRUE if the datagrams are due in this cycle
+ */
+static boolean ecx_plan_regdue(ec_planregt *reg)
+{
+   reg->n = 0;
+   if (reg->decimation && (++reg->cycle >= reg->decimation))
+   {
+      reg->cycle = 0;
+      return TRUE;
+   }
+   return FALSE;
+}
+
+/** Append the FPRDs of the next slaves of a register read to a frame in the
+ * tx buffer, as many as fit.
+ * @param[in]  context        = context struct
+ * @param[in]  idx            = index of frame
+ * @param[in]  reg            = register read of the plan
+ * @param[in,out] length      = frame length
+ * @param[in,out] lastdg      = offset of the header of the last datagram in the frame
+ */
+static void ecx_plan_addreg(ecx_contextt *context, uint8 idx, ec_planregt *reg, int *length, int *lastdg)
+{
+   uint8 *frameP = context->port->txbuf[idx];
+   ec_comt *datagramP;
+   int dgsize, room, n;
+   uint16 slave;
+
+   dgsize = EC_HEADERSIZE - EC_ELENGTHSIZE + reg->length + EC_WKCSIZE;
+   room = (EC_MAXFRAMELENGTH - *length) / dgsize;
+   if ((reg->next < 1) || (reg->next > *(context->slavecount)))
+   {
+      reg->next = 1;
+   }
+   n = 0;
+   for (slave = reg->next; (slave <= *(context->slavecount)) && (n < room); slave++)
+   {
+      if (reg->dconly && !context->slavelist[slave].hasdc)
+      {
+         continue;
+      }
+      if (n == 0)
+      {
+         reg->offset = *length - ETH_HEADERSIZE + EC_HEADERSIZE - EC_ELENGTHSIZE;
+      }
+      /* previous datagram is followed by this one */
+      datagramP = (ec_comt *)&frameP[*lastdg];
+      datagramP->dlength = htoes(etohs(datagramP->dlength) | EC_DATAGRAMFOLLOWS);
+      *lastdg = *length - EC_ELENGTHSIZE;
+      datagramP = (ec_comt *)&frameP[*lastdg];
+      datagramP->command = EC_CMD_FPRD;
+      datagramP->index = idx;
+      datagramP->ADP = htoes(context->slavelist[slave].configadr);
+      datagramP->ADO = htoes(reg->ADO);
+      datagramP->dlength = htoes(reg->length);
+      datagramP->irpt = 0;
+      /* data and work counter */
+      memset(&frameP[*length + EC_HEADERSIZE - EC_ELENGTHSIZE], 0, reg->length + EC_WKCSIZE);
+      *length += dgsize;
+      n++;
+   }
+   if ((n == 0) && (room > 0))
+   {
+      /* no slave left after next, the sweep is complete */
+      if (reg->next > 1)
+      {
+         reg->next = 1;
+         reg->sweeps++;
+      }
+      return;
+   }
+   reg->first = reg->next;
+   reg->last = slave - 1;
+   reg->n = n;
+}
+
+/** Append the due register reads to a compiled frame in the tx buffer.
+ * @param[in]  context        = context struct
+ * @param[in]  group          = group number
+ * @param[in]  idx            = index of frame
+ * @param[in]  pf             = compiled frame in the tx buffer
+ * @param[in]  status         = AL status datagrams are due
+ * @param[in]  dctime         = system time difference datagrams are due
+ */
+static void ecx_plan_addregs(ecx_contextt *context, uint8 group, uint8 idx, ec_planframet *pf,
+                             boolean status, boolean dctime)
+{
+   ec_plant *plan = &(context->grouplist[group].plan);
+   uint8 *frameP = context->port->txbuf[idx];
+   ec_comt *datagramP;
+   int length = pf->length;
+   int lastdg;
+
+   /* last datagram of the frame, the DC FRMW if there is one */
+   if (pf->dc)
+   {
+      lastdg = ETH_HEADERSIZE + EC_HEADERSIZE + pf->sublength + EC_WKCSIZE - EC_ELENGTHSIZE;
+   }
+   else
+   {
+      lastdg = ETH_HEADERSIZE;
+   }
+   if (status)
+   {
+      ecx_plan_addreg(context, idx, &(plan->status), &length, &lastdg);
+   }
+   if (dctime)
+   {
+      ecx_plan_addreg(context, idx, &(plan->dctime), &length, &lastdg);
+   }
+   datagramP = (ec_comt *)&frameP[ETH_HEADERSIZE];
+   datagramP->elength = htoes(etohs(datagramP->elength) + (length - pf->length));
+   context->port->txbuflength[idx] = length;
+}
+
+/** Store the datagrams of a register read of a returned frame in the slaves.
+ * @param[in]  context        = context struct
+ * @param[in]  idx            = index of frame
+ * @param[in]  reg            = register read of the plan
+ */
+static void ecx_plan_readreg(ecx_contextt *context, int idx, ec_planregt *reg)
+{
+   ec_slavet *sl;
+   ec_alstatust slstat;
+   uint32 diff;
+   uint16 dgwkc, slave;
+   int pos;
+
+   if (reg->n == 0)
+   {
+      return;
+   }
+   pos = reg->offset;
+   for (slave = reg->first; slave <= reg->last; slave++)
+   {
+      sl = &(context->slavelist[slave]);
+      if (reg->dconly && !sl->hasdc)
+      {
+         continue;
+      }
+      memcpy(&dgwkc, &(context->port->rxbuf[idx][pos + reg->length]), EC_WKCSIZE);
+      if (reg->ADO == ECT_REG_ALSTAT)
+      {
+         memcpy(&slstat, &(context->port->rxbuf[idx][pos]), sizeof(slstat));
+         /* 0 if the slave did not answer */
+         sl->cyclicstate = etohs(dgwkc) ? etohs(slstat.alstatus) : 0;
+         sl->cyclicALstatuscode = etohs(dgwkc) ? etohs(slstat.alstatuscode) : 0;
+      }
+      else if ((reg->ADO == ECT_REG_DCSYSDIFF) && etohs(dgwkc))
+      {
+         memcpy(&diff, &(context->port->rxbuf[idx][pos]), sizeof(diff));
+         diff = etohl(diff);
+         /* bit 31 set: local copy of the system time smaller than the received one */
+         sl->cyclicdctimediff = (diff & 0x80000000) ? -(int32)(diff & 0x7fffffff) : (int32)diff;
+      }
+      pos += EC_HEADERSIZE - EC_ELENGTHSIZE + reg->length + EC_WKCSIZE;
+   }
+   reg->next = reg->last + 1;
+   if (reg->next > *(context->slavecount))
+   {
+      reg->next = 1;
+      reg->sweeps++;
+   }
+   reg->n = 0;
+}
+
+/** Work counter a slave adds to a compiled frame of its group. A slave
+ * increments the work counter of a logical datagram once if it reads and
+ * twice if it writes data in the datagram, LWR counts 2 as in the group total.
+ * Used to find the slaves behind a frame that returned with a low work counter.
+ * @param[in]  context        = context struct
+ * @param[in]  group          = group number
+ * @param[in]  frame          = frame number in the plan
+ * @param[in]  slave          = slave number
+ * @return expected work counter of the slave in the frame, 0 if it has no data in it
+ */
+int ecx_plan_slavewkc(ecx_contextt *context, uint8 group, int frame, uint16 slave)
+{
+   ec_plant *plan = &(context->grouplist[group].plan);
+   ec_slavet *sl;
+   ec_planframet *pf;
+   uint32 bytes;
+   int wkc = 0;
+
+   if ((frame < 0) || (frame >= plan->nframes) || (slave < 1) || (slave > *(context->slavecount)))
+   {
+      return 0;
+   }
+   sl = &(context->slavelist[slave]);
+   if (group && (sl->group != group))
+   {
+      return 0;
+   }
+   pf = &(plan->frame[frame]);
+   if (sl->outputs && sl->Obits && (pf->cmd != EC_CMD_LRD))
+   {
+      /* less than 8 bits share one byte with other slaves */
+      bytes = sl->Obytes ? sl->Obytes : 1;
+      if ((sl->outputs < pf->data + pf->sublength) && (sl->outputs + bytes > pf->data))
+      {
+         wkc += 2;
+      }
+   }
+   if (sl->inputs && sl->Ibits && (pf->cmd != EC_CMD_LWR))
+   {
+      bytes = sl->Ibytes ? sl->Ibytes : 1;
+      if ((sl->inputs < pf->rxdata + pf->sublength) && (sl->inputs + bytes > pf->rxdata))
+      {
+         wkc += 1;
+      }
+   }
+
+   return wkc;
+}
+
+/** Add one frame to the plan of a group. Builds the header and trailer
+ * templates as ecx_setupdatagram() and ecx_adddatagram() would.
+ * @param[in]  context        = context struct
+ * @param[in]  group          = group number
+ * @param[in]  cmd            = EC_CMD_LRW, EC_CMD_LRD or EC_CMD_LWR
+ * @param[in]  LogAdr         = logical address of the datagram
+ * @param[in]  sublength      = process data length of the datagram
+ * @param[in]  data           = process data sent and received
+ * @param[in]  rxdata         = destination of returned process data
+ * @param[in]  dc             = add DC FRMW datagram
+ */
+static void ecx_plan_addframe(ecx_contextt *context, uint8 group, uint8 cmd, uint32 LogAdr,
+                              uint16 sublength, uint8 *data, uint8 *rxdata, boolean dc)
+{
+   ec_plant *plan = &(context->grouplist[group].plan);
+   ec_planframet *pf;
+   ec_comt *datagramP;
+   uint16 elength;
+
+   if (plan->nframes >= EC_MAXBUF)
+   {
+      return;
+   }
+   pf = &(plan->frame[plan->nframes++]);
+   memset(pf, 0, sizeof(ec_planframet));
+   pf->cmd = cmd;
+   pf->dc = dc;
+   pf->sublength = sublength;
+   pf->txdata = (cmd == EC_CMD_LRD) ? NULL : data;
+   pf->data = data;
+   pf->rxdata = rxdata;
+   pf->wkc = EC_NOFRAME;
+   /* part of the datagram that holds inputs */
+   if (context->grouplist[group].inputsdest && (cmd != EC_CMD_LWR))
+   {
+      uint8 *istart = context->grouplist[group].inputs;
+      uint8 *iend = istart + context->grouplist[group].Ibytes;
+      uint8 *start = (rxdata > istart) ? rxdata : istart;
+      uint8 *end = ((rxdata + sublength) < iend) ? (rxdata + sublength) : iend;
+      if (end > start)
+      {
+         pf->rxdest = context->grouplist[group].inputsdest + (start - istart);
+         pf->rxoffset = start - rxdata;
+         pf->rxlength = end - start;
+      }
+   }
+   elength = EC_ECATTYPE + EC_HEADERSIZE + sublength;
+   pf->taillength = EC_WKCSIZE;
+   if (dc)
+   {
+      elength += EC_HEADERSIZE + sizeof(int64);
+      pf->taillength = EC_PLANTAILSIZE;
+      /* FPRMW in second datagram, data is patched per cycle */
+      datagramP = (ec_comt *)&(pf->tail[EC_WKCSIZE - EC_ELENGTHSIZE]);
+      datagramP->command = EC_CMD_FRMW;
+      datagramP->ADP = htoes(context->slavelist[context->grouplist[group].DCnext].configadr);
+      datagramP->ADO = htoes(ECT_REG_DCSYSTIME);
+      datagramP->dlength = htoes(sizeof(int64));
+      plan->DCl = sublength;
+      plan->DCtO = EC_HEADERSIZE + sublength + EC_WKCSIZE + EC_HEADERSIZE - EC_ELENGTHSIZE;
+   }
+   datagramP = (ec_comt *)&(pf->head[0]);
+   datagramP->elength = htoes(elength);
+   datagramP->command = cmd;
+   datagramP->ADP = htoes(LO_WORD(LogAdr));
+   datagramP->ADO = htoes(HI_WORD(LogAdr));
+   datagramP->dlength = htoes(sublength | (dc ? EC_DATAGRAMFOLLOWS : 0));
+   pf->length = ETH_HEADERSIZE + EC_HEADERSIZE + sublength + pf->taillength;
+}
+
+/** Compile the cyclic frames of a group.
  * Uses LRW, or LRD/LWR if LRW is not allowed (blockLRW).
- * Both the input and output processdata are transmitted.
- * The outputs with the actual data, the inputs have a placeholder.
- * The inputs are gathered with the receive processdata function.
- * In contrast to the base LRW function this function is non-blocking.
  * If the processdata does not fit in one datagram, multiple are used.
- * In order to recombine the slave response, a stack is used.
+ * The segmentation only changes with the configuration, so it is done once
+ * and each cycle only copies the templates and the output data.
  * @param[in]  context        = context struct
  * @param[in]  group          = group number
  * @param[in]  use_overlap_io = flag if overlapped iomap is used
- * @return >0 if processdata is transmitted.
  */
-static int ecx_main_send_processdata(ecx_contextt *context, uint8 group, boolean use_overlap_io)
+static void ecx_compile_plan(ecx_contextt *context, uint8 group, boolean use_overlap_io)
 {
    uint32 LogAdr;
-   uint16 w1, w2;
    int length, sublength;
-   uint8 idx;
-   int wkc;
    uint8* data;
    boolean first=FALSE;
    uint16 currentsegment = 0;
    uint32 iomapinputoffset;
-
-   wkc = 0;
+   int frame;
+   uint16 slave;
+   ec_plant *plan = &(context->grouplist[group].plan);
+
+   plan->nframes = 0;
+   plan->overlap = use_overlap_io;
+   plan->DCl = 0;
+   plan->DCtO = 0;
    if(context->grouplist[group].hasdc)
    {
       first = TRUE;
@@ -1726,12 +2337,10 @@ static int ecx_main_send_processdata(ecx_contextt *context, uint8 group, boolean
       length = context->grouplist[group].Obytes + context->grouplist[group].Ibytes;
       iomapinputoffset = 0;
    }
-   
+
    LogAdr = context->grouplist[group].logstartaddr;
    if(length)
    {
-
-      wkc = 1;
       /* LRW blocked by one or more slaves ? */
       if(context->grouplist[group].blockLRW)
       {
@@ -1753,24 +2362,8 @@ static int ecx_main_send_processdata(ecx_contextt *context, uint8 group, boolean
                {
                   sublength = context->grouplist[group].IOsegment[currentsegment++];
                }
-               /* get new index */
-               idx = ecx_getindex(context->port);
-               w1 = LO_WORD(LogAdr);
-               w2 = HI_WORD(LogAdr);
-               ecx_setupdatagram(context->port, &(context->port->txbuf[idx]), EC_CMD_LRD, idx, w1, w2, sublength, data);
-               if(first)
-               {
-                  context->DCl = sublength;
-                  /* FPRMW in second datagram */
-                  context->DCtO = ecx_adddatagram(context->port, &(context->port->txbuf[idx]), EC_CMD_FRMW, idx, FALSE,
-                                           context->slavelist[context->grouplist[group].DCnext].configadr,
-                                           ECT_REG_DCSYSTIME, sizeof(int64), context->DCtime);
-                  first = FALSE;
-               }
-               /* send frame */
-               ecx_outframe_red(context->port, idx);
-               /* push index and data pointer on stack */
-               ecx_pushindex(context, idx, data, sublength);
+               ecx_plan_addframe(context, group, EC_CMD_LRD, LogAdr, sublength, data, data, first);
+               first = FALSE;
                length -= sublength;
                LogAdr += sublength;
                data += sublength;
@@ -1791,24 +2384,8 @@ static int ecx_main_send_processdata(ecx_contextt *context, uint8 group, boolean
                {
                   sublength = length;
                }
-               /* get new index */
-               idx = ecx_getindex(context->port);
-               w1 = LO_WORD(LogAdr);
-               w2 = HI_WORD(LogAdr);
-               ecx_setupdatagram(context->port, &(context->port->txbuf[idx]), EC_CMD_LWR, idx, w1, w2, sublength, data);
-               if(first)
-               {
-                  context->DCl = sublength;
-                  /* FPRMW in second datagram */
-                  context->DCtO = ecx_adddatagram(context->port, &(context->port->txbuf[idx]), EC_CMD_FRMW, idx, FALSE,
-                                           context->slavelist[context->grouplist[group].DCnext].configadr,
-                                           ECT_REG_DCSYSTIME, sizeof(int64), context->DCtime);
-                  first = FALSE;
-               }
-               /* send frame */
-               ecx_outframe_red(context->port, idx);
-               /* push index and data pointer on stack */
-               ecx_pushindex(context, idx, data, sublength);
+               ecx_plan_addframe(context, group, EC_CMD_LWR, LogAdr, sublength, data, data, first);
+               first = FALSE;
                length -= sublength;
                LogAdr += sublength;
                data += sublength;
@@ -1832,36 +2409,117 @@ static int ecx_main_send_processdata(ecx_contextt *context, uint8 group, boolean
          do
          {
             sublength = context->grouplist[group].IOsegment[currentsegment++];
-            /* get new index */
-            idx = ecx_getindex(context->port);
-            w1 = LO_WORD(LogAdr);
-            w2 = HI_WORD(LogAdr);
-            ecx_setupdatagram(context->port, &(context->port->txbuf[idx]), EC_CMD_LRW, idx, w1, w2, sublength, data);
-            if(first)
-            {
-               context->DCl = sublength;
-               /* FPRMW in second datagram */
-               context->DCtO = ecx_adddatagram(context->port, &(context->port->txbuf[idx]), EC_CMD_FRMW, idx, FALSE,
-                                        context->slavelist[context->grouplist[group].DCnext].configadr,
-                                        ECT_REG_DCSYSTIME, sizeof(int64), context->DCtime);
-               first = FALSE;
-            }
-            /* send frame */
-            ecx_outframe_red(context->port, idx);
-            /* push index and data pointer on stack.
-             * the iomapinputoffset compensate for where the inputs are stored 
+            /* the iomapinputoffset compensate for where the inputs are stored
              * in the IOmap if we use an overlapping IOmap. If a regular IOmap
              * is used it should always be 0.
              */
-            ecx_pushindex(context, idx, (data + iomapinputoffset), sublength);      
+            ecx_plan_addframe(context, group, EC_CMD_LRW, LogAdr, sublength, data, data + iomapinputoffset, first);
+            first = FALSE;
             length -= sublength;
             LogAdr += sublength;
             data += sublength;
          } while (length && (currentsegment < context->grouplist[group].nsegments));
       }
    }
+   for (frame = 0; frame < plan->nframes; frame++)
+   {
+      for (slave = 1; slave <= *(context->slavecount); slave++)
+      {
+         plan->frame[frame].expectedwkc += ecx_plan_slavewkc(context, group, frame, slave);
+      }
+   }
+   plan->valid = TRUE;
+}
 
-   return wkc;
+/** Transmit processdata to slaves.
+ * Uses LRW, or LRD/LWR if LRW is not allowed (blockLRW).
+ * Both the input and output processdata are transmitted.
+ * The outputs with the actual data, the inputs have a placeholder.
+ * The inputs are gathered with the receive processdata function.
+ * In contrast to the base LRW function this function is non-blocking.
+ * If the processdata does not fit in one datagram, multiple are used.
+ * In order to recombine the slave response, a stack is used.
+ * The frames are copied from the compiled plan of the group, only the index,
+ * the output data and the DC time are filled in per cycle.
+ * @param[in]  context        = context struct
+ * @param[in]  group          = group number
+ * @param[in]  use_overlap_io = flag if overlapped iomap is used
+ * @return >0 if processdata is transmitted.
+ */
+static int ecx_main_send_processdata(ecx_contextt *context, uint8 group, boolean use_overlap_io)
+{
+   ec_plant *plan = &(context->grouplist[group].plan);
+   ec_planframet *pf;
+   ec_comt *datagramP;
+   uint8 *frameP;
+   uint8 idx;
+   int i, pos;
+   uint8 txidx[EC_MAXBUF];
+   int ntx = 0;
+   boolean status, dctime;
+
+   if (!plan->valid || (plan->overlap != use_overlap_io))
+   {
+      ecx_compile_plan(context, group, use_overlap_io);
+   }
+   if (plan->nframes == 0)
+   {
+      return 0;
+   }
+   /* register reads due in this cycle */
+   status = ecx_plan_regdue(&(plan->status));
+   dctime = ecx_plan_regdue(&(plan->dctime));
+   for (i = 0; i < plan->nframes; i++)
+   {
+      pf = &(plan->frame[i]);
+      /* get new index */
+      idx = ecx_getindex(context->port);
+      frameP = context->port->txbuf[idx];
+      /* Ethernet header is preset and fixed in frame buffers */
+      memcpy(&frameP[ETH_HEADERSIZE], pf->head, EC_HEADERSIZE);
+      datagramP = (ec_comt *)&frameP[ETH_HEADERSIZE];
+      datagramP->index = idx;
+      pos = ETH_HEADERSIZE + EC_HEADERSIZE;
+      if (pf->txdata)
+      {
+         memcpy(&frameP[pos], pf->txdata, pf->sublength);
+      }
+      else
+      {
+         /* no data to write. initialise data so frame is in a known state */
+         memset(&frameP[pos], 0, pf->sublength);
+      }
+      pos += pf->sublength;
+      memcpy(&frameP[pos], pf->tail, pf->taillength);
+      if (pf->dc)
+      {
+         datagramP = (ec_comt *)&frameP[pos + EC_WKCSIZE - EC_ELENGTHSIZE];
+         datagramP->index = idx;
+         memcpy(&frameP[pos + EC_WKCSIZE + EC_HEADERSIZE - EC_ELENGTHSIZE], context->DCtime, sizeof(int64));
+         context->DCl = plan->DCl;
+         context->DCtO = plan->DCtO;
+      }
+      context->port->txbuflength[idx] = pf->length;
+      if ((status || dctime) && (i == (plan->nframes - 1)))
+      {
+         ecx_plan_addregs(context, group, idx, pf, status, dctime);
+      }
+      if (pf->rxdest)
+      {
+         context->port->rxdest[idx].offset = EC_HEADERSIZE + pf->rxoffset;
+         context->port->rxdest[idx].length = pf->rxlength;
+         context->port->rxdest[idx].expectedwkc = pf->expectedwkc;
+         context->port->rxdest[idx].dest = pf->rxdest;
+      }
+      /* queue frame, all frames of the cycle are sent at once */
+      txidx[ntx++] = idx;
+      /* push index and data pointer on stack */
+      ecx_pushindex(context, idx, pf->rxdata, pf->sublength);
+   }
+   /* send all frames of this cycle with one system call */
+   ecx_outframe_multi(context->port, txidx, ntx);
+
+   return 1;
 }
 
 /** Transmit processdata to slaves.
@@ -1898,6 +2556,50 @@ int ecx_send_processdata_group(ecx_contextt *context, uint8 group)
    return ecx_main_send_processdata(context, group, FALSE);
 }
 
+/** Copy the input data of a returned frame to the process data buffer, or to
+ * the inputs destination of the group if it was not received directly. The
+ * inputs destination only gets frames with the expected work counter.
+ * @param[in]  context        = context struct
+ * @param[in]  group          = group number
+ * @param[in]  pos            = position on the index stack
+ * @param[in]  idx            = index of frame
+ * @param[in]  length         = process data length of the datagram
+ * @return 1 if the inputs of the frame are in the inputs destination
+ */
+static int ecx_receive_inputs(ecx_contextt *context, uint8 group, int pos, int idx, int length)
+{
+   ec_plant *plan = &(context->grouplist[group].plan);
+   ec_planframet *pf;
+   uint16 le_wkc;
+
+   if (context->grouplist[group].inputsdest && plan->valid && (pos < plan->nframes))
+   {
+      pf = &(plan->frame[pos]);
+      if (!pf->rxdest)
+      {
+         return 0;
+      }
+      if (context->port->rxdest[idx].done)
+      {
+         return 1;
+      }
+      /* not received directly, f.e. in redundant mode or with a low work counter */
+      memcpy(&le_wkc, &(context->port->rxbuf[idx][EC_HEADERSIZE + pf->sublength]), EC_WKCSIZE);
+      if (pf->expectedwkc && (etohs(le_wkc) != pf->expectedwkc))
+      {
+         return 0;
+      }
+      memcpy(pf->rxdest, &(context->port->rxbuf[idx][EC_HEADERSIZE + pf->rxoffset]), pf->rxlength);
+      context->port->copystat.copies++;
+      context->port->copystat.bytes += pf->rxlength;
+      return 1;
+   }
+   memcpy(context->idxstack->data[pos], &(context->port->rxbuf[idx][EC_HEADERSIZE]), length);
+   context->port->copystat.copies++;
+   context->port->copystat.bytes += length;
+   return 0;
+}
+
 /** Receive processdata from slaves.
  * Second part from ec_send_processdata().
  * Received datagrams are recombined with the processdata with help from the stack.
@@ -1910,16 +2612,19 @@ int ecx_send_processdata_group(ecx_contextt *context, uint8 group)
 int ecx_receive_processdata_group(ecx_contextt *context, uint8 group, int timeout)
 {
    int pos, idx;
-   int wkc = 0, wkc2;
+   int wkc = 0, wkc2, framewkc;
    uint16 le_wkc = 0;
    int valid_wkc = 0;
    int64 le_DCtime;
    boolean first = FALSE;
+   uint8 cmd;
+   ec_plant *plan = &(context->grouplist[group].plan);
 
    if(context->grouplist[group].hasdc)
    {
       first = TRUE;
    }
+   plan->rxframes = 0;
    /* get first index */
    pos = ecx_pullindex(context);
    /* read the same number of frames as send */
@@ -1927,16 +2632,37 @@ int ecx_receive_processdata_group(ecx_contextt *context, uint8 group, int timeou
    {
       idx = context->idxstack->idx[pos];
       wkc2 = ecx_waitinframe(context->port, context->idxstack->idx[pos], timeout);
+      framewkc = EC_NOFRAME;
       /* check if there is input data in frame */
       if (wkc2 > EC_NOFRAME)
       {
-         if((context->port->rxbuf[idx][EC_CMDOFFSET]==EC_CMD_LRD) || (context->port->rxbuf[idx][EC_CMDOFFSET]==EC_CMD_LRW))
+         /* command and DC datagram position are known from the compiled plan */
+         if (plan->valid && (pos < plan->nframes))
+         {
+            cmd = plan->frame[pos].cmd;
+            first = plan->frame[pos].dc;
+         }
+         else
+         {
+            cmd = context->port->rxbuf[idx][EC_CMDOFFSET];
+         }
+         /* register reads behind the process data, the work counter of the
+          * frame is the one of the last datagram */
+         if ((plan->status.n || plan->dctime.n) && plan->valid && (pos == (plan->nframes - 1)))
+         {
+            memcpy(&le_wkc, &(context->port->rxbuf[idx][EC_HEADERSIZE + plan->frame[pos].sublength]), EC_WKCSIZE);
+            wkc2 = etohs(le_wkc);
+            ecx_plan_readreg(context, idx, &(plan->status));
+            ecx_plan_readreg(context, idx, &(plan->dctime));
+         }
+         if((cmd==EC_CMD_LRD) || (cmd==EC_CMD_LRW))
          {
             if(first)
             {
-               memcpy(context->idxstack->data[pos], &(context->port->rxbuf[idx][EC_HEADERSIZE]), context->DCl);
+               plan->rxframes += ecx_receive_inputs(context, group, pos, idx, context->DCl);
                memcpy(&le_wkc, &(context->port->rxbuf[idx][EC_HEADERSIZE + context->DCl]), EC_WKCSIZE);
-               wkc = etohs(le_wkc);
+               framewkc = etohs(le_wkc);
+               wkc = framewkc;
                memcpy(&le_DCtime, &(context->port->rxbuf[idx][context->DCtO]), sizeof(le_DCtime));
                *(context->DCtime) = etohll(le_DCtime);
                first = FALSE;
@@ -1944,18 +2670,20 @@ int ecx_receive_processdata_group(ecx_contextt *context, uint8 group, int timeou
             else
             {
                /* copy input data back to process data buffer */
-               memcpy(context->idxstack->data[pos], &(context->port->rxbuf[idx][EC_HEADERSIZE]), context->idxstack->length[pos]);
+               plan->rxframes += ecx_receive_inputs(context, group, pos, idx, context->idxstack->length[pos]);
+               framewkc = wkc2;
                wkc += wkc2;
             }
             valid_wkc = 1;
          }
-         else if(context->port->rxbuf[idx][EC_CMDOFFSET]==EC_CMD_LWR)
+         else if(cmd==EC_CMD_LWR)
          {
             if(first)
             {
                memcpy(&le_wkc, &(context->port->rxbuf[idx][EC_HEADERSIZE + context->DCl]), EC_WKCSIZE);
                /* output WKC counts 2 times when using LRW, emulate the same for LWR */
-               wkc = etohs(le_wkc) * 2;
+               framewkc = etohs(le_wkc) * 2;
+               wkc = framewkc;
                memcpy(&le_DCtime, &(context->port->rxbuf[idx][context->DCtO]), sizeof(le_DCtime));
                *(context->DCtime) = etohll(le_DCtime);
                first = FALSE;
@@ -1963,11 +2691,17 @@ int ecx_receive_processdata_group(ecx_contextt *context, uint8 group, int timeou
             else
             {
                /* output WKC counts 2 times when using LRW, emulate the same for LWR */
-               wkc += wkc2 * 2;
+               framewkc = wkc2 * 2;
+               wkc += framewkc;
             }
             valid_wkc = 1;
          }
       }
+      /* work counter per frame, to find the slaves that did not process it */
+      if (plan->valid && (pos < plan->nframes))
+      {
+         plan->frame[pos].wkc = framewkc;
+      }
       /* release buffer */
       ecx_setbufstat(context->port, idx, EC_BUF_EMPTY);
       /* get next index */
@@ -2140,6 +2874,26 @@ int ec_readstate(void)
    return ecx_readstate (&ecx_context);
 }
 
+/** Read AL status and AL status code of all slaves in ec_slave.
+ * @param[in] timeout = Timeout in us
+ * @return lowest state found
+ * @see ecx_readalstatus
+ */
+int ec_readalstatus(int timeout)
+{
+   return ecx_readalstatus (&ecx_context, timeout);
+}
+
+/** Take the AL status of all slaves from the cyclic frames.
+ * @param[in]  group          = group number
+ * @return lowest state found, -1 if no sweep completed since the last call
+ * @see ecx_readstate_cyclic
+ */
+int ec_readstate_cyclic(uint8 group)
+{
+   return ecx_readstate_cyclic (&ecx_context, group);
+}
+
 /** Write slave state, if slave = 0 then write to all slaves.
  * The function does not check if the actual state is changed.
  * @param[in] slave = Slave number, 0 = master
@@ -2332,6 +3086,36 @@ uint32 ec_readeeprom2(uint16 slave, int timeout)
    return ecx_readeeprom2 (&ecx_context, slave, timeout);
 }
 
+/** Receive the inputs of a group directly into a buffer.
+ * @param[in]  group          = group number
+ * @param[in]  dest           = destination of the inputs, NULL to use the IOmap
+ * @see ecx_set_inputs_destination
+ */
+void ec_set_inputs_destination(uint8 group, void *dest)
+{
+   ecx_set_inputs_destination(&ecx_context, group, dest);
+}
+
+/** Let the cyclic frames of a group carry the AL status of the slaves.
+ * @param[in]  group          = group number
+ * @param[in]  decimation     = cycles between status datagrams, 0 = off
+ * @see ecx_set_status_decimation
+ */
+void ec_set_status_decimation(uint8 group, uint16 decimation)
+{
+   ecx_set_status_decimation(&ecx_context, group, decimation);
+}
+
+/** Let the cyclic frames of a group carry the system time difference of the DC slaves.
+ * @param[in]  group          = group number
+ * @param[in]  decimation     = cycles between time difference datagrams, 0 = off
+ * @see ecx_set_dctime_decimation
+ */
+void ec_set_dctime_decimation(uint8 group, uint16 decimation)
+{
+   ecx_set_dctime_decimation(&ecx_context, group, decimation);
+}
+
 /** Transmit processdata to slaves.
  * Uses LRW, or LRD/LWR if LRW is not allowed (blockLRW).
  * Both the input and output processdata are transmitted.
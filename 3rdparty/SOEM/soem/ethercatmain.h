@@ -21,12 +21,18 @@ extern "C"
 #define EC_MAXELIST       64
 /** max. length of readable name in slavelist and Object Description List */
 #define EC_MAXNAME        40
-/** max. number of slaves in array */
+/** max. number of slaves in array, may be overridden by the build */
+#ifndef EC_MAXSLAVE
 #define EC_MAXSLAVE       200
-/** max. number of groups */
+#endif
+/** max. number of groups, may be overridden by the build */
+#ifndef EC_MAXGROUP
 #define EC_MAXGROUP       2
-/** max. number of IO segments per group */
+#endif
+/** max. number of IO segments per group, may be overridden by the build */
+#ifndef EC_MAXIOSEGMENTS
 #define EC_MAXIOSEGMENTS  64
+#endif
 /** max. mailbox size */
 #define EC_MAXMBX         1486
 /** max. eeprom PDO entries */
@@ -38,7 +44,9 @@ extern "C"
 /** max. Adapter */
 #define EC_MAXLEN_ADAPTERNAME    128
 /** define maximum number of concurrent threads in mapping */
+#ifndef EC_MAX_MAPT
 #define EC_MAX_MAPT           1
+#endif
 
 typedef struct ec_adapter ec_adaptert;
 struct ec_adapter
@@ -233,8 +241,152 @@ typedef struct ec_slave
    int              (*PO2SOconfigx)(ecx_contextt * context, uint16 slave);
    /** readable name */
    char             name[EC_MAXNAME + 1];
+   /** SII cache image of the slave, 0 = not looked up, -1 = none, else index + 1 */
+   int16            siiimage;
+   /** AL status from the status datagrams of the cyclic frames, 0 if the slave did not answer */
+   uint16           cyclicstate;
+   /** AL status code from the status datagrams of the cyclic frames */
+   uint16           cyclicALstatuscode;
+   /** system time difference (0x092C) from the cyclic frames, ns, local minus received */
+   int32            cyclicdctimediff;
 } ec_slavet;
 
+/** size of the trailer of a compiled frame: work counter of the process
+ * data datagram, then the DC FRMW datagram with its work counter */
+#define EC_PLANTAILSIZE (EC_WKCSIZE + EC_HEADERSIZE - EC_ELENGTHSIZE + sizeof(int64) + EC_WKCSIZE)
+/** size of one FPRD datagram of AL status and AL status code in a frame */
+#define EC_STATUSDGSIZE (EC_HEADERSIZE - EC_ELENGTHSIZE + sizeof(ec_alstatust) + EC_WKCSIZE)
+/** largest frame, one datagram of EC_MAXLRWDATA */
+#define EC_MAXFRAMELENGTH (ETH_HEADERSIZE + EC_HEADERSIZE + EC_MAXLRWDATA + EC_WKCSIZE)
+
+/** one compiled frame of the cyclic process data */
+typedef struct ec_planframe
+{
+   /** datagram command, EC_CMD_LRW, EC_CMD_LRD or EC_CMD_LWR */
+   uint8            cmd;
+   /** frame carries the DC FRMW datagram */
+   boolean          dc;
+   /** process data length of the datagram */
+   uint16           sublength;
+   /** frame length including ethernet header */
+   uint16           length;
+   /** length of the trailer template */
+   uint16           taillength;
+   /** process data copied into the frame, NULL to send zeros (LRD) */
+   uint8            *txdata;
+   /** process data of the datagram in the IOmap, output side for overlapped IOmap */
+   uint8            *data;
+   /** destination of the returned process data */
+   uint8            *rxdata;
+   /** destination of the input data in the group inputs destination, NULL if none */
+   uint8            *rxdest;
+   /** offset of the input data in the process data of the datagram */
+   uint16           rxoffset;
+   /** length of the input data */
+   uint16           rxlength;
+   /** EtherCAT and datagram header template, index is patched per cycle */
+   uint8            head[EC_HEADERSIZE];
+   /** work counter and DC datagram template */
+   uint8            tail[EC_PLANTAILSIZE];
+   /** expected work counter of the datagram, outputs count 2 as in the group total */
+   uint16           expectedwkc;
+   /** work counter of the datagram in the last cycle, EC_NOFRAME if the frame was lost */
+   int              wkc;
+} ec_planframet;
+
+/** register of the slaves read behind the process data of the cyclic frames,
+ * a window of slaves every decimation cycles */
+typedef struct ec_planreg
+{
+   /** register address */
+   uint16           ADO;
+   /** register length */
+   uint16           length;
+   /** only slaves with DC */
+   boolean          dconly;
+   /** cycles between datagrams, 0 = off */
+   uint16           decimation;
+   /** cycles since the last datagrams */
+   uint16           cycle;
+   /** first slave of the next window */
+   uint16           next;
+   /** window in the frames in flight, first and last slave and number of datagrams */
+   uint16           first;
+   uint16           last;
+   uint16           n;
+   /** rx offset of the first datagram */
+   uint16           offset;
+   /** completed sweeps over all slaves, written by the process data receive */
+   volatile uint32  sweeps;
+   /** last sweep taken by the reader */
+   uint32           taken;
+} ec_planregt;
+
+/** compiled cyclic process data of a group, built once after mapping */
+typedef struct ec_plan
+{
+   /** plan matches the current group configuration */
+   boolean          valid;
+   /** plan was built for an overlapped IOmap */
+   boolean          overlap;
+   /** number of frames per cycle */
+   uint16           nframes;
+   /** process data length of the DC frame */
+   uint16           DCl;
+   /** offset of DC time in the rx buffer of the DC frame */
+   uint16           DCtO;
+   /** frames whose inputs reached the inputs destination in the last receive */
+   uint16           rxframes;
+   /** frames in transmit order */
+   ec_planframet    frame[EC_MAXBUF];
+   /** AL status of the slaves behind the process data */
+   ec_planregt      status;
+   /** system time difference of the DC slaves behind the process data */
+   ec_planregt      dctime;
+} ec_plant;
+
+/** first EEPROM byte kept in the SII cache, the config area before it holds
+ * per device data like alias and serial number */
+#define EC_SIICACHESTART  (ECT_SII_START << 1)
+/** number of SII images in the SII cache, one per slave type */
+#ifndef EC_MAXSIICACHE
+#define EC_MAXSIICACHE    16
+#endif
+
+/** SII image of one slave type. The categories are read once for all slaves
+ * with the same vendor, product and revision.
+ */
+typedef struct ec_siiimage
+{
+   /** identity of the slave type */
+   uint32           man;
+   uint32           id;
+   uint32           rev;
+   /** EEPROM words 0x3E..0x41, size, version and first category header, compared
+    * with every slave before the image is used for it */
+   uint8            check[8];
+   /** image has bytes that are not saved yet */
+   boolean          dirty;
+   /** image was checked against a slave of this network */
+   boolean          used;
+   /** bitmap of the bytes in buf that are read */
+   uint32           map[EC_MAXEEPBITMAP];
+   /** EEPROM content, valid from EC_SIICACHESTART */
+   uint8            buf[EC_MAXEEPBUF];
+} ec_siiimaget;
+
+/** SII cache of a context, images can be loaded from and saved to disk by the application */
+typedef struct ec_siicache
+{
+   /** number of images used */
+   int              nimages;
+   /** bytes served from the cache */
+   uint32           hits;
+   /** EEPROM reads done to fill the cache */
+   uint32           reads;
+   ec_siiimaget     image[EC_MAXSIICACHE];
+} ec_siicachet;
+
 /** for list of ethercat slave groups */
 typedef struct ec_group
 {
@@ -270,6 +422,10 @@ typedef struct ec_group
    boolean          docheckstate;
    /** IO segmentation list. Datagrams must not break SM in two. */
    uint32           IOsegment[EC_MAXIOSEGMENTS];
+   /** inputs are received directly into this buffer instead of the IOmap, NULL if not used */
+   uint8            *inputsdest;
+   /** compiled cyclic frames, cleared by configuration */
+   ec_plant         plan;
 } ec_groupt;
 
 /** SII FMMU structure */
@@ -347,6 +503,8 @@ typedef struct ec_ering
 {
    int16     head;
    int16     tail;
+   /** serialises pushes of concurrent mapper threads */
+   uint8     lock;
    ec_errort Error[EC_MAXELIST + 1];
 } ec_eringt;
 
@@ -429,6 +587,8 @@ struct ecx_context
    int            (*EOEhook)(ecx_contextt * context, uint16 slave, void * eoembx);
    /** flag to control legacy automatic state change or manual state change */
    int            manualstatechange;
+   /** SII cache shared by slaves of the same type, NULL to read every slave */
+   ec_siicachet   *siicache;
 };
 
 #ifdef EC_VER1
@@ -458,6 +618,8 @@ uint16 ec_siiSM(uint16 slave, ec_eepromSMt* SM);
 uint16 ec_siiSMnext(uint16 slave, ec_eepromSMt* SM, uint16 n);
 int ec_siiPDO(uint16 slave, ec_eepromPDOt* PDO, uint8 t);
 int ec_readstate(void);
+int ec_readalstatus(int timeout);
+int ec_readstate_cyclic(uint8 group);
 int ec_writestate(uint16 slave);
 uint16 ec_statecheck(uint16 slave, uint16 reqstate, int timeout);
 int ec_mbxempty(uint16 slave, int timeout);
@@ -475,6 +637,9 @@ int ec_writeeepromFP(uint16 configadr, uint16 eeproma, uint16 data, int timeout)
 void ec_readeeprom1(uint16 slave, uint16 eeproma);
 uint32 ec_readeeprom2(uint16 slave, int timeout);
 int ec_send_processdata_group(uint8 group);
+void ec_set_inputs_destination(uint8 group, void *dest);
+void ec_set_status_decimation(uint8 group, uint16 decimation);
+void ec_set_dctime_decimation(uint8 group, uint16 decimation);
 int ec_send_overlap_processdata_group(uint8 group);
 int ec_receive_processdata_group(uint8 group, int timeout);
 int ec_send_processdata(void);
@@ -494,6 +659,7 @@ int ecx_init(ecx_contextt *context, const char * ifname);
 int ecx_init_redundant(ecx_contextt *context, ecx_redportt *redport, const char *ifname, char *if2name);
 void ecx_close(ecx_contextt *context);
 uint8 ecx_siigetbyte(ecx_contextt *context, uint16 slave, uint16 address);
+ec_siiimaget *ecx_siicache_image(ecx_contextt *context, uint16 slave);
 int16 ecx_siifind(ecx_contextt *context, uint16 slave, uint16 cat);
 void ecx_siistring(ecx_contextt *context, char *str, uint16 slave, uint16 Sn);
 uint16 ecx_siiFMMU(ecx_contextt *context, uint16 slave, ec_eepromFMMUt* FMMU);
@@ -501,6 +667,9 @@ uint16 ecx_siiSM(ecx_contextt *context, uint16 slave, ec_eepromSMt* SM);
 uint16 ecx_siiSMnext(ecx_contextt *context, uint16 slave, ec_eepromSMt* SM, uint16 n);
 int ecx_siiPDO(ecx_contextt *context, uint16 slave, ec_eepromPDOt* PDO, uint8 t);
 int ecx_readstate(ecx_contextt *context);
+int ecx_readalstatus(ecx_contextt *context, int timeout);
+int ecx_readstate_cyclic(ecx_contextt *context, uint8 group);
+int ecx_readdctime_cyclic(ecx_contextt *context, uint8 group);
 int ecx_writestate(ecx_contextt *context, uint16 slave);
 uint16 ecx_statecheck(ecx_contextt *context, uint16 slave, uint16 reqstate, int timeout);
 int ecx_mbxempty(ecx_contextt *context, uint16 slave, int timeout);
@@ -523,6 +692,11 @@ int ecx_send_processdata(ecx_contextt *context);
 int ecx_send_overlap_processdata(ecx_contextt *context);
 int ecx_receive_processdata(ecx_contextt *context, int timeout);
 int ecx_send_processdata_group(ecx_contextt *context, uint8 group);
+void ecx_invalidate_plan(ecx_contextt *context, uint8 group);
+int ecx_plan_slavewkc(ecx_contextt *context, uint8 group, int frame, uint16 slave);
+void ecx_set_inputs_destination(ecx_contextt *context, uint8 group, void *dest);
+void ecx_set_status_decimation(ecx_contextt *context, uint8 group, uint16 decimation);
+void ecx_set_dctime_decimation(ecx_contextt *context, uint8 group, uint16 decimation);
 
 #ifdef __cplusplus
 }
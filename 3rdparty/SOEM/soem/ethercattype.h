@@ -58,8 +58,14 @@ extern "C"
 #define EC_BUFSIZE         EC_MAXECATFRAME
 /** datagram type EtherCAT */
 #define EC_ECATTYPE        0x1000
-/** number of frame buffers per channel (tx, rx1 rx2) */
+/** number of frame buffers per channel (tx, rx1 rx2), may be overridden by
+ * the build. The frame index is one byte, so at most 256 */
+#ifndef EC_MAXBUF
 #define EC_MAXBUF          16
+#endif
+#if (EC_MAXBUF < 2) || (EC_MAXBUF > 256)
+#error "EC_MAXBUF must be in range 2..256"
+#endif
 /** timeout value in us for tx frame to return to rx */
 #define EC_TIMEOUTRET      2000
 #define EC_TIMEOUTRET100      100 // 100us by think
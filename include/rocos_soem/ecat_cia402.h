@@ -0,0 +1,129 @@
+//
+// Created by think on 2024/04/02.
+//
+
+#ifndef ECAT_CIA402_H_INCLUDED
+#define ECAT_CIA402_H_INCLUDED
+
+#include <ecat_config.h>
+
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <vector>
+
+namespace rocos {
+    //! CiA 402 drive states, decoded from the Statusword
+    enum Cia402State : uint16_t {
+        CIA402_NOT_READY_TO_SWITCH_ON = 0,
+        CIA402_SWITCH_ON_DISABLED = 1,
+        CIA402_READY_TO_SWITCH_ON = 2,
+        CIA402_SWITCHED_ON = 3,
+        CIA402_OPERATION_ENABLED = 4,
+        CIA402_QUICK_STOP_ACTIVE = 5,
+        CIA402_FAULT_REACTION_ACTIVE = 6,
+        CIA402_FAULT = 7,
+        CIA402_UNKNOWN = 8
+    };
+
+    /** CiA 402 state machine of a group of drives. update() runs once per
+     *  cycle: it gathers the Statuswords of all axes into one array, decodes
+     *  the states and computes the Controlwords of all axes at once, with
+     *  SSE2 eight axes at a time, and scatters the Controlwords and the modes
+     *  of operation back to the PD memory.
+     *
+     *  enable(), disable(), setMode() and resetFault() can be called from any
+     *  thread. They return a future that becomes true when the axes reached
+     *  the requested state, and false on timeout or when a later request for
+     *  the same axis replaced it. enable() resets faults on the way. Axes
+     *  without a request keep the Controlword the application writes.
+     *
+     *  The PD variables are looked up again when the EcatConfig re-attached
+     *  to a restarted master.
+     */
+    class Cia402Axes {
+    public:
+        /** Axes on the given slaves, each needs Statusword 0x6041 and Controlword 0x6040 mapped. */
+        Cia402Axes(EcatConfig *config, const std::vector<int> &slaves, int timeoutCycles = 5000);
+
+        Cia402Axes(const Cia402Axes &) = delete;
+        Cia402Axes &operator=(const Cia402Axes &) = delete;
+
+        int size() const { return axisNum; }
+
+        /** All axes have Statusword and Controlword mapped. */
+        bool valid() const { return mapped; }
+
+        /** One cycle of the state machine of all axes. */
+        void update();
+
+        /** Bring an axis, or all axes with -1, to OPERATION ENABLED. */
+        std::future<bool> enable(int axis = -1);
+
+        /** Bring an axis, or all axes with -1, to READY TO SWITCH ON. */
+        std::future<bool> disable(int axis = -1);
+
+        /** Mode of operation 0x6060, done when 0x6061 shows it. Needs both mapped. */
+        std::future<bool> setMode(int axis, int8_t mode);
+
+        /** Acknowledge the fault of an axis, or all axes with -1. */
+        std::future<bool> resetFault(int axis = -1);
+
+        //! State of the last update()
+        Cia402State getState(int axis) const { return (Cia402State) state[axis]; }
+
+    private:
+        enum RequestType {
+            REQUEST_ENABLE,
+            REQUEST_DISABLE,
+            REQUEST_MODE,
+            REQUEST_RESET
+        };
+
+        struct Request {
+            RequestType type;
+            int axis;           // -1 for all axes
+            int8_t mode;
+            int cycles;         // left until timeout
+            std::promise<bool> result;
+        };
+
+        void resolve();
+        std::future<bool> request(RequestType type, int axis, int8_t mode = 0);
+        void takeRequests();
+        void decode();
+        bool covers(const Request &r, int axis) const { return (r.axis < 0) || (r.axis == axis); }
+        bool done(const Request &r) const;
+
+        EcatConfig *config;
+        std::vector<int> slaves;
+        uint32_t epoch {0};             // session of the PD pointers
+        int axisNum;
+        int laneNum;        // axes rounded up to whole vectors
+        int timeout;
+        bool mapped {true};
+
+        // PD memory of every axis
+        std::vector<const volatile uint16_t *> statusPtr;
+        std::vector<volatile uint16_t *> controlPtr;
+        std::vector<volatile int8_t *> modePtr;                // nullptr if not mapped
+        std::vector<const volatile int8_t *> modeDisplayPtr;   // nullptr if not mapped
+
+        // one lane per axis
+        std::vector<uint16_t> status;
+        std::vector<uint16_t> state;
+        std::vector<uint16_t> control;
+        std::vector<uint16_t> managed;  // 0xffff if the layer writes the Controlword
+        std::vector<uint16_t> enabled;  // 0xffff towards OPERATION ENABLED, 0 towards READY TO SWITCH ON
+        std::vector<uint16_t> reset;    // 0xffff if a fault is acknowledged
+        std::vector<int8_t> mode;
+        std::vector<uint8_t> modeSet;
+
+        std::mutex mutex;               // guards newRequests
+        std::vector<Request> newRequests;
+        std::atomic<bool> hasNewRequests {false};
+        std::vector<Request> requests;  // only used by update()
+    };
+}
+
+#endif //ECAT_CIA402_H_INCLUDED
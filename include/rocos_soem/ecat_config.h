@@ -11,9 +11,40 @@
 #include <boost/interprocess/shared_memory_object.hpp>
 #include <boost/interprocess/mapped_region.hpp>
 #include <boost/format.hpp>
+#include <cstddef>
+#include <functional>
 #include <map>
+#include <mutex>
+#include <vector>
+
+//! Field of a process data struct, see PdLayout
+#define ROCOS_PD_FIELD(type, member, name) \
+    rocos::PdField {offsetof(type, member), sizeof(((type *) nullptr)->member), name}
 
 namespace rocos {
+    /** One field of a struct bound to the process data of a slave. A field with
+     *  a name is matched to the variable of that name, a field without a name
+     *  to the variable at the same position. */
+    struct PdField {
+        size_t offset;
+        size_t size;
+        const char *name;
+    };
+
+    /** Field list of a struct bound with bindInputs() or bindOutputs().
+     *  Specialise fields() to have every field checked at bind time, e.g.
+     *
+     *      template<> std::vector<rocos::PdField> rocos::PdLayout<DriveIn>::fields() {
+     *          return {ROCOS_PD_FIELD(DriveIn, position, "Position actual value"),
+     *                  ROCOS_PD_FIELD(DriveIn, status, "Statusword")};
+     *      }
+     *
+     *  Without a specialisation only the size of the struct is checked. */
+    template<typename T>
+    struct PdLayout {
+        static std::vector<PdField> fields() { return {}; }
+    };
+
     class EcatConfig {
     private:
         EcatConfig(int id = 0);
@@ -24,6 +55,33 @@ namespace rocos {
 
         void wait();
 
+        /** Wait for the next cycle with new inputs, at most timeoutUs, -1 without
+         *  timeout. Any number of threads and processes can wait.
+         *  @return cycles since the previous waitFor() of this thread, more than
+         *  1 if cycles were missed, 0 on timeout, -1 if cancelled */
+        int waitFor(long timeoutUs = -1);
+
+        //! Cycles this thread missed between its calls of waitFor()
+        uint64_t getMissedCycles() const;
+
+        /** Make the waitFor() calls in progress return -1. */
+        void cancelWait();
+
+        /** Re-attach if the master restarted since the last check: map the new
+         *  shared memory and PD memory and call the onReattach() callbacks.
+         *  One atomic load while the master runs, meant to be called once per
+         *  cycle; wait() and waitFor() call it. Pointers from an earlier
+         *  mapping stay readable until the next restart.
+         *  @return true if re-attached */
+        bool checkSession();
+
+        //! Epoch of the master session the pointers of this instance belong to, 0 before the first master
+        uint32_t getSessionEpoch() const;
+
+        /** Call callback after every re-attach, from the thread that found the
+         *  restart, e.g. to fetch PD variable pointers again. */
+        void onReattach(std::function<void()> callback);
+
         double getBusMinCycleTime() const;
 
         double getBusMaxCycleTime() const;
@@ -38,6 +96,28 @@ namespace rocos {
 
         int getSlaveNum() const;
 
+        EcatRedundancy getRedundancy() const;
+
+        EcatRxStatistics getRxStatistics() const;
+
+        int getWkc() const;
+        int getExpectedWkc() const;
+        uint32_t getWkcErrorCount() const;
+        int getSuspectSlave() const;
+        uint32_t getOverrunCount() const;
+
+        SlaveHealth getSlaveHealth(int slaveId) const;
+        SlaveDc getSlaveDc(int slaveId) const;
+        int32_t getDcMaxDiff() const;
+        SlaveTopology getSlaveTopology(int slaveId) const;
+        int getReferenceClock() const;
+        bool isSync0Enabled() const;
+        int32_t getSync0Shift() const;
+
+        void requestCaptureDump();
+        std::string getCaptureFile() const;
+        int  getCaptureDumpCount() const;
+
         void resetCycleTime();
 
         void setBusRequestState(int state);
@@ -189,23 +269,97 @@ namespace rocos {
             return nullptr;
         }
 
+        /** Bytes of the input image of the slaves firstSlave to lastSlave, -1 is the last slave. */
+        int getInputImageSize(int firstSlave = 0, int lastSlave = -1) const;
+
+        /** Bytes of the output image of the slaves firstSlave to lastSlave, -1 is the last slave. */
+        int getOutputImageSize(int firstSlave = 0, int lastSlave = -1) const;
+
+        /** Copy the input image of the slaves firstSlave to lastSlave, all
+         *  from the same cycle, to buffer of getInputImageSize() bytes.
+         *  @return false if the master did not release the image in time */
+        bool snapshotInputs(void *buffer, PdStamp *stamp = nullptr, int firstSlave = 0, int lastSlave = -1);
+
+        /** Copy the map of the slaves and input variables that changed from
+         *  the previous input image, see EcatChangeMap, to bits. stamp is the
+         *  cycle of the image the map belongs to, baseCycle the cycle of the
+         *  image it is against: a client that did not see that image missed
+         *  changes and has to read all inputs once.
+         *  @return false without change map or if the master did not release it in time */
+        bool snapshotInputChanges(std::vector<uint64_t> &bits, PdStamp *stamp = nullptr, uint64_t *baseCycle = nullptr);
+
+        /** bits from snapshotInputChanges() mark input variable varId of the slave, or any of its inputs with -1. */
+        bool isInputChanged(const std::vector<uint64_t> &bits, int slaveId, int varId = -1) const;
+
+        /** Copy buffer of getOutputImageSize() bytes to the output image of
+         *  the slaves firstSlave to lastSlave. The master sends all of it in
+         *  the same cycle. */
+        void commitOutputs(const void *buffer, int firstSlave = 0, int lastSlave = -1);
+
+        /** View of the whole input image of a slave as T, checked once against
+         *  the mapping of the slave. A packed T matching the PDOs is read with
+         *  one copy per cycle. @return nullptr if T does not match */
+        template<typename T>
+        const T* bindInputs(int slaveId) {
+            int offset = checkBinding(ecatBus->slaves[slaveId].input_vars.get(), ecatBus->slaves[slaveId].input_var_num,
+                                      sizeof(T), PdLayout<T>::fields());
+            return offset < 0 ? nullptr : (const T *) ((char *) pdInputPtr + offset);
+        }
+
+        /** View of the whole output image of a slave as T, see bindInputs(). */
+        template<typename T>
+        T* bindOutputs(int slaveId) {
+            int offset = checkBinding(ecatBus->slaves[slaveId].output_vars.get(), ecatBus->slaves[slaveId].output_var_num,
+                                      sizeof(T), PdLayout<T>::fields());
+            return offset < 0 ? nullptr : (T *) ((char *) pdOutputPtr + offset);
+        }
+
 
     private:
         static std::map<int, EcatConfig*> instances;
 
+        int checkBinding(const PdVar *vars, int varNum, size_t size, const std::vector<PdField> &fields);
+
+        bool imageRange(bool inputs, int firstSlave, int lastSlave, int &offset, int &size) const;
+
         void init();
 
         bool getSharedMemory();
 
         bool getPdDataMemoryProvider();
 
+        bool getSession();
+
+        void reattach(uint32_t epoch);
+
 
         std::vector<std::thread::id> threadId;
 
+        std::atomic<uint32_t> cancelCount {0};
+
+        //! Mapping of an earlier master, kept for the threads that did not check the session yet
+        struct RetiredMapping {
+            boost::interprocess::managed_shared_memory *managedSharedMemory;
+            boost::interprocess::shared_memory_object *pdInputShm;
+            boost::interprocess::shared_memory_object *pdOutputShm;
+            boost::interprocess::mapped_region *pdInputRegion;
+            boost::interprocess::mapped_region *pdOutputRegion;
+        };
+        RetiredMapping retired {};
+
+        // Session of the master
+        boost::interprocess::shared_memory_object *sessionShm = nullptr;
+        boost::interprocess::mapped_region *sessionRegion = nullptr;
+        EcatSession *session = nullptr;
+        std::atomic<uint32_t> attachedEpoch {0};
+        std::mutex sessionMutex;        // guards re-attach and reattachCallbacks
+        std::vector<std::function<void()>> reattachCallbacks;
+
         std::string ecmName {EC_SHM};
         std::string mutexName {EC_SEM_MUTEX};
         std::string pdInputName {"pd_input"};
         std::string pdOutputName {"pd_output"};
+        std::string sessionName {EC_SHM_SESSION};
 
         boost::interprocess::managed_shared_memory *managedSharedMemory = nullptr;
 
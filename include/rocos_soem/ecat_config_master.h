@@ -78,6 +78,12 @@ public:
 
     bool getPdDataMemoryProvider();
 
+    bool createSlaveTable(int slaveNum);
+
+    rocos::PdVar *createPdVarTable(int varNum);
+
+    uint64_t *createChangeMap(int words);
+
     void init();
 
     void waitForSignal(int id = 0); // compact code, not recommended use. use wait() instead
@@ -86,6 +92,13 @@ public:
 
     void updateSempahore();
 
+    /** Wake the clients waiting in EcatConfig::waitFor(). */
+    void notifyCycle();
+
+    /** Start a new session epoch once the bus and the PD memory are complete,
+     *  the clients of an earlier master re-attach to this memory. */
+    void publishSession();
+
     template<typename T>
     T getSlaveInputVarValue(int slaveId, int varId) {
         if (sizeof(T) != ecatBus->slaves[slaveId].input_vars[varId].size) {
@@ -227,6 +240,11 @@ public:
     void *pdInputPtr = nullptr;
     void *pdOutputPtr = nullptr;
 
+    // Session, kept over restarts of the master
+    boost::interprocess::shared_memory_object *sessionShm = nullptr;
+    boost::interprocess::mapped_region *sessionRegion = nullptr;
+    rocos::EcatSession *session = nullptr;
+
 
     sem_t *sem_mutex[EC_SEM_NUM];
 
@@ -237,6 +255,7 @@ protected:
     std::string mutexName{EC_SEM_MUTEX};
     std::string pdInputName{"pd_input"};
     std::string pdOutputName{"pd_output"};
+    std::string sessionName{EC_SHM_SESSION};
 
 
     //////////// OUTPUT FORMAT SETTINGS ////////////////////
@@ -33,20 +33,23 @@ Yang Luo, PHD
 
 
 #include <semaphore.h> //sem
+#include <atomic>
 #include <cinttypes>
 
-#define MAX_SLAVE_NUM 50     // Maximal number of slaves in the EtherCAT network
-#define MAX_PDINPUT_NUM 25   // Maximal number of PD Inputs per slave
-#define MAX_PDOUTPUT_NUM 25  // Maximal number of PD Outputs per slave
+#include <boost/interprocess/offset_ptr.hpp>
 
 #define MAX_PD_NAME_LEN 72    // Maximal length of a PD Variable name
 #define MAX_SLAVE_NAME_LEN 80 // Maximal length of a slave name
+#define MAX_FILE_NAME_LEN 256 // Maximal length of a file name
 
 #define EC_SEM_MUTEX "sync"
 #define EC_SEM_NUM 10
 
 #define EC_SHM "ecm"
-#define EC_SHM_MAX_SIZE 5242880 // 5MB
+#define EC_SHM_SESSION "ecm_session" // outlives the master, holds the epoch of the running master
+#ifndef EC_SHM_MAX_SIZE
+#define EC_SHM_MAX_SIZE 5242880 // 5MB, slave and PD variable tables are allocated from it at configuration
+#endif
 
 
 #define ECAT_STATE_INIT 1
@@ -65,6 +68,46 @@ namespace rocos {
         uint8_t  sub_index             {0};
     };
 
+    struct SlaveHealth {
+        int      al_state            {0};      // AL status of the last diagnosis, ECAT_STATE_ and 0x10 for error
+        uint16_t al_status_code      {0};
+        bool     lost                {false};  // slave does not answer
+        bool     wkc_fault           {false};  // a frame with data of this slave returned with a low work counter in the last cycle
+        uint32_t wkc_error_count     {0};      // cycles with a low work counter in a frame of this slave
+        // ESC error counters 0x0300-0x0313 of the last diagnosis, index is the port, the ESC saturates them at 255
+        uint8_t  invalid_frames[4]   {0, 0, 0, 0};
+        uint8_t  rx_errors[4]        {0, 0, 0, 0};
+        uint8_t  forwarded_errors[4] {0, 0, 0, 0};
+        uint8_t  lost_links[4]       {0, 0, 0, 0};
+        uint8_t  processing_errors   {0};
+        uint8_t  pdi_errors          {0};
+        bool     counters_rising     {false};  // error counters increased since the previous diagnosis
+        long     timestamp           {0};      // time of the last diagnosis, ns
+    };
+
+    struct SlaveDc {
+        bool     enabled             {false};  // slave has DC and its system time difference is monitored
+        int32_t  time_diff           {0};      // system time difference 0x092C of the last sample, ns, local minus reference
+        int32_t  min_diff            {0};      // ns, since monitoring started
+        int32_t  max_diff            {0};      // ns, since monitoring started
+        double   mean_diff           {0.0};    // moving average, ns
+        double   std_diff            {0.0};    // moving standard deviation, ns
+        uint32_t samples             {0};
+    };
+
+    struct SlaveTopology {
+        int16_t  parent              {-1};     // id of the slave this slave is connected to, -1 for the master
+        uint8_t  entry_port          {0};      // port the frames come in on
+        uint8_t  parent_port         {0};      // port of the DC parent this slave is connected to, DC slaves only
+        uint8_t  active_ports        {0};      // bit per port with a link
+        uint8_t  links               {0};      // ports with a link, 1 is the end of a line
+        bool     has_dc              {false};
+        bool     reference_clock     {false};  // first DC slave, the system time of the others follows it
+        int32_t  propagation_delay   {0};      // ns from the reference clock, DC slaves only
+        int32_t  link_delay          {0};      // ns from the DC parent, DC slaves only
+        int32_t  port_times[4]       {0, 0, 0, 0}; // receive time of the frame on each linked port after the entry port, ns, DC slaves only
+    };
+
     struct Slave {
         int id                          {-1};
         char name[MAX_SLAVE_NAME_LEN]   {'\0'};;
@@ -72,8 +115,74 @@ namespace rocos {
         int input_var_num               {0};
         int output_var_num              {0};
 
-        PdVar input_vars[MAX_PDINPUT_NUM];
-        PdVar output_vars[MAX_PDOUTPUT_NUM];
+        // sized to the PDO mapping of the slave, allocated in shared memory by the master
+        boost::interprocess::offset_ptr<PdVar> input_vars;
+        boost::interprocess::offset_ptr<PdVar> output_vars;
+
+        SlaveHealth health;                     // updated by the master when the work counter is low
+        SlaveDc dc;                             // updated by the master from the cyclic frames
+        SlaveTopology topology;                 // updated by the master at configuration and after a slave is reconfigured
+        int input_change_bit            {-1};   // bit of the first input variable in EcatChangeMap::bits, -1 without change map
+    };
+
+    struct EcatRedundancy {
+        bool enabled                 {false};  // master runs with a secondary port
+        bool line_break              {false};  // ring was open in the last cycle
+        int  rx_ports                {0};      // ports the frames returned on, bit 0 primary, bit 1 secondary
+        uint32_t line_break_count    {0};      // frames that found the ring open
+        uint32_t resend_count        {0};      // frames resent over the secondary port
+        double extra_latency         {0.0};    // us spent on resends in the last cycle
+        double max_extra_latency     {0.0};    // us
+    };
+
+    struct EcatRxStatistics {
+        uint64_t packets             {0};      // frames passed by the socket filter
+        uint64_t drops               {0};      // frames dropped by the kernel, socket queue full
+        uint64_t other_frames        {0};      // frames received that the master did not wait for
+        uint32_t copies_per_cycle    {0};      // payload copies from socket to shared memory in the last cycle
+        uint32_t copy_bytes_per_cycle{0};      // bytes copied in the last cycle
+    };
+
+    /** Sequence counters of the PD memory. A writer makes its counter odd
+     *  before and even again after it changed the image, a reader retries
+     *  when the counter was odd or changed while it copied. */
+    struct EcatImageSync {
+        std::atomic<uint32_t> input_seq  {0};  // written by the master once per cycle
+        std::atomic<uint32_t> output_seq {0};  // written by the clients that commit outputs
+        uint64_t cycle               {0};      // cycle of the input image
+        int64_t  dc_time             {0};      // DC system time of the input image, ns, 0 without DC
+        uint32_t output_skips        {0};      // cycles without a consistent output image, a commit was in progress
+    };
+
+    /** Cycle notification of the clients. cycle is a futex word, waiting
+     *  clients sleep on it and are woken by the master after every cycle. */
+    struct EcatCycleNotify {
+        std::atomic<uint32_t> cycle   {0};     // cycles with new inputs
+        std::atomic<uint32_t> waiters {0};     // clients sleeping on cycle, the master wakes them only if there are
+    };
+
+    /** Session of the master, in its own shared memory object that is never
+     *  removed. epoch is incremented whenever the master (re)created the
+     *  shared memory; a client whose EcatBus holds another epoch looks at an
+     *  orphaned mapping. */
+    struct EcatSession {
+        std::atomic<uint32_t> epoch  {0};      // 0 until a master published its session
+    };
+
+    /** Slaves and input variables that changed from the previous input image,
+     *  written by the master with the image and guarded by input_seq. bits
+     *  holds one bit per slave, bit s for slave s, then one bit per input
+     *  variable from Slave::input_change_bit of its slave on. */
+    struct EcatChangeMap {
+        uint64_t base_cycle          {0};      // cycle of the image the changes are against, 0 if none
+        int words                    {0};      // 64 bit words of bits, 0 without change map
+        boost::interprocess::offset_ptr<uint64_t> bits;
+    };
+
+    //! Cycle and DC time of a snapshot of the input image
+    struct PdStamp {
+        uint64_t cycle               {0};
+        int64_t  dc_time             {0};
     };
 
     struct EcatBus {
@@ -92,8 +201,34 @@ namespace rocos {
 
         bool is_authorized           {false};
 
+        int wkc                      {0};     // work counter of the last cycle
+        int expected_wkc             {0};
+        uint32_t wkc_error_count     {0};     // cycles with a low work counter
+        int wkc_fault_frames         {0};     // frames with a low work counter in the last cycle
+        int suspect_slave            {-1};    // first slave found faulty by the last diagnosis, -1 if none
+        uint32_t overrun_count       {0};     // cycles that started late
+        double last_overrun          {0.0};   // us the last late cycle took
+        int32_t dc_max_diff          {0};     // largest absolute system time difference of the last sample, ns
+        uint32_t dc_drift_datagrams  {0};     // FRMW datagrams of the static drift compensation before OP
+        int reference_clock          {-1};    // id of the DC reference clock, -1 without DC
+        uint32_t topology_updates    {0};     // incremented whenever the topology of the slaves is published
+        bool sync0_enabled           {false}; // Sync0 active on the DC slaves
+        int32_t sync0_shift          {0};     // Sync0 shift of the DC slaves, ns
+        int32_t sync0_jitter         {0};     // spread of the frames over the calibration, ns, 0 if the shift was stored
+        uint32_t session_epoch       {0};     // EcatSession::epoch of the master that created this memory
+
+        EcatRedundancy redundancy;
+        EcatRxStatistics rx_statistics;
+        EcatImageSync image;
+        EcatCycleNotify notify;
+        EcatChangeMap input_changes;
+
+        bool capture_request         {false}; // set to dump the capture ring, cleared by master
+        int  capture_dump_count      {0};     // number of dumps written
+        char capture_file[MAX_FILE_NAME_LEN] {'\0'}; // last dump written
+
         int slave_num                 {0};
-        Slave slaves[MAX_SLAVE_NUM];
+        boost::interprocess::offset_ptr<Slave> slaves; // slave_num entries, allocated in shared memory by the master
 
     };
 
@@ -0,0 +1,82 @@
+//
+// Created by think on 2024/04/03.
+//
+
+#ifndef ECAT_UNITS_H_INCLUDED
+#define ECAT_UNITS_H_INCLUDED
+
+#include <cstdint>
+#include <vector>
+
+namespace rocos {
+    /** Conversion between the raw integers of a process image and engineering
+     *  units, one channel per variable:
+     *
+     *      value = raw * scale / gear + offset
+     *
+     *  The table is set up once with addChannel(), in the order of the values
+     *  array. toUnits() converts a whole input image, e.g. from
+     *  EcatConfig::snapshotInputs(), to a contiguous double array, toRaw()
+     *  converts a double array back into an output image for commitOutputs(),
+     *  rounded to nearest and saturated to the type of the channel.
+     *
+     *  The kernel is chosen at construction: AVX2 if the CPU has it, NEON on
+     *  ARM, scalar otherwise.
+     */
+    class UnitConverter {
+    public:
+        enum Type {
+            INT16,
+            INT32
+        };
+
+        /** Channels of an image of imageSize bytes. vectorised = false always uses the scalar kernel. */
+        explicit UnitConverter(int imageSize, bool vectorised = true);
+
+        /** Add a variable at byteOffset of the image. @return index in the values array, -1 if outside the image */
+        int addChannel(int byteOffset, Type type, double scale, double offset = 0.0, double gear = 1.0);
+
+        int size() const { return (int) type.size(); }
+
+        //! Name of the kernel in use: "avx2", "neon" or "scalar"
+        const char *kernel() const;
+
+        /** values[i] of every channel from the image. */
+        void toUnits(const void *image, double *values) const;
+
+        /** Channels of the image from values[i], other bytes of the image are not touched. */
+        void toRaw(const double *values, void *image) const;
+
+    private:
+        enum Kernel {
+            KERNEL_SCALAR,
+            KERNEL_AVX2,
+            KERNEL_NEON
+        };
+
+        void toUnitsScalar(const uint8_t *image, double *values, int first) const;
+        void toRawScalar(const double *values, uint8_t *image, int first) const;
+        void toUnitsAvx2(const uint8_t *image, double *values) const;
+        void toRawAvx2(const double *values, uint8_t *image) const;
+        void toUnitsNeon(const uint8_t *image, double *values) const;
+        void toRawNeon(const double *values, uint8_t *image) const;
+
+        int imageSize;
+        Kernel kernelType {KERNEL_SCALAR};
+
+        // one entry per channel
+        std::vector<uint8_t> type;
+        std::vector<int32_t> byteOffset;
+        std::vector<int32_t> window;        // offset of the 32 bit word holding the channel
+        std::vector<int32_t> shiftLeft;     // sign extension of the channel in its word
+        std::vector<int32_t> shiftRight;
+        std::vector<double> factor;         // scale / gear
+        std::vector<double> offset;
+        std::vector<double> inverse;        // gear / scale
+        std::vector<double> rawOffset;      // -offset * gear / scale
+        std::vector<double> rawMin;
+        std::vector<double> rawMax;
+    };
+}
+
+#endif //ECAT_UNITS_H_INCLUDED
@@ -0,0 +1,308 @@
+//
+// Created by think on 2024/04/02.
+//
+
+#include <ecat_cia402.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace rocos;
+
+Cia402Axes::Cia402Axes(EcatConfig *config, const std::vector<int> &slaves, int timeoutCycles)
+        : config(config), slaves(slaves), axisNum((int) slaves.size()), laneNum(((int) slaves.size() + 7) / 8 * 8),
+          timeout(timeoutCycles), statusPtr(axisNum, nullptr), controlPtr(axisNum, nullptr), modePtr(axisNum, nullptr),
+          modeDisplayPtr(axisNum, nullptr), status(laneNum, 0), state(laneNum, CIA402_UNKNOWN), control(laneNum, 0),
+          managed(laneNum, 0), enabled(laneNum, 0), reset(laneNum, 0), mode(axisNum, 0), modeSet(axisNum, 0) {
+    resolve();
+}
+
+/** Find the PD variables of every axis in the mapping of the current session. */
+void Cia402Axes::resolve() {
+    epoch = config->getSessionEpoch();
+    mapped = true;
+    for (int k = 0; k < axisNum; ++k) {
+        statusPtr[k] = nullptr;
+        controlPtr[k] = nullptr;
+        modePtr[k] = nullptr;
+        modeDisplayPtr[k] = nullptr;
+        if ((slaves[k] < 0) || (slaves[k] >= config->getSlaveNum())) {
+            mapped = false;
+            continue;
+        }
+        Slave slave = config->getSlave(slaves[k]);
+        for (int i = 0; i < slave.input_var_num; ++i) {
+            if (slave.input_vars[i].index == 0x6041)
+                statusPtr[k] = config->getSlaveInputVarPtr<uint16_t>(slaves[k], i);
+            else if (slave.input_vars[i].index == 0x6061)
+                modeDisplayPtr[k] = config->getSlaveInputVarPtr<int8_t>(slaves[k], i);
+        }
+        for (int i = 0; i < slave.output_var_num; ++i) {
+            if (slave.output_vars[i].index == 0x6040)
+                controlPtr[k] = config->getSlaveOutputVarPtr<uint16_t>(slaves[k], i);
+            else if (slave.output_vars[i].index == 0x6060)
+                modePtr[k] = config->getSlaveOutputVarPtr<int8_t>(slaves[k], i);
+        }
+        if (!statusPtr[k] || !controlPtr[k])
+            mapped = false;
+    }
+}
+
+void Cia402Axes::update() {
+    if (config->getSessionEpoch() != epoch)
+        resolve(); // the master restarted
+    if (!mapped)
+        return;
+    if (hasNewRequests.load(std::memory_order_acquire))
+        takeRequests();
+
+    /* gather */
+    for (int k = 0; k < axisNum; ++k) {
+        status[k] = *statusPtr[k];
+        control[k] = *controlPtr[k];
+    }
+
+    decode();
+
+    /* scatter */
+    for (int k = 0; k < axisNum; ++k) {
+        if (managed[k])
+            *controlPtr[k] = control[k];
+        if (modeSet[k])
+            *modePtr[k] = mode[k];
+    }
+
+    for (auto it = requests.begin(); it != requests.end();) {
+        bool ok = done(*it);
+        if (!ok && (--it->cycles > 0)) {
+            ++it;
+            continue;
+        }
+        /* faults are acknowledged only while a request asks for it */
+        for (int k = 0; k < axisNum; ++k) {
+            if (covers(*it, k) && (it->type != REQUEST_MODE))
+                reset[k] = 0;
+        }
+        it->result.set_value(ok);
+        it = requests.erase(it);
+    }
+}
+
+std::future<bool> Cia402Axes::enable(int axis) {
+    return request(REQUEST_ENABLE, axis);
+}
+
+std::future<bool> Cia402Axes::disable(int axis) {
+    return request(REQUEST_DISABLE, axis);
+}
+
+std::future<bool> Cia402Axes::setMode(int axis, int8_t mode) {
+    return request(REQUEST_MODE, axis, mode);
+}
+
+std::future<bool> Cia402Axes::resetFault(int axis) {
+    return request(REQUEST_RESET, axis);
+}
+
+std::future<bool> Cia402Axes::request(RequestType type, int axis, int8_t mode) {
+    Request r;
+    r.type = type;
+    r.axis = axis;
+    r.mode = mode;
+    r.cycles = timeout;
+    std::future<bool> result = r.result.get_future();
+
+    if (!mapped || (axis >= axisNum)) {
+        r.result.set_value(false);
+        return result;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    newRequests.push_back(std::move(r));
+    hasNewRequests.store(true, std::memory_order_release);
+
+    return result;
+}
+
+/** Move the new requests to the cycle and set the lanes of their axes. */
+void Cia402Axes::takeRequests() {
+    std::vector<Request> taken;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        taken.swap(newRequests);
+        hasNewRequests.store(false, std::memory_order_relaxed);
+    }
+
+    for (Request &r: taken) {
+        bool isMode = (r.type == REQUEST_MODE);
+        /* a request replaces the earlier ones for the same axes */
+        for (auto it = requests.begin(); it != requests.end();) {
+            bool overlaps = (it->axis < 0) || (r.axis < 0) || (it->axis == r.axis);
+            if (overlaps && ((it->type == REQUEST_MODE) == isMode)) {
+                it->result.set_value(false);
+                it = requests.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        bool ok = true;
+        for (int k = 0; k < axisNum; ++k) {
+            if (!covers(r, k))
+                continue;
+            switch (r.type) {
+                case REQUEST_ENABLE:
+                    managed[k] = 0xffff;
+                    enabled[k] = 0xffff;
+                    reset[k] = 0xffff;
+                    break;
+                case REQUEST_DISABLE:
+                    managed[k] = 0xffff;
+                    enabled[k] = 0;
+                    reset[k] = 0;
+                    break;
+                case REQUEST_RESET:
+                    /* an axis is enabled again only on request */
+                    managed[k] = 0xffff;
+                    enabled[k] = 0;
+                    reset[k] = 0xffff;
+                    break;
+                case REQUEST_MODE:
+                    if (modePtr[k] && modeDisplayPtr[k]) {
+                        mode[k] = r.mode;
+                        modeSet[k] = 1;
+                    } else {
+                        ok = false;
+                    }
+                    break;
+            }
+        }
+        if (ok)
+            requests.push_back(std::move(r));
+        else
+            r.result.set_value(false);
+    }
+}
+
+bool Cia402Axes::done(const Request &r) const {
+    for (int k = 0; k < axisNum; ++k) {
+        if (!covers(r, k))
+            continue;
+        switch (r.type) {
+            case REQUEST_ENABLE:
+                if (state[k] != CIA402_OPERATION_ENABLED)
+                    return false;
+                break;
+            case REQUEST_DISABLE:
+                if ((state[k] != CIA402_READY_TO_SWITCH_ON) && (state[k] != CIA402_SWITCH_ON_DISABLED))
+                    return false;
+                break;
+            case REQUEST_RESET:
+                if ((state[k] == CIA402_FAULT) || (state[k] == CIA402_FAULT_REACTION_ACTIVE))
+                    return false;
+                break;
+            case REQUEST_MODE:
+                if (*modeDisplayPtr[k] != mode[k])
+                    return false;
+                break;
+        }
+    }
+
+    return true;
+}
+
+/** Decode the Statuswords and compute the Controlwords of all lanes.
+ *
+ *  state           towards enabled     towards disabled
+ *  SWITCH ON DIS.  0x06 shutdown       0x06 shutdown
+ *  READY           0x07 switch on      0x06 shutdown
+ *  SWITCHED ON     0x0f enable op.     0x06 shutdown
+ *  OP. ENABLED     0x0f enable op.     0x06 shutdown
+ *  FAULT           0x80 and 0x00 alternating if acknowledged
+ *  others          0x00 disable voltage
+ *
+ *  Bits 4 to 6 and 8 to 15 are left to the application.
+ */
+void Cia402Axes::decode() {
+#ifdef __SSE2__
+    const __m128i one = _mm_set1_epi16(1);
+    for (int i = 0; i < laneNum; i += 8) {
+        __m128i sw = _mm_loadu_si128((const __m128i *) &status[i]);
+        __m128i cw = _mm_loadu_si128((const __m128i *) &control[i]);
+        __m128i en = _mm_loadu_si128((const __m128i *) &enabled[i]);
+        __m128i rst = _mm_loadu_si128((const __m128i *) &reset[i]);
+        __m128i mg = _mm_loadu_si128((const __m128i *) &managed[i]);
+
+        /* one mask per state */
+        __m128i m4f = _mm_and_si128(sw, _mm_set1_epi16(0x4f));
+        __m128i m6f = _mm_and_si128(sw, _mm_set1_epi16(0x6f));
+        __m128i notReady = _mm_cmpeq_epi16(m4f, _mm_setzero_si128());
+        __m128i switchOnDisabled = _mm_cmpeq_epi16(m4f, _mm_set1_epi16(0x40));
+        __m128i ready = _mm_cmpeq_epi16(m6f, _mm_set1_epi16(0x21));
+        __m128i switchedOn = _mm_cmpeq_epi16(m6f, _mm_set1_epi16(0x23));
+        __m128i opEnabled = _mm_cmpeq_epi16(m6f, _mm_set1_epi16(0x27));
+        __m128i quickStop = _mm_cmpeq_epi16(m6f, _mm_set1_epi16(0x07));
+        __m128i faultReaction = _mm_cmpeq_epi16(m4f, _mm_set1_epi16(0x0f));
+        __m128i fault = _mm_cmpeq_epi16(m4f, _mm_set1_epi16(0x08));
+
+        __m128i known = _mm_or_si128(_mm_or_si128(_mm_or_si128(notReady, switchOnDisabled), _mm_or_si128(ready, switchedOn)),
+                                     _mm_or_si128(_mm_or_si128(opEnabled, quickStop), _mm_or_si128(faultReaction, fault)));
+        __m128i st = _mm_and_si128(switchOnDisabled, one);
+        st = _mm_or_si128(st, _mm_and_si128(ready, _mm_set1_epi16(2)));
+        st = _mm_or_si128(st, _mm_and_si128(switchedOn, _mm_set1_epi16(3)));
+        st = _mm_or_si128(st, _mm_and_si128(opEnabled, _mm_set1_epi16(4)));
+        st = _mm_or_si128(st, _mm_and_si128(quickStop, _mm_set1_epi16(5)));
+        st = _mm_or_si128(st, _mm_and_si128(faultReaction, _mm_set1_epi16(6)));
+        st = _mm_or_si128(st, _mm_and_si128(fault, _mm_set1_epi16(7)));
+        st = _mm_or_si128(st, _mm_andnot_si128(known, _mm_set1_epi16(8)));
+
+        /* command bits, towards enabled or disabled per lane */
+        __m128i shutdown = _mm_set1_epi16(0x06);
+        __m128i readyCmd = _mm_or_si128(_mm_and_si128(en, _mm_set1_epi16(0x07)), _mm_andnot_si128(en, shutdown));
+        __m128i onCmd = _mm_or_si128(_mm_and_si128(en, _mm_set1_epi16(0x0f)), _mm_andnot_si128(en, shutdown));
+        __m128i cmd = _mm_and_si128(switchOnDisabled, shutdown);
+        cmd = _mm_or_si128(cmd, _mm_and_si128(ready, readyCmd));
+        cmd = _mm_or_si128(cmd, _mm_and_si128(_mm_or_si128(switchedOn, opEnabled), onCmd));
+        cmd = _mm_or_si128(cmd, _mm_and_si128(_mm_and_si128(fault, rst), _mm_andnot_si128(cw, _mm_set1_epi16(0x80))));
+
+        __m128i next = _mm_or_si128(_mm_andnot_si128(_mm_set1_epi16(0x8f), cw), cmd);
+        cw = _mm_or_si128(_mm_and_si128(mg, next), _mm_andnot_si128(mg, cw));
+
+        _mm_storeu_si128((__m128i *) &state[i], st);
+        _mm_storeu_si128((__m128i *) &control[i], cw);
+    }
+#else
+    for (int i = 0; i < laneNum; ++i) {
+        uint16_t m4f = status[i] & 0x4f;
+        uint16_t m6f = status[i] & 0x6f;
+        uint16_t cmd = 0;
+
+        if (m4f == 0x00) {
+            state[i] = CIA402_NOT_READY_TO_SWITCH_ON;
+        } else if (m4f == 0x40) {
+            state[i] = CIA402_SWITCH_ON_DISABLED;
+            cmd = 0x06;
+        } else if (m6f == 0x21) {
+            state[i] = CIA402_READY_TO_SWITCH_ON;
+            cmd = enabled[i] ? 0x07 : 0x06;
+        } else if (m6f == 0x23) {
+            state[i] = CIA402_SWITCHED_ON;
+            cmd = enabled[i] ? 0x0f : 0x06;
+        } else if (m6f == 0x27) {
+            state[i] = CIA402_OPERATION_ENABLED;
+            cmd = enabled[i] ? 0x0f : 0x06;
+        } else if (m6f == 0x07) {
+            state[i] = CIA402_QUICK_STOP_ACTIVE;
+        } else if (m4f == 0x0f) {
+            state[i] = CIA402_FAULT_REACTION_ACTIVE;
+        } else if (m4f == 0x08) {
+            state[i] = CIA402_FAULT;
+            cmd = reset[i] ? (~control[i] & 0x80) : 0;
+        } else {
+            state[i] = CIA402_UNKNOWN;
+        }
+        if (managed[i])
+            control[i] = (control[i] & ~0x8f) | cmd;
+    }
+#endif
+}
@@ -4,7 +4,13 @@
 
 #include <ecat_config.h>
 #include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <ctime>
 #include <iostream>
+#include <linux/futex.h>
+#include <sys/syscall.h>
 
 
 using namespace rocos;
@@ -14,6 +20,7 @@ EcatConfig::EcatConfig(int id) {
     mutexName = EC_SEM_MUTEX + std::to_string(id) + "_";
     pdInputName = "pd_input" + std::to_string(id);
     pdOutputName = "pd_output" + std::to_string(id);
+    sessionName = EC_SHM_SESSION + std::to_string(id);
 
     init();
 }
@@ -71,11 +78,105 @@ bool EcatConfig::getPdDataMemoryProvider() {
     return true;
 }
 
+bool EcatConfig::getSession() {
+    using namespace boost::interprocess;
+
+    try {
+        sessionShm = new shared_memory_object(open_or_create, sessionName.c_str(), read_write);
+        offset_t size = 0;
+        if (!sessionShm->get_size(size) || (size < (offset_t) sizeof(EcatSession)))
+            sessionShm->truncate(sizeof(EcatSession));
+        sessionRegion = new mapped_region(*sessionShm, read_write);
+    } catch (const interprocess_exception &e) {
+        print_message("[SHM] Can not open session " + sessionName + ", master restarts are not detected: " +
+                      e.what(), MessageLevel::WARNING);
+        return false;
+    }
+
+    session = static_cast<EcatSession *>(sessionRegion->get_address());
+    attachedEpoch.store(session->epoch.load());
+
+    return true;
+}
+
+bool EcatConfig::checkSession() {
+    if (session == nullptr)
+        return false;
+    uint32_t epoch = session->epoch.load(std::memory_order_acquire);
+    if (epoch == attachedEpoch.load(std::memory_order_relaxed))
+        return false;
+
+    std::lock_guard<std::mutex> lock(sessionMutex);
+    if (epoch == attachedEpoch.load()) // another thread re-attached
+        return false;
+    reattach(epoch);
+    for (auto &callback: reattachCallbacks)
+        callback();
+
+    return true;
+}
+
+/** Map the memory of the master of session epoch, the current mapping is retired. */
+void EcatConfig::reattach(uint32_t epoch) {
+    /* the mapping retired at the previous restart is not used any more */
+    delete retired.pdInputRegion;
+    delete retired.pdOutputRegion;
+    delete retired.pdInputShm;
+    delete retired.pdOutputShm;
+    delete retired.managedSharedMemory;
+    retired = {managedSharedMemory, pdInputShm, pdOutputShm, pdInputRegion, pdOutputRegion};
+
+    getSharedMemory();
+    attachedEpoch.store(epoch);
+
+    print_message("[SHM] Ec-Master restarted, re-attached to session " + std::to_string(epoch) + ".",
+                  MessageLevel::WARNING);
+}
+
+uint32_t EcatConfig::getSessionEpoch() const {
+    return attachedEpoch.load();
+}
+
+void EcatConfig::onReattach(std::function<void()> callback) {
+    std::lock_guard<std::mutex> lock(sessionMutex);
+    reattachCallbacks.push_back(std::move(callback));
+}
+
+namespace {
+    //! Longest sleep between two session checks of a waiting thread, a master that died never wakes it
+    const long sessionCheckNs = 100000000L;
+
+    void addNs(struct timespec &ts, long ns) {
+        ts.tv_sec += ns / 1000000000L;
+        ts.tv_nsec += ns % 1000000000L;
+        if (ts.tv_nsec >= 1000000000L) {
+            ts.tv_nsec -= 1000000000L;
+            ts.tv_sec++;
+        }
+    }
+
+    bool before(const struct timespec &a, const struct timespec &b) {
+        return (a.tv_sec < b.tv_sec) || ((a.tv_sec == b.tv_sec) && (a.tv_nsec < b.tv_nsec));
+    }
+}
+
 void EcatConfig::waitForSignal(int id) {
-    sem_wait(sem_mutex[id]);
+    while (true) {
+        struct timespec slice;
+        clock_gettime(CLOCK_REALTIME, &slice);
+        addNs(slice, sessionCheckNs);
+        if (sem_timedwait(sem_mutex[id], &slice) == 0)
+            return;
+        if (errno != ETIMEDOUT)
+            return;
+        /* a restarted master posts other semaphores */
+        if (checkSession())
+            return;
+    }
 }
 
 void EcatConfig::wait() {
+    checkSession();
     auto id = std::this_thread::get_id();
     auto it = std::find(threadId.begin(), threadId.end(), id);
     if(it != threadId.end()) { // thread is already in the list
@@ -91,6 +192,89 @@ void EcatConfig::wait() {
     }
 }
 
+namespace {
+    //! waitFor() state of a thread, per instance
+    struct CycleWaitState {
+        bool started {false};
+        uint32_t lastCycle {0};
+        uint32_t epoch {0};      // session of lastCycle
+        uint64_t missed {0};
+    };
+
+    thread_local std::map<const EcatConfig *, CycleWaitState> cycleWaitStates;
+}
+
+int EcatConfig::waitFor(long timeoutUs) {
+    checkSession();
+    CycleWaitState &st = cycleWaitStates[this];
+    uint32_t cancel = cancelCount.load();
+
+    if (!st.started || (st.epoch != getSessionEpoch())) {
+        /* the first call, and the first after a re-attach, waits for the next cycle */
+        st.lastCycle = ecatBus->notify.cycle.load();
+        st.epoch = getSessionEpoch();
+        st.started = true;
+    }
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    if (timeoutUs >= 0)
+        addNs(deadline, timeoutUs * 1000);
+
+    int result = 0;
+    EcatCycleNotify *notify = &ecatBus->notify;
+    notify->waiters.fetch_add(1);
+    while (true) {
+        uint32_t cycle = notify->cycle.load();
+        if (cycle != st.lastCycle) {
+            result = (int) (cycle - st.lastCycle);
+            st.missed += result - 1;
+            st.lastCycle = cycle;
+            break;
+        }
+        if (cancelCount.load() != cancel) {
+            result = -1;
+            break;
+        }
+
+        /* sleeps only while the word still holds the last cycle, absolute timeout on CLOCK_MONOTONIC,
+         * at most one slice between two session checks */
+        struct timespec until;
+        clock_gettime(CLOCK_MONOTONIC, &until);
+        addNs(until, sessionCheckNs);
+        bool last = (timeoutUs >= 0) && !before(until, deadline);
+        long ret = syscall(SYS_futex, reinterpret_cast<uint32_t *>(&notify->cycle), FUTEX_WAIT_BITSET, cycle,
+                           last ? &deadline : &until, nullptr, FUTEX_BITSET_MATCH_ANY);
+        if ((ret != 0) && (errno == ETIMEDOUT)) {
+            if (last)
+                break;
+            checkSession();
+            if (st.epoch != getSessionEpoch()) {
+                /* wait on the word of the new master */
+                notify->waiters.fetch_sub(1);
+                notify = &ecatBus->notify;
+                notify->waiters.fetch_add(1);
+                st.lastCycle = notify->cycle.load();
+                st.epoch = getSessionEpoch();
+            }
+        }
+    }
+    notify->waiters.fetch_sub(1);
+
+    return result;
+}
+
+uint64_t EcatConfig::getMissedCycles() const {
+    auto it = cycleWaitStates.find(this);
+    return it == cycleWaitStates.end() ? 0 : it->second.missed;
+}
+
+void EcatConfig::cancelWait() {
+    cancelCount.fetch_add(1);
+    /* wakes the waiters of other processes too, they sleep again */
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&ecatBus->notify.cycle), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
 void EcatConfig::init() {
     if (!getSharedMemory()) {
         print_message("[INIT] Can not get shared memory.", MessageLevel::ERROR);
@@ -98,6 +282,8 @@ void EcatConfig::init() {
     }
 
     getPdDataMemoryProvider();
+
+    getSession();
 }
 
 void EcatConfig::print_message(const std::string &msg, EcatConfig::MessageLevel msgLvl) {
@@ -147,6 +333,74 @@ int EcatConfig::getSlaveNum() const {
     return ecatBus->slave_num;
 }
 
+EcatRedundancy EcatConfig::getRedundancy() const {
+    return ecatBus->redundancy;
+}
+
+EcatRxStatistics EcatConfig::getRxStatistics() const {
+    return ecatBus->rx_statistics;
+}
+
+int EcatConfig::getWkc() const {
+    return ecatBus->wkc;
+}
+
+int EcatConfig::getExpectedWkc() const {
+    return ecatBus->expected_wkc;
+}
+
+uint32_t EcatConfig::getWkcErrorCount() const {
+    return ecatBus->wkc_error_count;
+}
+
+int EcatConfig::getSuspectSlave() const {
+    return ecatBus->suspect_slave;
+}
+
+uint32_t EcatConfig::getOverrunCount() const {
+    return ecatBus->overrun_count;
+}
+
+SlaveHealth EcatConfig::getSlaveHealth(int slaveId) const {
+    return ecatBus->slaves[slaveId].health;
+}
+
+SlaveDc EcatConfig::getSlaveDc(int slaveId) const {
+    return ecatBus->slaves[slaveId].dc;
+}
+
+int32_t EcatConfig::getDcMaxDiff() const {
+    return ecatBus->dc_max_diff;
+}
+
+SlaveTopology EcatConfig::getSlaveTopology(int slaveId) const {
+    return ecatBus->slaves[slaveId].topology;
+}
+
+int EcatConfig::getReferenceClock() const {
+    return ecatBus->reference_clock;
+}
+
+bool EcatConfig::isSync0Enabled() const {
+    return ecatBus->sync0_enabled;
+}
+
+int32_t EcatConfig::getSync0Shift() const {
+    return ecatBus->sync0_shift;
+}
+
+void EcatConfig::requestCaptureDump() {
+    ecatBus->capture_request = true;
+}
+
+std::string EcatConfig::getCaptureFile() const {
+    return ecatBus->capture_file;
+}
+
+int EcatConfig::getCaptureDumpCount() const {
+    return ecatBus->capture_dump_count;
+}
+
 std::string EcatConfig::getSlaveName(int slaveId) {
     return ecatBus->slaves[slaveId].name;
 }
@@ -224,6 +478,170 @@ int EcatConfig::getBusCurrentState() const {
     return ecatBus->current_state;
 }
 
+/** Extent of the variables of the slaves firstSlave to lastSlave in the input
+ *  or output image. @return false if they have no variables in it */
+bool EcatConfig::imageRange(bool inputs, int firstSlave, int lastSlave, int &offset, int &size) const {
+    int begin = -1, end = -1;
+
+    if (lastSlave < 0)
+        lastSlave = ecatBus->slave_num - 1;
+    for (int slave = std::max(firstSlave, 0); slave <= lastSlave; ++slave) {
+        const Slave &s = ecatBus->slaves[slave];
+        const PdVar *vars = inputs ? s.input_vars.get() : s.output_vars.get();
+        int varNum = inputs ? s.input_var_num : s.output_var_num;
+        for (int i = 0; i < varNum; ++i) {
+            if ((begin < 0) || (vars[i].offset < begin))
+                begin = vars[i].offset;
+            end = std::max(end, vars[i].offset + vars[i].size);
+        }
+    }
+    offset = begin;
+    size = end - begin;
+
+    return begin >= 0;
+}
+
+int EcatConfig::getInputImageSize(int firstSlave, int lastSlave) const {
+    int offset, size;
+    return imageRange(true, firstSlave, lastSlave, offset, size) ? size : 0;
+}
+
+int EcatConfig::getOutputImageSize(int firstSlave, int lastSlave) const {
+    int offset, size;
+    return imageRange(false, firstSlave, lastSlave, offset, size) ? size : 0;
+}
+
+bool EcatConfig::snapshotInputs(void *buffer, PdStamp *stamp, int firstSlave, int lastSlave) {
+    const int maxTries = 100000; // the master holds the image for one receive at most
+    EcatImageSync &image = ecatBus->image;
+    int offset, size;
+
+    if (!imageRange(true, firstSlave, lastSlave, offset, size))
+        return false;
+    for (int tries = 0; tries < maxTries; ++tries) {
+        uint32_t seq = image.input_seq.load(std::memory_order_acquire);
+        if (seq & 1)
+            continue;
+        memcpy(buffer, (char *) pdInputPtr + offset, size);
+        PdStamp s;
+        s.cycle = image.cycle;
+        s.dc_time = image.dc_time;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (image.input_seq.load(std::memory_order_relaxed) == seq) {
+            if (stamp)
+                *stamp = s;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool EcatConfig::snapshotInputChanges(std::vector<uint64_t> &bits, PdStamp *stamp, uint64_t *baseCycle) {
+    const int maxTries = 100000; // the master holds the image for one receive at most
+    EcatImageSync &image = ecatBus->image;
+    EcatChangeMap &map = ecatBus->input_changes;
+
+    if (map.words == 0)
+        return false;
+    bits.resize(map.words);
+    for (int tries = 0; tries < maxTries; ++tries) {
+        uint32_t seq = image.input_seq.load(std::memory_order_acquire);
+        if (seq & 1)
+            continue;
+        memcpy(bits.data(), map.bits.get(), map.words * sizeof(uint64_t));
+        PdStamp s;
+        s.cycle = image.cycle;
+        s.dc_time = image.dc_time;
+        uint64_t base = map.base_cycle;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (image.input_seq.load(std::memory_order_relaxed) == seq) {
+            if (stamp)
+                *stamp = s;
+            if (baseCycle)
+                *baseCycle = base;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool EcatConfig::isInputChanged(const std::vector<uint64_t> &bits, int slaveId, int varId) const {
+    int bit = slaveId;
+    if (varId >= 0) {
+        if ((varId >= ecatBus->slaves[slaveId].input_var_num) || (ecatBus->slaves[slaveId].input_change_bit < 0))
+            return false;
+        bit = ecatBus->slaves[slaveId].input_change_bit + varId;
+    }
+    if ((bit < 0) || (bit / 64 >= (int) bits.size()))
+        return false;
+
+    return (bits[bit / 64] >> (bit % 64)) & 1;
+}
+
+void EcatConfig::commitOutputs(const void *buffer, int firstSlave, int lastSlave) {
+    EcatImageSync &image = ecatBus->image;
+    int offset, size;
+
+    if (!imageRange(false, firstSlave, lastSlave, offset, size))
+        return;
+    /* one client commits at a time */
+    uint32_t seq = image.output_seq.load(std::memory_order_relaxed);
+    do {
+        while (seq & 1)
+            seq = image.output_seq.load(std::memory_order_relaxed);
+    } while (!image.output_seq.compare_exchange_weak(seq, seq + 1, std::memory_order_acquire));
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy((char *) pdOutputPtr + offset, buffer, size);
+    image.output_seq.store(seq + 2, std::memory_order_release);
+}
+
+/** Check a struct of size bytes and its fields against the variables of one
+ *  direction of a slave. @return offset of the image in the PD memory, -1 if they differ */
+int EcatConfig::checkBinding(const PdVar *vars, int varNum, size_t size, const std::vector<PdField> &fields) {
+    if (varNum <= 0) {
+        print_message("[BIND] Slave has no process data in this direction.", MessageLevel::ERROR);
+        return -1;
+    }
+
+    /* the image of the slave starts at its first variable */
+    int base = vars[0].offset;
+    int end = base;
+    for (int i = 0; i < varNum; ++i)
+        end = std::max(end, vars[i].offset + vars[i].size);
+    if (size != (size_t) (end - base)) {
+        print_message(str(boost::format("[BIND] Struct has %1% bytes, process data of the slave %2% bytes.") % size %
+                          (end - base)), MessageLevel::ERROR);
+        return -1;
+    }
+
+    for (size_t k = 0; k < fields.size(); ++k) {
+        const PdVar *var = nullptr;
+        if (fields[k].name) {
+            for (int i = 0; (i < varNum) && !var; ++i) {
+                if (strcmp(vars[i].name, fields[k].name) == 0)
+                    var = &vars[i];
+            }
+        } else if (k < (size_t) varNum) {
+            var = &vars[k];
+        }
+        if (!var) {
+            print_message(str(boost::format("[BIND] Field %1% (%2%) has no variable.") % k %
+                              (fields[k].name ? fields[k].name : "")), MessageLevel::ERROR);
+            return -1;
+        }
+        if ((fields[k].offset != (size_t) (var->offset - base)) || (fields[k].size != (size_t) var->size)) {
+            print_message(str(boost::format("[BIND] Field %1% at %2% with %3% bytes, variable %4% at %5% with %6% bytes.") %
+                              k % fields[k].offset % fields[k].size % var->name % (var->offset - base) % var->size),
+                          MessageLevel::ERROR);
+            return -1;
+        }
+    }
+
+    return base;
+}
+
 EcatConfig *EcatConfig::getInstance(int id) {
     if(instances.find(id) == instances.end()) {
         std::cout << "Create New Ecat Config Instance: " << id << std::endl;
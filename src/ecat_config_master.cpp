@@ -4,6 +4,10 @@
 
 #include <ecat_config_master.h>
 
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
 
 using namespace rocos;
 
@@ -12,6 +16,7 @@ EcatConfigMaster::EcatConfigMaster(int id) {
     mutexName = EC_SEM_MUTEX + std::to_string(id) + "_";
     pdInputName = "pd_input" + std::to_string(id);
     pdOutputName = "pd_output" + std::to_string(id);
+    sessionName = EC_SHM_SESSION + std::to_string(id);
 
 }
 
@@ -30,6 +35,13 @@ bool EcatConfigMaster::createSharedMemory() {
 
     ecatBus = managedSharedMemory->find_or_construct<EcatBus>("ecat")();
 
+    /* the session is not removed, its epoch counts on over restarts */
+    sessionShm = new shared_memory_object(open_or_create, sessionName.c_str(), read_write);
+    offset_t sessionSize = 0;
+    if (!sessionShm->get_size(sessionSize) || (sessionSize < (offset_t) sizeof(EcatSession)))
+        sessionShm->truncate(sizeof(EcatSession));
+    sessionRegion = new mapped_region(*sessionShm, read_write);
+    session = static_cast<EcatSession *>(sessionRegion->get_address());
 
 
     //////////////////// Semaphore //////////////////////////
@@ -185,6 +197,43 @@ bool EcatConfigMaster::getPdDataMemoryProvider() {
     return true;
 }
 
+bool EcatConfigMaster::createSlaveTable(int slaveNum) {
+    using namespace boost::interprocess;
+
+    ecatBus->slaves = managedSharedMemory->construct<Slave>(anonymous_instance)[slaveNum]();
+
+    return ecatBus->slaves != nullptr;
+}
+
+PdVar *EcatConfigMaster::createPdVarTable(int varNum) {
+    using namespace boost::interprocess;
+
+    return managedSharedMemory->construct<PdVar>(anonymous_instance)[varNum]();
+}
+
+uint64_t *EcatConfigMaster::createChangeMap(int words) {
+    using namespace boost::interprocess;
+
+    return managedSharedMemory->construct<uint64_t>(anonymous_instance)[words](0);
+}
+
+void EcatConfigMaster::notifyCycle() {
+    ecatBus->notify.cycle.fetch_add(1);
+    /* no system call while no client waits */
+    if (ecatBus->notify.waiters.load() > 0)
+        syscall(SYS_futex, reinterpret_cast<uint32_t *>(&ecatBus->notify.cycle), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+void EcatConfigMaster::publishSession() {
+    if (session == nullptr)
+        return;
+    uint32_t epoch = session->epoch.load() + 1;
+    if (epoch == 0)
+        epoch = 1; // 0 is no session
+    ecatBus->session_epoch = epoch;
+    session->epoch.store(epoch);
+}
+
 void EcatConfigMaster::updateSempahore() {
     ////============== semphore update by think =================////
     // 通知其他进程可以更新这个周期的数据了 by think
@@ -0,0 +1,129 @@
+//
+// Created by think on 3/31/24.
+//
+
+#include "ecat_context.h"
+
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <sys/stat.h>
+
+namespace {
+    /** Header of an SII image file. The image is stored as it is in memory, so
+     *  a file of a build with another EEPROM buffer size is not loaded. */
+    struct SiiFileHeader {
+        char magic[4];
+        uint32 version;
+        uint32 size;
+    };
+
+    const char siiMagic[4] = {'R', 'S', 'I', 'I'};
+    const uint32 siiVersion = 1;
+}
+
+EcatContext::EcatContext() {
+    memset(&port, 0, sizeof(port));
+    memset(&redport, 0, sizeof(redport));
+    memset(slavelist, 0, sizeof(slavelist));
+    slavecount = 0;
+    memset(grouplist, 0, sizeof(grouplist));
+    memset(esibuf, 0, sizeof(esibuf));
+    memset(esimap, 0, sizeof(esimap));
+    memset(&elist, 0, sizeof(elist));
+    memset(&idxstack, 0, sizeof(idxstack));
+    ecaterror = FALSE;
+    DCtime = 0;
+    memset(SMcommtype, 0, sizeof(SMcommtype));
+    memset(PDOassign, 0, sizeof(PDOassign));
+    memset(PDOdesc, 0, sizeof(PDOdesc));
+    memset(&eepSM, 0, sizeof(eepSM));
+    memset(&eepFMMU, 0, sizeof(eepFMMU));
+    memset(&siicache, 0, sizeof(siicache));
+
+    memset(&context, 0, sizeof(context));
+    context.port = &port;
+    context.slavelist = &slavelist[0];
+    context.slavecount = &slavecount;
+    context.maxslave = EC_MAXSLAVE;
+    context.grouplist = &grouplist[0];
+    context.maxgroup = EC_MAXGROUP;
+    context.esibuf = &esibuf[0];
+    context.esimap = &esimap[0];
+    context.esislave = 0;
+    context.elist = &elist;
+    context.idxstack = &idxstack;
+    context.ecaterror = &ecaterror;
+    context.DCtime = &DCtime;
+    context.SMcommtype = &SMcommtype[0];
+    context.PDOassign = &PDOassign[0];
+    context.PDOdesc = &PDOdesc[0];
+    context.eepSM = &eepSM;
+    context.eepFMMU = &eepFMMU;
+    context.FOEhook = nullptr;
+    context.EOEhook = nullptr;
+    context.manualstatechange = 0;
+    context.siicache = &siicache;
+}
+
+int EcatContext::loadSiiCache(const std::string &dir) {
+    DIR *d = opendir(dir.c_str());
+    if (!d)
+        return 0;
+
+    struct dirent *entry;
+    while ((entry = readdir(d)) != nullptr && siicache.nimages < EC_MAXSIICACHE) {
+        if (strncmp(entry->d_name, "sii_", 4) != 0)
+            continue;
+        std::string fileName = dir + "/" + entry->d_name;
+        FILE *f = fopen(fileName.c_str(), "rb");
+        if (!f)
+            continue;
+        SiiFileHeader header;
+        ec_siiimaget &img = siicache.image[siicache.nimages];
+        if ((fread(&header, sizeof(header), 1, f) == 1) && (memcmp(header.magic, siiMagic, sizeof(siiMagic)) == 0) &&
+            (header.version == siiVersion) && (header.size == sizeof(ec_siiimaget)) &&
+            (fread(&img, sizeof(img), 1, f) == 1)) {
+            img.dirty = FALSE;
+            img.used = FALSE;
+            siicache.nimages++;
+        }
+        fclose(f);
+    }
+    closedir(d);
+
+    return siicache.nimages;
+}
+
+int EcatContext::saveSiiCache(const std::string &dir) {
+    int saved = 0;
+
+    mkdir(dir.c_str(), 0755);
+    for (int i = 0; i < siicache.nimages; i++) {
+        ec_siiimaget &img = siicache.image[i];
+        if (!img.dirty || !img.used)
+            continue;
+        char name[64];
+        snprintf(name, sizeof(name), "/sii_%08x_%08x_%08x.bin", img.man, img.id, img.rev);
+        std::string fileName = dir + name;
+        std::string tmpName = fileName + ".tmp";
+        FILE *f = fopen(tmpName.c_str(), "wb");
+        if (!f)
+            return -1;
+        SiiFileHeader header;
+        memcpy(header.magic, siiMagic, sizeof(siiMagic));
+        header.version = siiVersion;
+        header.size = sizeof(ec_siiimaget);
+        bool ok = (fwrite(&header, sizeof(header), 1, f) == 1) && (fwrite(&img, sizeof(img), 1, f) == 1);
+        ok = (fclose(f) == 0) && ok;
+        /* replace the old file only with a complete one */
+        if (!ok || (rename(tmpName.c_str(), fileName.c_str()) != 0)) {
+            remove(tmpName.c_str());
+            return -1;
+        }
+        img.dirty = FALSE;
+        saved++;
+    }
+
+    return saved;
+}
@@ -0,0 +1,68 @@
+/*
+Copyright 2021, Yang Luo"
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+@Author
+Yang Luo, PHD
+@email: yluo@hit.edu.cn
+
+@Created on: 2024.03.31
+@Last Modified: 2024.03.31
+*/
+
+#ifndef ROCOS_SOEM_ECAT_CONTEXT_H
+#define ROCOS_SOEM_ECAT_CONTEXT_H
+
+#include "ethercat.h"
+
+#include <string>
+
+/** Storage of one SOEM master context. The legacy ec_* API keeps all of this
+ * in globals, so a process using it can drive only one segment. Every
+ * EcatContext has its own port, slave list and groups and is used with the
+ * ecx_* API through context. It is large, allocate it on the heap.
+ */
+struct EcatContext {
+    EcatContext();
+
+    EcatContext(const EcatContext &) = delete;
+    EcatContext &operator=(const EcatContext &) = delete;
+
+    ecx_portt port;
+    ecx_redportt redport;
+    ec_slavet slavelist[EC_MAXSLAVE];
+    int slavecount;
+    ec_groupt grouplist[EC_MAXGROUP];
+    uint8 esibuf[EC_MAXEEPBUF];
+    uint32 esimap[EC_MAXEEPBITMAP];
+    ec_eringt elist;
+    ec_idxstackT idxstack;
+    boolean ecaterror;
+    int64 DCtime;
+    ec_SMcommtypet SMcommtype[EC_MAX_MAPT];
+    ec_PDOassignt PDOassign[EC_MAX_MAPT];
+    ec_PDOdesct PDOdesc[EC_MAX_MAPT];
+    ec_eepromSMt eepSM;
+    ec_eepromFMMUt eepFMMU;
+    ec_siicachet siicache;
+
+    ecx_contextt context;
+
+    /** Load the SII images saved in dir, before the slaves are configured. @return number of images loaded */
+    int loadSiiCache(const std::string &dir);
+    /** Save the SII images that were read or changed since loading. @return number of images saved, -1 on error */
+    int saveSiiCache(const std::string &dir);
+};
+
+#endif //ROCOS_SOEM_ECAT_CONTEXT_H
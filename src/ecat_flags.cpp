@@ -25,6 +25,42 @@ DEFINE_bool(perf, true, "Enable max. and average time measurement in μs for all
 //! @brief DC mode
 DEFINE_int32(dcmmode, 1, "Set DCM mode. 0 = off, 1 = busshift, 2 = mastershift, 3 = linklayerrefclock, 4 = masterrefclock, 5 = dcx");
 
-DEFINE_string(instance, "enp6s0", "Device instance 1=first, 2=second. The device instance specifies which network card is used by the demo application. The default is the first network card. ");
+DEFINE_string(instance, "enp6s0", "Network interfaces used by the master, comma separated, one EtherCAT segment each, f.e. enp6s0,enp7s0. Segment k uses the shared memory of id + k. An optional link prefix selects the frame transport: raw: (default), mmap: (packet rings), tap: (tap device), mem:<channel> (in-process simulator), pcap:<file> (replay of a capture). A veth pair is used with raw:<veth>. ");
+//! @brief Secondary network interface for cable redundancy
+DEFINE_string(instance2, "", "Secondary network interfaces for cable redundancy, comma separated in the order of --instance, empty for single port operation. ");
+//! @brief Capture ring size
+DEFINE_int32(capture, 2048, "Number of recent EtherCAT frames kept in the capture ring, 0 = off. The ring is written to a pcapng file on SIGUSR1 or on request over shared memory. ");
+//! @brief Capture dump directory
+DEFINE_string(capture_dir, "/tmp", "Directory for pcapng files written from the capture ring. ");
+//! @brief Direct receive of inputs into shared memory
+DEFINE_bool(direct_rx, true, "Copy received inputs straight from the frame into the shared memory image instead of through the IOmap. Only frames with the expected work counter reach the image. Used when all inputs of a segment are in one frame. ");
+//! @brief Realtime CPUs
+DEFINE_string(rt_cpus, "0", "CPUs of the realtime threads, comma separated. Segments are distributed round robin over one thread per CPU. ");
+//! @brief Phase stagger of segments
+DEFINE_bool(stagger, true, "Spread the process data exchange of the segments evenly over the cycle instead of starting all at the cycle start. ");
+//! @brief SII cache directory
+DEFINE_string(sii_cache_dir, "/var/cache/rocos_soem", "Directory of the SII EEPROM images of the slave types, read once per vendor, product and revision. Empty disables the disk cache. ");
+//! @brief PDO layout cache directory
+DEFINE_string(pdo_cache_dir, "/var/cache/rocos_soem", "Directory of the process data variables of the slaves, keyed by identity and configured mapping, so a warm start skips the PDO discovery. Empty disables the cache. ");
+//! @brief Mapping threads
+DEFINE_int32(map_threads, 8, "Slaves whose PDO mapping is read over the mailbox at the same time at startup, 1 reads them one after another. ");
+//! @brief Slave diagnosis on low work counter
+DEFINE_bool(diagnosis, true, "Read AL status and ESC error counters of the slaves when the work counter is low, results are published in shared memory. ");
+//! @brief AL status in the cyclic frames
+DEFINE_int32(status_decimation, 10, "Every n cycles the cyclic frame carries the AL status of the next slaves, so the slave supervision needs no frames of its own. 0 reads the AL status with separate frames. ");
+//! @brief DC time difference monitor
+DEFINE_int32(dc_monitor, 100, "Every n cycles the cyclic frame carries the system time difference (0x092C) of the next DC slaves, statistics per slave are published in shared memory. 0 = off. ");
+//! @brief Static drift compensation
+DEFINE_int32(dc_drift, 0, "FRMW datagrams of the static DC drift compensation before OP, 15000 as recommended by ETG.1000. 0 = off. ");
+//! @brief Sync0 of the DC slaves
+DEFINE_bool(sync0, false, "Activate Sync0 on the DC slaves with a calibrated shift, the realtime loop follows the DC reference clock. ");
+//! @brief Sync0 calibration cycles
+DEFINE_int32(sync0_cycles, 2000, "Cycles measured in SAFE_OP to calibrate the Sync0 shift, when no calibration of the topology and cycle time is stored. ");
+//! @brief Sync0 safety margin
+DEFINE_int32(sync0_margin, 20, "Safety margin in us between Sync0 and the frames of the calibration. ");
+//! @brief Sync0 calibration cache
+DEFINE_string(sync0_cache_dir, "/var/cache/rocos_soem", "Directory of the calibrated Sync0 shifts, keyed by cycle time, margin and topology. Empty calibrates at every start. ");
+//! @brief Input change map
+DEFINE_bool(input_changes, true, "Publish with every input image which slaves and input variables changed since the previous image, so clients need not compare the image themselves. ");
 
 DEFINE_string(state, "op", "The request state of EtherCAT slaves. value can be init/preop/safeop/op The default is op. ");
\ No newline at end of file
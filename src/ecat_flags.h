@@ -37,6 +37,42 @@ DECLARE_int32(cpuidx);
 DECLARE_bool(perf);
 //! @brief Intel network card instances and mode
 DECLARE_string(instance);
+//! @brief Secondary network interface for cable redundancy
+DECLARE_string(instance2);
+//! @brief Capture ring size
+DECLARE_int32(capture);
+//! @brief Capture dump directory
+DECLARE_string(capture_dir);
+//! @brief Direct receive of inputs into shared memory
+DECLARE_bool(direct_rx);
+//! @brief Realtime CPUs
+DECLARE_string(rt_cpus);
+//! @brief Phase stagger of segments
+DECLARE_bool(stagger);
+//! @brief SII cache directory
+DECLARE_string(sii_cache_dir);
+//! @brief PDO layout cache directory
+DECLARE_string(pdo_cache_dir);
+//! @brief Mapping threads
+DECLARE_int32(map_threads);
+//! @brief Slave diagnosis on low work counter
+DECLARE_bool(diagnosis);
+//! @brief AL status in the cyclic frames
+DECLARE_int32(status_decimation);
+//! @brief DC time difference monitor
+DECLARE_int32(dc_monitor);
+//! @brief Static drift compensation
+DECLARE_int32(dc_drift);
+//! @brief Sync0 of the DC slaves
+DECLARE_bool(sync0);
+//! @brief Sync0 calibration cycles
+DECLARE_int32(sync0_cycles);
+//! @brief Sync0 safety margin
+DECLARE_int32(sync0_margin);
+//! @brief Sync0 calibration cache
+DECLARE_string(sync0_cache_dir);
+//! @brief Input change map
+DECLARE_bool(input_changes);
 //! @brief DC mode
 DECLARE_int32(dcmmode);
 //! @brief The request state of EtherCAT slaves
@@ -0,0 +1,105 @@
+//
+// Created by think on 3/31/24.
+//
+
+#include "ecat_pdo_cache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+
+namespace {
+    /** Header of a layout file, followed by the key and the variables. */
+    struct PdoFileHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t varSize;
+        uint32_t keyLength;
+        uint32_t outputs;
+        uint32_t inputs;
+    };
+
+    const char pdoMagic[4] = {'R', 'P', 'D', 'O'};
+    const uint32_t pdoVersion = 1;
+}
+
+std::string EcatPdoCache::fileName(const std::vector<uint32_t> &key) const {
+    /* FNV-1a of the mapping part of the key, the identity is in clear */
+    uint32_t hash = 2166136261u;
+    for (size_t i = 3; i < key.size(); i++) {
+        for (int b = 0; b < 4; b++) {
+            hash ^= (key[i] >> (8 * b)) & 0xff;
+            hash *= 16777619u;
+        }
+    }
+    char name[64];
+    snprintf(name, sizeof(name), "/pdo_%08x_%08x_%08x_%08x.bin", key[0], key[1], key[2], hash);
+
+    return cacheDir + name;
+}
+
+bool EcatPdoCache::load(const std::vector<uint32_t> &key, std::vector<rocos::PdVar> &outputs,
+                        std::vector<rocos::PdVar> &inputs) const {
+    if (key.size() < 3)
+        return false;
+    FILE *f = fopen(fileName(key).c_str(), "rb");
+    if (!f)
+        return false;
+
+    PdoFileHeader header;
+    std::vector<uint32_t> fileKey;
+    bool ok = (fread(&header, sizeof(header), 1, f) == 1) && (memcmp(header.magic, pdoMagic, sizeof(pdoMagic)) == 0) &&
+              (header.version == pdoVersion) && (header.varSize == sizeof(rocos::PdVar)) &&
+              (header.keyLength == key.size());
+    if (ok) {
+        fileKey.resize(header.keyLength);
+        /* the hash in the file name may collide, compare the full key */
+        ok = (fread(fileKey.data(), sizeof(uint32_t), fileKey.size(), f) == fileKey.size()) && (fileKey == key);
+    }
+    if (ok) {
+        outputs.resize(header.outputs);
+        inputs.resize(header.inputs);
+        ok = (fread(outputs.data(), sizeof(rocos::PdVar), outputs.size(), f) == outputs.size()) &&
+             (fread(inputs.data(), sizeof(rocos::PdVar), inputs.size(), f) == inputs.size());
+    }
+    fclose(f);
+    if (!ok) {
+        outputs.clear();
+        inputs.clear();
+    }
+
+    return ok;
+}
+
+bool EcatPdoCache::save(const std::vector<uint32_t> &key, const std::vector<rocos::PdVar> &outputs,
+                        const std::vector<rocos::PdVar> &inputs) const {
+    if (key.size() < 3)
+        return false;
+    mkdir(cacheDir.c_str(), 0755);
+
+    string name = fileName(key);
+    string tmpName = name + ".tmp";
+    FILE *f = fopen(tmpName.c_str(), "wb");
+    if (!f)
+        return false;
+
+    PdoFileHeader header;
+    memcpy(header.magic, pdoMagic, sizeof(pdoMagic));
+    header.version = pdoVersion;
+    header.varSize = sizeof(rocos::PdVar);
+    header.keyLength = key.size();
+    header.outputs = outputs.size();
+    header.inputs = inputs.size();
+    bool ok = (fwrite(&header, sizeof(header), 1, f) == 1) &&
+              (fwrite(key.data(), sizeof(uint32_t), key.size(), f) == key.size()) &&
+              (fwrite(outputs.data(), sizeof(rocos::PdVar), outputs.size(), f) == outputs.size()) &&
+              (fwrite(inputs.data(), sizeof(rocos::PdVar), inputs.size(), f) == inputs.size());
+    ok = (fclose(f) == 0) && ok;
+    /* replace the old file only with a complete one */
+    if (!ok || (rename(tmpName.c_str(), name.c_str()) != 0)) {
+        remove(tmpName.c_str());
+        return false;
+    }
+
+    return true;
+}
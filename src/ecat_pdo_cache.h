@@ -0,0 +1,59 @@
+/*
+Copyright 2021, Yang Luo"
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+@Author
+Yang Luo, PHD
+@email: yluo@hit.edu.cn
+
+@Created on: 2024.03.31
+@Last Modified: 2024.03.31
+*/
+
+#ifndef ROCOS_SOEM_ECAT_PDO_CACHE_H
+#define ROCOS_SOEM_ECAT_PDO_CACHE_H
+
+#include <ecat_type.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/** On disk cache of the process data variables of a slave, so a warm start
+ * does not walk the PDO mapping and the object dictionary over the mailbox.
+ * A layout is keyed by the slave identity and its configured mapping: vendor,
+ * product, revision, mapped bit sizes, SyncManager types and assigned PDOs.
+ * Offsets are stored relative to the slave.
+ */
+class EcatPdoCache {
+    using string = std::string;
+public:
+    explicit EcatPdoCache(const string &dir) : cacheDir(dir) {}
+
+    /** Find the layout of key. @return true if found, outputs and inputs are filled */
+    bool load(const std::vector<uint32_t> &key, std::vector<rocos::PdVar> &outputs,
+              std::vector<rocos::PdVar> &inputs) const;
+
+    /** Store the layout of key. @return true if written */
+    bool save(const std::vector<uint32_t> &key, const std::vector<rocos::PdVar> &outputs,
+              const std::vector<rocos::PdVar> &inputs) const;
+
+private:
+    string fileName(const std::vector<uint32_t> &key) const;
+
+    string cacheDir;
+};
+
+
+#endif //ROCOS_SOEM_ECAT_PDO_CACHE_H
@@ -5,14 +5,19 @@
 #include "ecat_process.h"
 #include <cstdio>
 #include <cstring>
+#include <cstdlib>
 #include <cinttypes>
 
 EcatProcess::EcatProcess() {
-
+    ec = new EcatContext();
+    sdoReader = new EcatSdoReader(&ec->context);
 }
 
 EcatProcess::~EcatProcess() {
-    ec_close(); //析构函数中关闭ecat
+    ecx_close(&ec->context); //析构函数中关闭ecat
+    free(IOmap);
+    delete sdoReader;
+    delete ec;
 }
 
 void EcatProcess::getSlaveInfo(EcatProcess::string ifname, bool printSDO, bool printMAP) {
@@ -24,97 +29,102 @@ void EcatProcess::getSlaveInfo(EcatProcess::string ifname, bool printSDO, bool p
     printf("Starting slaveinfo\n");
 
     /* initialise SOEM, bind socket to ifname */
-    if (ec_init(ifname.c_str())) {
+    if (ecx_init(&ec->context, ifname.c_str())) {
         printf("ec_init on %s succeeded.\n", ifname.c_str());
         /* find and auto-config slaves */
-        if (ec_config(FALSE, &IOmap) > 0) {
-            ec_configdc();
-            while (EcatError) printf("%s", ec_elist2string());
-            printf("%d slaves found and configured.\n", ec_slavecount);
-            expectedWKC = (ec_group[0].outputsWKC * 2) + ec_group[0].inputsWKC;
+        if (ecx_config_init(&ec->context, FALSE) > 0) {
+            free(IOmap);
+            IOmap = static_cast<uint8 *>(ecx_config_map_group_alloc(&ec->context, 0, FALSE, &IOmapSize));
+            ecx_configdc(&ec->context);
+            while (ec->ecaterror) printf("%s", ecx_elist2string(&ec->context));
+            printf("%d slaves found and configured.\n", ec->slavecount);
+            expectedWKC = (ec->grouplist[0].outputsWKC * 2) + ec->grouplist[0].inputsWKC;
             printf("Calculated workcounter %d\n", expectedWKC);
             /* wait for all slaves to reach SAFE_OP state */
-            ec_statecheck(0, EC_STATE_SAFE_OP, EC_TIMEOUTSTATE * 3);
-            if (ec_slave[0].state != EC_STATE_SAFE_OP) {
+            ecx_statecheck(&ec->context, 0, EC_STATE_SAFE_OP, EC_TIMEOUTSTATE * 3);
+            if (ec->slavelist[0].state != EC_STATE_SAFE_OP) {
                 printf("Not all slaves reached safe operational state.\n");
-                ec_readstate();
-                for (i = 1; i <= ec_slavecount; i++) {
-                    if (ec_slave[i].state != EC_STATE_SAFE_OP) {
+                ecx_readstate(&ec->context);
+                for (i = 1; i <= ec->slavecount; i++) {
+                    if (ec->slavelist[i].state != EC_STATE_SAFE_OP) {
                         printf("Slave %d State=%2x StatusCode=%4x : %s\n",
-                               i, ec_slave[i].state, ec_slave[i].ALstatuscode,
-                               ec_ALstatuscode2string(ec_slave[i].ALstatuscode));
+                               i, ec->slavelist[i].state, ec->slavelist[i].ALstatuscode,
+                               ec_ALstatuscode2string(ec->slavelist[i].ALstatuscode));
                     }
                 }
             }
 
 
-            ec_readstate();
-            for (cnt = 1; cnt <= ec_slavecount; cnt++) {
+            ecx_readstate(&ec->context);
+            for (cnt = 1; cnt <= ec->slavecount; cnt++) {
                 printf("\nSlave:%d\n Name:%s\n Output size: %dbits\n Input size: %dbits\n State: %d\n Delay: %d[ns]\n Has DC: %d\n",
-                       cnt, ec_slave[cnt].name, ec_slave[cnt].Obits, ec_slave[cnt].Ibits,
-                       ec_slave[cnt].state, ec_slave[cnt].pdelay, ec_slave[cnt].hasdc);
-                if (ec_slave[cnt].hasdc) printf(" DCParentport:%d\n", ec_slave[cnt].parentport);
-                printf(" Activeports:%d.%d.%d.%d\n", (ec_slave[cnt].activeports & 0x01) > 0,
-                       (ec_slave[cnt].activeports & 0x02) > 0,
-                       (ec_slave[cnt].activeports & 0x04) > 0,
-                       (ec_slave[cnt].activeports & 0x08) > 0);
-                printf(" Configured address: %4.4x\n", ec_slave[cnt].configadr);
-                printf(" Man: %8.8x ID: %8.8x Rev: %8.8x\n", (int) ec_slave[cnt].eep_man, (int) ec_slave[cnt].eep_id,
-                       (int) ec_slave[cnt].eep_rev);
+                       cnt, ec->slavelist[cnt].name, ec->slavelist[cnt].Obits, ec->slavelist[cnt].Ibits,
+                       ec->slavelist[cnt].state, ec->slavelist[cnt].pdelay, ec->slavelist[cnt].hasdc);
+                if (ec->slavelist[cnt].hasdc) printf(" DCParentport:%d\n", ec->slavelist[cnt].parentport);
+                printf(" Activeports:%d.%d.%d.%d\n", (ec->slavelist[cnt].activeports & 0x01) > 0,
+                       (ec->slavelist[cnt].activeports & 0x02) > 0,
+                       (ec->slavelist[cnt].activeports & 0x04) > 0,
+                       (ec->slavelist[cnt].activeports & 0x08) > 0);
+                printf(" Configured address: %4.4x\n", ec->slavelist[cnt].configadr);
+                printf(" Man: %8.8x ID: %8.8x Rev: %8.8x\n", (int) ec->slavelist[cnt].eep_man, (int) ec->slavelist[cnt].eep_id,
+                       (int) ec->slavelist[cnt].eep_rev);
                 for (nSM = 0; nSM < EC_MAXSM; nSM++) {
-                    if (ec_slave[cnt].SM[nSM].StartAddr > 0)
-                        printf(" SM%1d A:%4.4x L:%4d F:%8.8x Type:%d\n", nSM, etohs(ec_slave[cnt].SM[nSM].StartAddr),
-                               etohs(ec_slave[cnt].SM[nSM].SMlength),
-                               etohl(ec_slave[cnt].SM[nSM].SMflags), ec_slave[cnt].SMtype[nSM]);
+                    if (ec->slavelist[cnt].SM[nSM].StartAddr > 0)
+                        printf(" SM%1d A:%4.4x L:%4d F:%8.8x Type:%d\n", nSM, etohs(ec->slavelist[cnt].SM[nSM].StartAddr),
+                               etohs(ec->slavelist[cnt].SM[nSM].SMlength),
+                               etohl(ec->slavelist[cnt].SM[nSM].SMflags), ec->slavelist[cnt].SMtype[nSM]);
                 }
-                for (j = 0; j < ec_slave[cnt].FMMUunused; j++) {
+                for (j = 0; j < ec->slavelist[cnt].FMMUunused; j++) {
                     printf(" FMMU%1d Ls:%8.8x Ll:%4d Lsb:%d Leb:%d Ps:%4.4x Psb:%d Ty:%2.2x Act:%2.2x\n", j,
-                           etohl(ec_slave[cnt].FMMU[j].LogStart), etohs(ec_slave[cnt].FMMU[j].LogLength),
-                           ec_slave[cnt].FMMU[j].LogStartbit,
-                           ec_slave[cnt].FMMU[j].LogEndbit, etohs(ec_slave[cnt].FMMU[j].PhysStart),
-                           ec_slave[cnt].FMMU[j].PhysStartBit,
-                           ec_slave[cnt].FMMU[j].FMMUtype, ec_slave[cnt].FMMU[j].FMMUactive);
+                           etohl(ec->slavelist[cnt].FMMU[j].LogStart), etohs(ec->slavelist[cnt].FMMU[j].LogLength),
+                           ec->slavelist[cnt].FMMU[j].LogStartbit,
+                           ec->slavelist[cnt].FMMU[j].LogEndbit, etohs(ec->slavelist[cnt].FMMU[j].PhysStart),
+                           ec->slavelist[cnt].FMMU[j].PhysStartBit,
+                           ec->slavelist[cnt].FMMU[j].FMMUtype, ec->slavelist[cnt].FMMU[j].FMMUactive);
                 }
                 printf(" FMMUfunc 0:%d 1:%d 2:%d 3:%d\n",
-                       ec_slave[cnt].FMMU0func, ec_slave[cnt].FMMU1func, ec_slave[cnt].FMMU2func,
-                       ec_slave[cnt].FMMU3func);
-                printf(" MBX length wr: %d rd: %d MBX protocols : %2.2x\n", ec_slave[cnt].mbx_l, ec_slave[cnt].mbx_rl,
-                       ec_slave[cnt].mbx_proto);
-                ssigen = ec_siifind(cnt, ECT_SII_GENERAL);
+                       ec->slavelist[cnt].FMMU0func, ec->slavelist[cnt].FMMU1func, ec->slavelist[cnt].FMMU2func,
+                       ec->slavelist[cnt].FMMU3func);
+                printf(" MBX length wr: %d rd: %d MBX protocols : %2.2x\n", ec->slavelist[cnt].mbx_l, ec->slavelist[cnt].mbx_rl,
+                       ec->slavelist[cnt].mbx_proto);
+                ssigen = ecx_siifind(&ec->context, cnt, ECT_SII_GENERAL);
                 /* SII general section */
                 if (ssigen) {
-                    ec_slave[cnt].CoEdetails = ec_siigetbyte(cnt, ssigen + 0x07);
-                    ec_slave[cnt].FoEdetails = ec_siigetbyte(cnt, ssigen + 0x08);
-                    ec_slave[cnt].EoEdetails = ec_siigetbyte(cnt, ssigen + 0x09);
-                    ec_slave[cnt].SoEdetails = ec_siigetbyte(cnt, ssigen + 0x0a);
-                    if ((ec_siigetbyte(cnt, ssigen + 0x0d) & 0x02) > 0) {
-                        ec_slave[cnt].blockLRW = 1;
-                        ec_slave[0].blockLRW++;
+                    ec->slavelist[cnt].CoEdetails = ecx_siigetbyte(&ec->context, cnt, ssigen + 0x07);
+                    ec->slavelist[cnt].FoEdetails = ecx_siigetbyte(&ec->context, cnt, ssigen + 0x08);
+                    ec->slavelist[cnt].EoEdetails = ecx_siigetbyte(&ec->context, cnt, ssigen + 0x09);
+                    ec->slavelist[cnt].SoEdetails = ecx_siigetbyte(&ec->context, cnt, ssigen + 0x0a);
+                    if ((ecx_siigetbyte(&ec->context, cnt, ssigen + 0x0d) & 0x02) > 0) {
+                        ec->slavelist[cnt].blockLRW = 1;
+                        ec->slavelist[0].blockLRW++;
                     }
-                    ec_slave[cnt].Ebuscurrent = ec_siigetbyte(cnt, ssigen + 0x0e);
-                    ec_slave[cnt].Ebuscurrent += ec_siigetbyte(cnt, ssigen + 0x0f) << 8;
-                    ec_slave[0].Ebuscurrent += ec_slave[cnt].Ebuscurrent;
+                    ec->slavelist[cnt].Ebuscurrent = ecx_siigetbyte(&ec->context, cnt, ssigen + 0x0e);
+                    ec->slavelist[cnt].Ebuscurrent += ecx_siigetbyte(&ec->context, cnt, ssigen + 0x0f) << 8;
+                    ec->slavelist[0].Ebuscurrent += ec->slavelist[cnt].Ebuscurrent;
                 }
                 printf(" CoE details: %2.2x FoE details: %2.2x EoE details: %2.2x SoE details: %2.2x\n",
-                       ec_slave[cnt].CoEdetails, ec_slave[cnt].FoEdetails, ec_slave[cnt].EoEdetails,
-                       ec_slave[cnt].SoEdetails);
+                       ec->slavelist[cnt].CoEdetails, ec->slavelist[cnt].FoEdetails, ec->slavelist[cnt].EoEdetails,
+                       ec->slavelist[cnt].SoEdetails);
                 printf(" Ebus current: %d[mA]\n only LRD/LWR:%d\n",
-                       ec_slave[cnt].Ebuscurrent, ec_slave[cnt].blockLRW);
-                if ((ec_slave[cnt].mbx_proto & ECT_MBXPROT_COE) && printSDO)
+                       ec->slavelist[cnt].Ebuscurrent, ec->slavelist[cnt].blockLRW);
+                if ((ec->slavelist[cnt].mbx_proto & ECT_MBXPROT_COE) && printSDO)
                     si_sdo(cnt);
                 if (printMAP) {
-                    if (ec_slave[cnt].mbx_proto & ECT_MBXPROT_COE)
+                    if (ec->slavelist[cnt].mbx_proto & ECT_MBXPROT_COE)
                         si_map_sdo(cnt);
                     else
                         si_map_sii(cnt);
                 }
             }
+            if (printMAP)
+                printf("CoE complete access: %d SDO transfers, %d round trips saved, %d slaves fell back\n",
+                       sdoReader->transfers(), sdoReader->saved(), sdoReader->fallbacks());
         } else {
             printf("No slaves found!\n");
         }
         printf("End slaveinfo, close socket\n");
         /* stop SOEM, close socket */
-        ec_close();
+        ecx_close(&ec->context);
     } else {
         printf("No socket connection on %s\nExcecute as root\n", ifname.c_str());
     }
@@ -216,9 +226,9 @@ EcatProcess::string EcatProcess::SDO2string(uint16 slave, uint16 index, uint8 su
     char es[32];
 
     memset(&usdo, 0, 128);
-    ec_SDOread(slave, index, subidx, FALSE, &l, &usdo, EC_TIMEOUTRXM);
-    if (EcatError) {
-        return ec_elist2string();
+    ecx_SDOread(&ec->context, slave, index, subidx, FALSE, &l, &usdo, EC_TIMEOUTRXM);
+    if (ec->ecaterror) {
+        return ecx_elist2string(&ec->context);
     } else {
         switch (dtype) {
             case ECT_BOOLEAN:
@@ -298,130 +308,97 @@ EcatProcess::string EcatProcess::SDO2string(uint16 slave, uint16 index, uint8 su
 
 /** Read PDO assign structure */
 int EcatProcess::si_PDOassign(uint16 slave, uint16 PDOassign, int mapoffset, int bitoffset) {
-    uint16 idxloop, nidx, subidxloop, rdat, idx, subidx;
-    uint8 subcnt;
-    int wkc, bsize = 0, rdl;
-    int32 rdat2;
+    int wkc, bsize = 0;
     uint8 bitlen, obj_subidx;
     uint16 obj_idx;
     int abs_offset, abs_bit;
+    std::vector<uint16> pdos;
+    std::vector<uint32> entries;
 
-    rdl = sizeof(rdat);
-    rdat = 0;
-    /* read PDO assign subindex 0 ( = number of PDO's) */
-    wkc = ec_SDOread(slave, PDOassign, 0x00, FALSE, &rdl, &rdat, EC_TIMEOUTRXM); // 0x1c12:0 -> rdat2 = RxMapping number
-    rdat = etohs(rdat);
-    /* positive result from slave ? */
-    if ((wkc > 0) && (rdat > 0)) {
-        /* number of available sub indexes */
-        nidx = rdat;
-        bsize = 0;
-        /* read all PDO's */
-        for (idxloop = 1; idxloop <= nidx; idxloop++) {
-            rdl = sizeof(rdat);
-            rdat = 0;
-            /* read PDO assign */
-            wkc = ec_SDOread(slave, PDOassign, (uint8) idxloop, FALSE, &rdl, &rdat,
-                             EC_TIMEOUTRXM); // 0x1c12:01-> rdat = 0x1600
-            /* result is index of PDO */
-            idx = etohs(rdat);
-            if (idx > 0) {
-                rdl = sizeof(subcnt);
-                subcnt = 0;
-                /* read number of subindexes of PDO */
-                wkc = ec_SDOread(slave, idx, 0x00, FALSE, &rdl, &subcnt,
-                                 EC_TIMEOUTRXM); // 0x1600:0-> subcnt = Outputs number
-                subidx = subcnt;
-                /* for each subindex */
-                for (subidxloop = 1; subidxloop <= subidx; subidxloop++) {
-                    rdl = sizeof(rdat2);
-                    rdat2 = 0;
-                    /* read SDO that is mapped in PDO */
-                    wkc = ec_SDOread(slave, idx, (uint8) subidxloop, FALSE, &rdl, &rdat2,
-                                     EC_TIMEOUTRXM); // 0x1600:01-> rdat2 = 0x607A(Target position)
-                    rdat2 = etohl(rdat2);
-                    /* extract bitlength of SDO */
-                    bitlen = LO_BYTE(rdat2);
-                    bsize += bitlen;
-                    obj_idx = (uint16) (rdat2 >> 16);
-                    obj_subidx = (uint8) ((rdat2 >> 8) & 0x000000ff);
-                    abs_offset = mapoffset + (bitoffset / 8);
-                    abs_bit = bitoffset % 8;
-                    ODlist.Slave = slave;
-                    ODlist.Index[0] = obj_idx;
-                    OElist.Entries = 0;
-                    wkc = 0;
-                    /* read object entry from dictionary if not a filler (0x0000:0x00) */
-                    if (obj_idx || obj_subidx)
-                        wkc = ec_readOEsingle(0, obj_subidx, &ODlist, &OElist);
-                    printf("  [0x%4.4X.%1d] 0x%4.4X:0x%2.2X 0x%2.2X", abs_offset, abs_bit, obj_idx, obj_subidx, bitlen);
-                    if ((wkc > 0) && OElist.Entries) {
-                        printf(" %-12s %s\n", dtype2string(OElist.DataType[obj_subidx]).c_str(),
-                               OElist.Name[obj_subidx]);
-                    } else
-                        printf("\n");
-                    bitoffset += bitlen;
-                };
-            };
-        };
-    };
+    /* read PDO assign, whole object with complete access if the slave supports it */
+    if (!sdoReader->readPdoAssign(slave, PDOassign, pdos)) // 0x1c12 -> 0x1600, ...
+        return 0;
+    /* read all PDO's */
+    for (uint16 idx: pdos) {
+        /* result is index of PDO */
+        if ((idx == 0) || !sdoReader->readPdoMapping(slave, idx, entries)) // 0x1600 -> 0x607A0020, ...
+            continue;
+        /* for each SDO that is mapped in PDO */
+        for (uint32 rdat2: entries) {
+            /* extract bitlength of SDO */
+            bitlen = LO_BYTE(rdat2);
+            bsize += bitlen;
+            obj_idx = (uint16) (rdat2 >> 16);
+            obj_subidx = (uint8) ((rdat2 >> 8) & 0x000000ff);
+            abs_offset = mapoffset + (bitoffset / 8);
+            abs_bit = bitoffset % 8;
+            ODlist.Slave = slave;
+            ODlist.Index[0] = obj_idx;
+            OElist.Entries = 0;
+            wkc = 0;
+            /* read object entry from dictionary if not a filler (0x0000:0x00) */
+            if (obj_idx || obj_subidx)
+                wkc = ecx_readOEsingle(&ec->context, 0, obj_subidx, &ODlist, &OElist);
+            printf("  [0x%4.4X.%1d] 0x%4.4X:0x%2.2X 0x%2.2X", abs_offset, abs_bit, obj_idx, obj_subidx, bitlen);
+            if ((wkc > 0) && OElist.Entries) {
+                printf(" %-12s %s\n", dtype2string(OElist.DataType[obj_subidx]).c_str(),
+                       OElist.Name[obj_subidx]);
+            } else
+                printf("\n");
+            bitoffset += bitlen;
+        }
+    }
     /* return total found bitlength (PDO) */
     return bsize;
 }
 
 int EcatProcess::si_map_sdo(int slave) {
-    int wkc, rdl;
     int retVal = 0;
-    uint8 nSM, iSM, tSM;
+    int nSM;
+    uint8 tSM;
     int Tsize, outputs_bo, inputs_bo;
     uint8 SMt_bug_add;
+    std::vector<uint8> types;
 
     printf("PDO mapping according to CoE :\n");
     SMt_bug_add = 0;
     outputs_bo = 0;
     inputs_bo = 0;
-    rdl = sizeof(nSM);
-    nSM = 0;
-    /* read SyncManager Communication Type object count */
-    wkc = ec_SDOread(slave, ECT_SDO_SMCOMMTYPE, 0x00, FALSE, &rdl, &nSM, EC_TIMEOUTRXM);
+    /* read SyncManager Communication Types */
+    nSM = sdoReader->readSMCommTypes(slave, types);
     /* positive result from slave ? */
-    if ((wkc > 0) && (nSM > 2)) {
+    if (nSM > 2) {
         /* make nSM equal to number of defined SM */
         nSM--;
         /* limit to maximum number of SM defined, if true the slave can't be configured */
         if (nSM > EC_MAXSM)
             nSM = EC_MAXSM;
         /* iterate for every SM type defined */
-        for (iSM = 2; iSM <= nSM; iSM++) {
-            rdl = sizeof(tSM);
-            tSM = 0;
-            /* read SyncManager Communication Type */
-            wkc = ec_SDOread(slave, ECT_SDO_SMCOMMTYPE, iSM + 1, FALSE, &rdl, &tSM, EC_TIMEOUTRXM);
-            if (wkc > 0) {
-                if ((iSM == 2) && (tSM == 2)) // SM2 has type 2 == mailbox out, this is a bug in the slave!
-                {
-                    SMt_bug_add = 1; // try to correct, this works if the types are 0 1 2 3 and should be 1 2 3 4
-                    printf("Activated SM type workaround, possible incorrect mapping.\n");
-                }
-                if (tSM)
-                    tSM += SMt_bug_add; // only add if SMt > 0
+        for (int iSM = 2; iSM <= nSM; iSM++) {
+            tSM = types[iSM];
+            if ((iSM == 2) && (tSM == 2)) // SM2 has type 2 == mailbox out, this is a bug in the slave!
+            {
+                SMt_bug_add = 1; // try to correct, this works if the types are 0 1 2 3 and should be 1 2 3 4
+                printf("Activated SM type workaround, possible incorrect mapping.\n");
+            }
+            if (tSM)
+                tSM += SMt_bug_add; // only add if SMt > 0
 
-                if (tSM == 3) // outputs
-                {
-                    /* read the assign RXPDO */
-                    printf("  SM%1d outputs\n     addr b   index: sub bitl data_type    name\n", iSM);
-                    Tsize = si_PDOassign(slave, ECT_SDO_PDOASSIGN + iSM,
-                                         (int) (ec_slave[slave].outputs - (uint8 *) &IOmap[0]), outputs_bo);
-                    outputs_bo += Tsize;
-                }
-                if (tSM == 4) // inputs
-                {
-                    /* read the assign TXPDO */
-                    printf("  SM%1d inputs\n     addr b   index: sub bitl data_type    name\n", iSM);
-                    Tsize = si_PDOassign(slave, ECT_SDO_PDOASSIGN + iSM,
-                                         (int) (ec_slave[slave].inputs - (uint8 *) &IOmap[0]), inputs_bo);
-                    inputs_bo += Tsize;
-                }
+            if (tSM == 3) // outputs
+            {
+                /* read the assign RXPDO */
+                printf("  SM%1d outputs\n     addr b   index: sub bitl data_type    name\n", iSM);
+                Tsize = si_PDOassign(slave, ECT_SDO_PDOASSIGN + iSM,
+                                     (int) (ec->slavelist[slave].outputs - IOmap), outputs_bo);
+                outputs_bo += Tsize;
+            }
+            if (tSM == 4) // inputs
+            {
+                /* read the assign TXPDO */
+                printf("  SM%1d inputs\n     addr b   index: sub bitl data_type    name\n", iSM);
+                Tsize = si_PDOassign(slave, ECT_SDO_PDOASSIGN + iSM,
+                                     (int) (ec->slavelist[slave].inputs - IOmap), inputs_bo);
+                inputs_bo += Tsize;
             }
         }
     }
@@ -446,7 +423,7 @@ int EcatProcess::si_siiPDO(uint16 slave, uint8 t, int mapoffset, int bitoffset)
     int abs_offset, abs_bit;
     char str_name[EC_MAXNAME + 1];
 
-    eectl = ec_slave[slave].eep_pdi;
+    eectl = ec->slavelist[slave].eep_pdi;
     Size = 0;
     totalsize = 0;
     PDO = &eepPDO;
@@ -456,32 +433,32 @@ int EcatProcess::si_siiPDO(uint16 slave, uint8 t, int mapoffset, int bitoffset)
     for (c = 0; c < EC_MAXSM; c++) PDO->SMbitsize[c] = 0;
     if (t > 1)
         t = 1;
-    PDO->Startpos = ec_siifind(slave, ECT_SII_PDO + t);
+    PDO->Startpos = ecx_siifind(&ec->context, slave, ECT_SII_PDO + t);
     if (PDO->Startpos > 0) {
         a = PDO->Startpos;
-        w = ec_siigetbyte(slave, a++);
-        w += (ec_siigetbyte(slave, a++) << 8);
+        w = ecx_siigetbyte(&ec->context, slave, a++);
+        w += (ecx_siigetbyte(&ec->context, slave, a++) << 8);
         PDO->Length = w;
         c = 1;
         /* traverse through all PDOs */
         do {
             PDO->nPDO++;
-            PDO->Index[PDO->nPDO] = ec_siigetbyte(slave, a++);
-            PDO->Index[PDO->nPDO] += (ec_siigetbyte(slave, a++) << 8);
+            PDO->Index[PDO->nPDO] = ecx_siigetbyte(&ec->context, slave, a++);
+            PDO->Index[PDO->nPDO] += (ecx_siigetbyte(&ec->context, slave, a++) << 8);
             PDO->BitSize[PDO->nPDO] = 0;
             c++;
             /* number of entries in PDO */
-            e = ec_siigetbyte(slave, a++);
-            PDO->SyncM[PDO->nPDO] = ec_siigetbyte(slave, a++);
+            e = ecx_siigetbyte(&ec->context, slave, a++);
+            PDO->SyncM[PDO->nPDO] = ecx_siigetbyte(&ec->context, slave, a++);
             a++;
-            obj_name = ec_siigetbyte(slave, a++);
+            obj_name = ecx_siigetbyte(&ec->context, slave, a++);
             a += 2;
             c += 2;
             if (PDO->SyncM[PDO->nPDO] < EC_MAXSM) /* active and in range SM? */
             {
                 str_name[0] = 0;
                 if (obj_name)
-                    ec_siistring(str_name, slave, obj_name);
+                    ecx_siistring(&ec->context, str_name, slave, obj_name);
                 if (t)
                     printf("  SM%1d RXPDO 0x%4.4X %s\n", PDO->SyncM[PDO->nPDO], PDO->Index[PDO->nPDO], str_name);
                 else
@@ -490,12 +467,12 @@ int EcatProcess::si_siiPDO(uint16 slave, uint8 t, int mapoffset, int bitoffset)
                 /* read all entries defined in PDO */
                 for (er = 1; er <= e; er++) {
                     c += 4;
-                    obj_idx = ec_siigetbyte(slave, a++);
-                    obj_idx += (ec_siigetbyte(slave, a++) << 8);
-                    obj_subidx = ec_siigetbyte(slave, a++);
-                    obj_name = ec_siigetbyte(slave, a++);
-                    obj_datatype = ec_siigetbyte(slave, a++);
-                    bitlen = ec_siigetbyte(slave, a++);
+                    obj_idx = ecx_siigetbyte(&ec->context, slave, a++);
+                    obj_idx += (ecx_siigetbyte(&ec->context, slave, a++) << 8);
+                    obj_subidx = ecx_siigetbyte(&ec->context, slave, a++);
+                    obj_name = ecx_siigetbyte(&ec->context, slave, a++);
+                    obj_datatype = ecx_siigetbyte(&ec->context, slave, a++);
+                    bitlen = ecx_siigetbyte(&ec->context, slave, a++);
                     abs_offset = mapoffset + (bitoffset / 8);
                     abs_bit = bitoffset % 8;
 
@@ -506,11 +483,11 @@ int EcatProcess::si_siiPDO(uint16 slave, uint8 t, int mapoffset, int bitoffset)
                     if (obj_idx || obj_subidx) {
                         str_name[0] = 0;
                         if (obj_name)
-                            ec_siistring(str_name, slave, obj_name);
+                            ecx_siistring(&ec->context, str_name, slave, obj_name);
 
                         printf("  [0x%4.4X.%1d] 0x%4.4X:0x%2.2X 0x%2.2X", abs_offset, abs_bit, obj_idx, obj_subidx,
                                bitlen);
-                        printf(" %-12s %s\n", dtype2string(obj_datatype), str_name);
+                        printf(" %-12s %s\n", dtype2string(obj_datatype).c_str(), str_name);
                     }
                     bitoffset += bitlen;
                     totalsize += bitlen;
@@ -527,7 +504,7 @@ int EcatProcess::si_siiPDO(uint16 slave, uint8 t, int mapoffset, int bitoffset)
             if (PDO->nPDO >= (EC_MAXEEPDO - 1)) c = PDO->Length; /* limit number of PDO entries in buffer */
         } while (c < PDO->Length);
     }
-    if (eectl) ec_eeprom2pdi(slave); /* if eeprom control was previously pdi then restore */
+    if (eectl) ecx_eeprom2pdi(&ec->context, slave); /* if eeprom control was previously pdi then restore */
     return totalsize;
 }
 
@@ -540,10 +517,10 @@ int EcatProcess::si_map_sii(int slave) {
     outputs_bo = 0;
     inputs_bo = 0;
     /* read the assign RXPDOs */
-    Tsize = si_siiPDO(slave, 1, (int) (ec_slave[slave].outputs - (uint8 *) &IOmap), outputs_bo);
+    Tsize = si_siiPDO(slave, 1, (int) (ec->slavelist[slave].outputs - IOmap), outputs_bo);
     outputs_bo += Tsize;
     /* read the assign TXPDOs */
-    Tsize = si_siiPDO(slave, 0, (int) (ec_slave[slave].inputs - (uint8 *) &IOmap), inputs_bo);
+    Tsize = si_siiPDO(slave, 0, (int) (ec->slavelist[slave].inputs - IOmap), inputs_bo);
     inputs_bo += Tsize;
     /* found some I/O bits ? */
     if ((outputs_bo > 0) || (inputs_bo > 0))
@@ -556,27 +533,27 @@ void EcatProcess::si_sdo(int cnt) {
 
     ODlist.Entries = 0;
     memset(&ODlist, 0, sizeof(ODlist));
-    if (ec_readODlist(cnt, &ODlist)) {
+    if (ecx_readODlist(&ec->context, cnt, &ODlist)) {
         printf(" CoE Object Description found, %d entries.\n", ODlist.Entries);
         for (i = 0; i < ODlist.Entries; i++) {
-            ec_readODdescription(i, &ODlist);
-            while (EcatError) printf("%s", ec_elist2string());
+            ecx_readODdescription(&ec->context, i, &ODlist);
+            while (ec->ecaterror) printf("%s", ecx_elist2string(&ec->context));
             printf(" Index: %4.4x Datatype: %4.4x Objectcode: %2.2x Name: %s\n",
                    ODlist.Index[i], ODlist.DataType[i], ODlist.ObjectCode[i], ODlist.Name[i]);
             memset(&OElist, 0, sizeof(OElist));
-            ec_readOE(i, &ODlist, &OElist);
-            while (EcatError) printf("%s", ec_elist2string());
+            ecx_readOE(&ec->context, i, &ODlist, &OElist);
+            while (ec->ecaterror) printf("%s", ecx_elist2string(&ec->context));
             for (j = 0; j < ODlist.MaxSub[i] + 1; j++) {
                 if ((OElist.DataType[j] > 0) && (OElist.BitLength[j] > 0)) {
                     printf("  Sub: %2.2x Datatype: %4.4x Bitlength: %4.4x Obj.access: %4.4x Name: %s\n",
                            j, OElist.DataType[j], OElist.BitLength[j], OElist.ObjAccess[j], OElist.Name[j]);
                     if ((OElist.ObjAccess[j] & 0x0007)) {
-                        printf("          Value :%s\n", SDO2string(cnt, ODlist.Index[i], j, OElist.DataType[j]));
+                        printf("          Value :%s\n", SDO2string(cnt, ODlist.Index[i], j, OElist.DataType[j]).c_str());
                     }
                 }
             }
         }
     } else {
-        while (EcatError) printf("%s", ec_elist2string());
+        while (ec->ecaterror) printf("%s", ecx_elist2string(&ec->context));
     }
 }
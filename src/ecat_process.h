@@ -24,10 +24,12 @@ Yang Luo, PHD
 #ifndef ROCOS_SOEM_ECAT_PROCESS_H
 #define ROCOS_SOEM_ECAT_PROCESS_H
 
-#include "ethercat.h"
+#include "ecat_context.h"
+#include "ecat_sdo_reader.h"
 #include <ecat_config_master.h>
 
 #include <string>
+#include <vector>
 
 class EcatProcess {
     using string = std::string;
@@ -46,7 +48,10 @@ public:
     void si_sdo(int cnt);
 
 private:
-    char IOmap[4096];
+    EcatContext *ec {nullptr}; // own SOEM context, independent of the ec_* globals
+    EcatSdoReader *sdoReader {nullptr};
+    uint8 *IOmap {nullptr}; // sized to the mapping by ec_config_map_alloc()
+    int IOmapSize {0};
     ec_ODlistt ODlist;
     ec_OElistt OElist;
     boolean printSDO  {FALSE};
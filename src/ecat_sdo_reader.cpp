@@ -0,0 +1,95 @@
+//
+// Created by think on 3/31/24.
+//
+
+#include "ecat_sdo_reader.h"
+
+#include <cstring>
+
+EcatSdoReader::EcatSdoReader(ecx_contextt *context)
+        : context(context), noCA(EC_MAXSLAVE, 0) {
+}
+
+int EcatSdoReader::readSMCommTypes(uint16 slave, std::vector<uint8> &types) {
+    std::vector<uint32> values;
+
+    types.clear();
+    if (!readArray(slave, ECT_SDO_SMCOMMTYPE, sizeof(uint8), values))
+        return 0;
+    for (uint32 v: values)
+        types.push_back((uint8) v);
+
+    return (int) types.size();
+}
+
+bool EcatSdoReader::readPdoAssign(uint16 slave, uint16 index, std::vector<uint16> &pdos) {
+    std::vector<uint32> values;
+
+    pdos.clear();
+    if (!readArray(slave, index, sizeof(uint16), values))
+        return false;
+    for (uint32 v: values)
+        pdos.push_back((uint16) v);
+
+    return true;
+}
+
+bool EcatSdoReader::readPdoMapping(uint16 slave, uint16 index, std::vector<uint32> &entries) {
+    return readArray(slave, index, sizeof(uint32), entries);
+}
+
+/** Read subindex 0 and all entries of an array object, entries of size bytes. */
+bool EcatSdoReader::readArray(uint16 slave, uint16 index, int size, std::vector<uint32> &values) {
+    int rdl, wkc;
+    uint8 n = 0;
+
+    values.clear();
+    if ((context->slavelist[slave].CoEdetails & ECT_COEDET_SDOCA) && !noCA[slave]) {
+        if (readArrayCA(slave, index, size, values))
+            return true;
+        /* read this slave per subindex from now on */
+        noCA[slave] = 1;
+        fallbackCount++;
+    }
+
+    rdl = sizeof(n);
+    wkc = ecx_SDOread(context, slave, index, 0x00, FALSE, &rdl, &n, EC_TIMEOUTRXM);
+    transferCount++;
+    if (wkc <= 0)
+        return false;
+    for (int sub = 1; sub <= n; sub++) {
+        uint32 v = 0;
+        rdl = size;
+        wkc = ecx_SDOread(context, slave, index, (uint8) sub, FALSE, &rdl, &v, EC_TIMEOUTRXM);
+        transferCount++;
+        /* a failed entry reads as 0, as before */
+        values.push_back(wkc > 0 ? etohl(v) : 0);
+    }
+
+    return true;
+}
+
+/** Read an array object with complete access. Subindex 0 is followed by one
+ *  padding byte, then the entries, as in ec_PDOassignt and ec_PDOdesct. */
+bool EcatSdoReader::readArrayCA(uint16 slave, uint16 index, int size, std::vector<uint32> &values) {
+    uint8 buf[2 + 255 * sizeof(uint32)];
+    int rdl = sizeof(buf);
+
+    memset(buf, 0, sizeof(buf));
+    int wkc = ecx_SDOread(context, slave, index, 0x00, TRUE, &rdl, buf, EC_TIMEOUTRXM);
+    transferCount++;
+    if (wkc <= 0)
+        return false;
+    int n = buf[0];
+    if (rdl < 2 + n * size)
+        return false;
+    for (int sub = 0; sub < n; sub++) {
+        uint32 v = 0;
+        memcpy(&v, &buf[2 + sub * size], size);
+        values.push_back(etohl(v));
+    }
+    /* subindex 0 and every entry would have been one transfer each */
+    savedCount += n;
+
+    return true;
+}
@@ -0,0 +1,68 @@
+/*
+Copyright 2021, Yang Luo"
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+@Author
+Yang Luo, PHD
+@email: yluo@hit.edu.cn
+
+@Created on: 2024.03.31
+@Last Modified: 2024.03.31
+*/
+
+#ifndef ROCOS_SOEM_ECAT_SDO_READER_H
+#define ROCOS_SOEM_ECAT_SDO_READER_H
+
+#include "ethercat.h"
+
+#include <atomic>
+#include <vector>
+
+/** Reads the array objects of the PDO discovery: SyncManager types 0x1C00,
+ * PDO assign 0x1C1x and PDO mapping 0x16xx/0x1Axx. A slave that advertises
+ * complete access in CoEdetails gets the whole object in one transfer instead
+ * of one transfer per subindex. If complete access fails, the slave is read
+ * per subindex from then on. Different slaves can be read from several
+ * threads at the same time.
+ */
+class EcatSdoReader {
+public:
+    explicit EcatSdoReader(ecx_contextt *context);
+
+    /** SyncManager communication types, types[k] is SM k. @return number of SyncManagers, 0 on error */
+    int readSMCommTypes(uint16 slave, std::vector<uint8> &types);
+
+    /** PDOs assigned to a SyncManager. @return false on error */
+    bool readPdoAssign(uint16 slave, uint16 index, std::vector<uint16> &pdos);
+
+    /** Entries of a PDO, index << 16 | subindex << 8 | bitlength. @return false on error */
+    bool readPdoMapping(uint16 slave, uint16 index, std::vector<uint32> &entries);
+
+    int transfers() const { return transferCount; }     //!< mailbox transfers done
+    int saved() const { return savedCount; }            //!< transfers saved by complete access
+    int fallbacks() const { return fallbackCount; }     //!< slaves where complete access failed
+
+private:
+    bool readArray(uint16 slave, uint16 index, int size, std::vector<uint32> &values);
+    bool readArrayCA(uint16 slave, uint16 index, int size, std::vector<uint32> &values);
+
+    ecx_contextt *context;
+    std::vector<uint8> noCA; // per slave, complete access failed
+    std::atomic<int> transferCount {0};
+    std::atomic<int> savedCount {0};
+    std::atomic<int> fallbackCount {0};
+};
+
+
+#endif //ROCOS_SOEM_ECAT_SDO_READER_H
@@ -0,0 +1,1449 @@
+//
+// Created by think on 3/31/24.
+//
+
+#include "ecat_segment.h"
+#include "ecat_pdo_cache.h"
+#include "ecat_sdo_reader.h"
+#include "ecat_sync0.h"
+#include "capture.h"
+#include <ecat_flags.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define EC_TIMEOUTMON 500
+
+EcatSegment::EcatSegment(int id, const string &ifname, const string &if2name)
+        : segmentId(id), ifName(ifname), if2Name(if2name) {
+    ec = new EcatContext();
+    sdoReader = new EcatSdoReader(&ec->context);
+}
+
+EcatSegment::~EcatSegment() {
+    close();
+    free(IOmap);
+    delete sdoReader;
+    delete ec;
+}
+
+EcatSegment::string EcatSegment::dtype2string(uint16 dtype) {
+    char hstr[1024];
+    switch (dtype) {
+        case ECT_BOOLEAN:
+            sprintf(hstr, "BOOLEAN");
+            break;
+        case ECT_INTEGER8:
+            sprintf(hstr, "INTEGER8");
+            break;
+        case ECT_INTEGER16:
+            sprintf(hstr, "INTEGER16");
+            break;
+        case ECT_INTEGER32:
+            sprintf(hstr, "INTEGER32");
+            break;
+        case ECT_INTEGER24:
+            sprintf(hstr, "INTEGER24");
+            break;
+        case ECT_INTEGER64:
+            sprintf(hstr, "INTEGER64");
+            break;
+        case ECT_UNSIGNED8:
+            sprintf(hstr, "UNSIGNED8");
+            break;
+        case ECT_UNSIGNED16:
+            sprintf(hstr, "UNSIGNED16");
+            break;
+        case ECT_UNSIGNED32:
+            sprintf(hstr, "UNSIGNED32");
+            break;
+        case ECT_UNSIGNED24:
+            sprintf(hstr, "UNSIGNED24");
+            break;
+        case ECT_UNSIGNED64:
+            sprintf(hstr, "UNSIGNED64");
+            break;
+        case ECT_REAL32:
+            sprintf(hstr, "REAL32");
+            break;
+        case ECT_REAL64:
+            sprintf(hstr, "REAL64");
+            break;
+        case ECT_BIT1:
+            sprintf(hstr, "BIT1");
+            break;
+        case ECT_BIT2:
+            sprintf(hstr, "BIT2");
+            break;
+        case ECT_BIT3:
+            sprintf(hstr, "BIT3");
+            break;
+        case ECT_BIT4:
+            sprintf(hstr, "BIT4");
+            break;
+        case ECT_BIT5:
+            sprintf(hstr, "BIT5");
+            break;
+        case ECT_BIT6:
+            sprintf(hstr, "BIT6");
+            break;
+        case ECT_BIT7:
+            sprintf(hstr, "BIT7");
+            break;
+        case ECT_BIT8:
+            sprintf(hstr, "BIT8");
+            break;
+        case ECT_VISIBLE_STRING:
+            sprintf(hstr, "VISIBLE_STRING");
+            break;
+        case ECT_OCTET_STRING:
+            sprintf(hstr, "OCTET_STRING");
+            break;
+        default:
+            sprintf(hstr, "Type 0x%4.4X", dtype);
+    }
+    return hstr;
+}
+
+EcatSegment::string EcatSegment::SDO2string(uint16 slave, uint16 index, uint8 subidx, uint16 dtype) {
+    char hstr[1024];
+    int l = sizeof(usdo) - 1, i;
+    uint8 *u8;
+    int8 *i8;
+    uint16 *u16;
+    int16 *i16;
+    uint32 *u32;
+    int32 *i32;
+    uint64 *u64;
+    int64 *i64;
+    float *sr;
+    double *dr;
+    char es[32];
+
+    memset(&usdo, 0, 128);
+    ecx_SDOread(&ec->context, slave, index, subidx, FALSE, &l, &usdo, EC_TIMEOUTRXM);
+    if (ec->ecaterror) {
+        return ecx_elist2string(&ec->context);
+    } else {
+        switch (dtype) {
+            case ECT_BOOLEAN:
+                u8 = (uint8 *) &usdo[0];
+                if (*u8) sprintf(hstr, "TRUE");
+                else sprintf(hstr, "FALSE");
+                break;
+            case ECT_INTEGER8:
+                i8 = (int8 *) &usdo[0];
+                sprintf(hstr, "0x%2.2x %d", *i8, *i8);
+                break;
+            case ECT_INTEGER16:
+                i16 = (int16 *) &usdo[0];
+                sprintf(hstr, "0x%4.4x %d", *i16, *i16);
+                break;
+            case ECT_INTEGER32:
+            case ECT_INTEGER24:
+                i32 = (int32 *) &usdo[0];
+                sprintf(hstr, "0x%8.8x %d", *i32, *i32);
+                break;
+            case ECT_INTEGER64:
+                i64 = (int64 *) &usdo[0];
+                sprintf(hstr, "0x%16.16" PRIx64" %" PRId64, *i64, *i64);
+                break;
+            case ECT_UNSIGNED8:
+                u8 = (uint8 *) &usdo[0];
+                sprintf(hstr, "0x%2.2x %u", *u8, *u8);
+                break;
+            case ECT_UNSIGNED16:
+                u16 = (uint16 *) &usdo[0];
+                sprintf(hstr, "0x%4.4x %u", *u16, *u16);
+                break;
+            case ECT_UNSIGNED32:
+            case ECT_UNSIGNED24:
+                u32 = (uint32 *) &usdo[0];
+                sprintf(hstr, "0x%8.8x %u", *u32, *u32);
+                break;
+            case ECT_UNSIGNED64:
+                u64 = (uint64 *) &usdo[0];
+                sprintf(hstr, "0x%16.16" PRIx64" %" PRIu64, *u64, *u64);
+                break;
+            case ECT_REAL32:
+                sr = (float *) &usdo[0];
+                sprintf(hstr, "%f", *sr);
+                break;
+            case ECT_REAL64:
+                dr = (double *) &usdo[0];
+                sprintf(hstr, "%f", *dr);
+                break;
+            case ECT_BIT1:
+            case ECT_BIT2:
+            case ECT_BIT3:
+            case ECT_BIT4:
+            case ECT_BIT5:
+            case ECT_BIT6:
+            case ECT_BIT7:
+            case ECT_BIT8:
+                u8 = (uint8 *) &usdo[0];
+                sprintf(hstr, "0x%x", *u8);
+                break;
+            case ECT_VISIBLE_STRING:
+                strcpy(hstr, usdo);
+                break;
+            case ECT_OCTET_STRING:
+                hstr[0] = 0x00;
+                for (i = 0; i < l; i++) {
+                    sprintf(es, "0x%2.2x ", usdo[i]);
+                    strcat(hstr, es);
+                }
+                break;
+            default:
+                sprintf(hstr, "Unknown type");
+        }
+        return hstr;
+    }
+}
+
+/** Read PDO assign structure. Only reads from the slave, so the mappings of
+ *  several slaves can be read at the same time. */
+int EcatSegment::si_PDOassign(uint16 slave, uint16 PDOassign, int mapoffset, int bitoffset,
+                              std::vector<rocos::PdVar> &pdVar) {
+    int wkc, bsize = 0;
+    uint8 bitlen, obj_subidx;
+    uint16 obj_idx;
+    int abs_offset;
+    std::vector<uint16> pdos;
+    std::vector<uint32> entries;
+    ec_ODlistt ODlist; // per call, the object dictionary buffers of the segment are not shared between threads
+    ec_OElistt OElist;
+
+    /* read PDO assign, whole object with complete access if the slave supports it */
+    if (!sdoReader->readPdoAssign(slave, PDOassign, pdos))
+        return 0;
+
+    /* read all PDO's */
+    for (uint16 idx: pdos) {
+        /* result is index of PDO */
+        if ((idx == 0) || !sdoReader->readPdoMapping(slave, idx, entries))
+            continue;
+
+        /* for each SDO that is mapped in PDO */
+        for (uint32 rdat2: entries) {
+            /* extract bitlength of SDO */
+            bitlen = LO_BYTE(rdat2);
+            bsize += bitlen;
+            obj_idx = (uint16) (rdat2 >> 16);
+            obj_subidx = (uint8) ((rdat2 >> 8) & 0x000000ff);
+            abs_offset = mapoffset + (bitoffset / 8);
+            ODlist.Slave = slave;
+            ODlist.Index[0] = obj_idx;
+            OElist.Entries = 0;
+            wkc = 0;
+            /* read object entry from dictionary if not a filler (0x0000:0x00) */
+            if (obj_idx || obj_subidx)
+                wkc = ecx_readOEsingle(&ec->context, 0, obj_subidx, &ODlist, &OElist);
+
+            rocos::PdVar var;
+            var.index = obj_idx;
+            var.sub_index = obj_subidx;
+
+            if ((wkc > 0) && OElist.Entries) {
+                memcpy(var.name, OElist.Name[obj_subidx],
+                       std::min(strlen(OElist.Name[obj_subidx]), sizeof(var.name) - 1)); /// Input Var Name
+
+                var.offset = abs_offset;
+                var.size = bitlen / 8;
+
+                pdVar.push_back(var);
+            }
+
+            bitoffset += bitlen;
+        }
+    }
+
+    /* return total found bitlength (PDO) */
+    return bsize;
+}
+
+int EcatSegment::si_map_sdo(int slave, SlaveMapping &mapping) {
+    int retVal = 0;
+    int nSM;
+    uint8 tSM;
+    int Tsize, outputs_bo, inputs_bo;
+    uint8 SMt_bug_add;
+    std::vector<uint8> types;
+
+    SMt_bug_add = 0;
+    outputs_bo = 0;
+    inputs_bo = 0;
+    /* read SyncManager Communication Types */
+    nSM = sdoReader->readSMCommTypes(slave, types);
+    /* positive result from slave ? */
+    if (nSM > 2) {
+        /* make nSM equal to number of defined SM */
+        nSM--;
+        /* limit to maximum number of SM defined, if true the slave can't be configured */
+        if (nSM > EC_MAXSM)
+            nSM = EC_MAXSM;
+        int slaveInOffset, slaveOutOffset;
+        slaveOffsets(slave, slaveInOffset, slaveOutOffset);
+        /* iterate for every SM type defined */
+        for (int iSM = 2; iSM <= nSM; iSM++) {
+            tSM = types[iSM];
+            if ((iSM == 2) && (tSM == 2)) // SM2 has type 2 == mailbox out, this is a bug in the slave!
+            {
+                SMt_bug_add = 1; // try to correct, this works if the types are 0 1 2 3 and should be 1 2 3 4
+                mapping.smTypeWorkaround = true;
+            }
+            if (tSM)
+                tSM += SMt_bug_add; // only add if SMt > 0
+
+            if (tSM == 3) // outputs
+            {
+                /* read the assign RXPDO */
+                Tsize = si_PDOassign(slave, ECT_SDO_PDOASSIGN + iSM,
+                                     slaveOutOffset, outputs_bo, mapping.outputs);
+                outputs_bo += Tsize;
+            }
+            if (tSM == 4) // inputs
+            {
+                /* read the assign TXPDO */
+                Tsize = si_PDOassign(slave, ECT_SDO_PDOASSIGN + iSM,
+                                     slaveInOffset, inputs_bo, mapping.inputs);
+                inputs_bo += Tsize;
+            }
+        }
+    }
+
+    /* found some I/O bits ? */
+    if ((outputs_bo > 0) || (inputs_bo > 0))
+        retVal = 1;
+    return retVal;
+}
+
+/** Offsets of the process data of a slave in the input and output image. */
+void EcatSegment::slaveOffsets(int slave, int &inOffset, int &outOffset) {
+    inOffset = 0;
+    outOffset = 0;
+    for (int i = 1; i < slave; i++) {
+        inOffset += ec->slavelist[i].Ibytes;
+        outOffset += ec->slavelist[i].Obytes;
+    }
+}
+
+/** Read the key of the PDO layout cache: identity, mapped bit sizes, SyncManager
+ *  types, the assigned PDOs and their mapping entries. One transfer per object
+ *  with complete access, instead of the whole mapping and object dictionary.
+ *  A slave whose mapping can not be read is not cached. */
+bool EcatSegment::readMappingKey(int slave, std::vector<uint32_t> &key) {
+    const ec_slavet &sl = ec->slavelist[slave];
+    std::vector<uint8> types;
+    std::vector<uint16> pdos;
+    std::vector<uint32> entries;
+    uint8 tSM, SMt_bug_add = 0;
+
+    key = {sl.eep_man, sl.eep_id, sl.eep_rev, (uint32_t) sl.Obits, (uint32_t) sl.Ibits};
+    int nSM = sdoReader->readSMCommTypes(slave, types);
+    if (nSM <= 2) {
+        key.clear();
+        return false;
+    }
+    /* same SyncManager walk as si_map_sdo */
+    nSM--;
+    if (nSM > EC_MAXSM)
+        nSM = EC_MAXSM;
+    for (int iSM = 2; iSM <= nSM; iSM++) {
+        tSM = types[iSM];
+        if ((iSM == 2) && (tSM == 2))
+            SMt_bug_add = 1;
+        if (tSM)
+            tSM += SMt_bug_add;
+        key.push_back(((uint32_t) iSM << 16) | tSM);
+        if ((tSM != 3) && (tSM != 4))
+            continue;
+        if (!sdoReader->readPdoAssign(slave, ECT_SDO_PDOASSIGN + iSM, pdos)) {
+            key.clear();
+            return false;
+        }
+        key.push_back(pdos.size());
+        for (uint16 idx: pdos) {
+            /* the same PDO index may be mapped differently after a reconfiguration */
+            entries.clear();
+            if ((idx != 0) && !sdoReader->readPdoMapping(slave, idx, entries)) {
+                key.clear();
+                return false;
+            }
+            key.push_back(idx);
+            key.push_back(entries.size());
+            key.insert(key.end(), entries.begin(), entries.end());
+        }
+    }
+
+    return true;
+}
+
+/********************************************************************************/
+/** Read the PDO mapping of all slaves over CoE and publish it in shared memory.
+*   The mailbox round trips dominate the startup time, so up to --map_threads
+*   slaves are read at the same time. The result is printed in slave order.
+*
+* \return N/A
+*/
+void EcatSegment::mapSlaves() {
+    std::vector<SlaveMapping> mappings(ec->slavecount + 1);
+    int threads = std::max(1, std::min(FLAGS_map_threads, ec->slavecount));
+    auto start = std::chrono::steady_clock::now();
+
+    std::unique_ptr<EcatPdoCache> cache;
+    if (!FLAGS_pdo_cache_dir.empty())
+        cache.reset(new EcatPdoCache(FLAGS_pdo_cache_dir));
+
+    auto worker = [&](int first) {
+        for (int slave = first; slave <= ec->slavecount; slave += threads) {
+            SlaveMapping &mapping = mappings[slave];
+            if (cache && readMappingKey(slave, mapping.key) &&
+                cache->load(mapping.key, mapping.outputs, mapping.inputs)) {
+                /* cached offsets are relative to the slave */
+                int inOffset, outOffset;
+                slaveOffsets(slave, inOffset, outOffset);
+                for (auto &var: mapping.outputs)
+                    var.offset += outOffset;
+                for (auto &var: mapping.inputs)
+                    var.offset += inOffset;
+                mapping.cached = true;
+                continue;
+            }
+            si_map_sdo(slave, mapping);
+        }
+    };
+    std::vector<std::thread> workers;
+    for (int k = 1; k < threads; k++)
+        workers.emplace_back(worker, k + 1);
+    worker(1);
+    for (auto &t: workers)
+        t.join();
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    int cached = 0;
+    for (int slave = 1; slave <= ec->slavecount; slave++) {
+        SlaveMapping &mapping = mappings[slave];
+        publishMapping(slave, mapping);
+        if (mapping.cached) {
+            cached++;
+        } else if (cache && !mapping.key.empty() && (!mapping.outputs.empty() || !mapping.inputs.empty())) {
+            int inOffset, outOffset;
+            slaveOffsets(slave, inOffset, outOffset);
+            for (auto &var: mapping.outputs)
+                var.offset -= outOffset;
+            for (auto &var: mapping.inputs)
+                var.offset -= inOffset;
+            if (!cache->save(mapping.key, mapping.outputs, mapping.inputs))
+                printf("PDO layout of slave %d not saved to %s\n", slave, FLAGS_pdo_cache_dir.c_str());
+        }
+    }
+    printf("PDO mapping of %d slaves read in %.1f ms with %d threads, %d from the PDO layout cache\n",
+           ec->slavecount, ms, threads, cached);
+    printf("CoE complete access: %d SDO transfers, %d round trips saved, %d slaves fell back\n",
+           sdoReader->transfers(), sdoReader->saved(), sdoReader->fallbacks());
+}
+
+void EcatSegment::publishMapping(int slave, const SlaveMapping &mapping) {
+    rocos::Slave *pSlave = &pEcm->ecatBus->slaves[slave - 1]; //TODO: slaveId is 1-based
+
+    printf("=================================\n");
+
+    memcpy(pSlave->name, ec->slavelist[slave].name, sizeof(ec->slavelist[slave].name)); /// Slave Name
+    printf("Slave Name..........: %s\n", pSlave->name);
+
+    pSlave->id = slave - 1; /// Slave ID
+    printf("Slave ID............: %d\n", pSlave->id);
+
+    printf("Configured address..: %4.4x\n", ec->slavelist[slave].configadr);
+    if (mapping.smTypeWorkaround)
+        printf("Activated SM type workaround, possible incorrect mapping.\n");
+
+    /* tables in shared memory are sized to the mapping */
+    const std::vector<rocos::PdVar> *vars[2] = {&mapping.outputs, &mapping.inputs};
+    int *nums[2] = {&pSlave->output_var_num, &pSlave->input_var_num};
+    boost::interprocess::offset_ptr<rocos::PdVar> *tables[2] = {&pSlave->output_vars, &pSlave->input_vars};
+    const char *names[2] = {"OUT", "IN."};
+    for (int k = 0; k < 2; k++) {
+        const std::vector<rocos::PdVar> &pdVar = *vars[k];
+        *tables[k] = pEcm->createPdVarTable(pdVar.size());
+        std::copy(pdVar.begin(), pdVar.end(), tables[k]->get());
+        *nums[k] = pdVar.size();
+
+        printf("No. of PD %s.......: %d\n", names[k], *nums[k]);
+        for (int i = 0; i < *nums[k]; i++) {
+            printf("[%02d] 0x%4.4X:0x%2.2X....: %s, %d offs, %d size\n", i + 1, pdVar[i].index, pdVar[i].sub_index,
+                   pdVar[i].name, pdVar[i].offset, pdVar[i].size);
+        }
+    }
+}
+
+int EcatSegment::si_siiPDO(uint16 slave, uint8 t, int mapoffset, int bitoffset) {
+    uint16 a, w, c, e, er, Size;
+    uint8 eectl;
+    uint16 obj_idx;
+    uint8 obj_subidx;
+    uint8 obj_name;
+    uint8 obj_datatype;
+    uint8 bitlen;
+    int totalsize;
+    ec_eepromPDOt eepPDO;
+    ec_eepromPDOt *PDO;
+    int abs_offset, abs_bit;
+    char str_name[EC_MAXNAME + 1];
+
+    eectl = ec->slavelist[slave].eep_pdi;
+    Size = 0;
+    totalsize = 0;
+    PDO = &eepPDO;
+    PDO->nPDO = 0;
+    PDO->Length = 0;
+    PDO->Index[1] = 0;
+    for (c = 0; c < EC_MAXSM; c++) PDO->SMbitsize[c] = 0;
+    if (t > 1)
+        t = 1;
+    PDO->Startpos = ecx_siifind(&ec->context, slave, ECT_SII_PDO + t);
+    if (PDO->Startpos > 0) {
+        a = PDO->Startpos;
+        w = ecx_siigetbyte(&ec->context, slave, a++);
+        w += (ecx_siigetbyte(&ec->context, slave, a++) << 8);
+        PDO->Length = w;
+        c = 1;
+        /* traverse through all PDOs */
+        do {
+            PDO->nPDO++;
+            PDO->Index[PDO->nPDO] = ecx_siigetbyte(&ec->context, slave, a++);
+            PDO->Index[PDO->nPDO] += (ecx_siigetbyte(&ec->context, slave, a++) << 8);
+            PDO->BitSize[PDO->nPDO] = 0;
+            c++;
+            /* number of entries in PDO */
+            e = ecx_siigetbyte(&ec->context, slave, a++);
+            PDO->SyncM[PDO->nPDO] = ecx_siigetbyte(&ec->context, slave, a++);
+            a++;
+            obj_name = ecx_siigetbyte(&ec->context, slave, a++);
+            a += 2;
+            c += 2;
+            if (PDO->SyncM[PDO->nPDO] < EC_MAXSM) /* active and in range SM? */
+            {
+                str_name[0] = 0;
+                if (obj_name)
+                    ecx_siistring(&ec->context, str_name, slave, obj_name);
+                if (t)
+                    printf("  SM%1d RXPDO 0x%4.4X %s\n", PDO->SyncM[PDO->nPDO], PDO->Index[PDO->nPDO], str_name);
+                else
+                    printf("  SM%1d TXPDO 0x%4.4X %s\n", PDO->SyncM[PDO->nPDO], PDO->Index[PDO->nPDO], str_name);
+                printf("     addr b   index: sub bitl data_type    name\n");
+                /* read all entries defined in PDO */
+                for (er = 1; er <= e; er++) {
+                    c += 4;
+                    obj_idx = ecx_siigetbyte(&ec->context, slave, a++);
+                    obj_idx += (ecx_siigetbyte(&ec->context, slave, a++) << 8);
+                    obj_subidx = ecx_siigetbyte(&ec->context, slave, a++);
+                    obj_name = ecx_siigetbyte(&ec->context, slave, a++);
+                    obj_datatype = ecx_siigetbyte(&ec->context, slave, a++);
+                    bitlen = ecx_siigetbyte(&ec->context, slave, a++);
+                    abs_offset = mapoffset + (bitoffset / 8);
+                    abs_bit = bitoffset % 8;
+
+                    PDO->BitSize[PDO->nPDO] += bitlen;
+                    a += 2;
+
+                    /* skip entry if filler (0x0000:0x00) */
+                    if (obj_idx || obj_subidx) {
+                        str_name[0] = 0;
+                        if (obj_name)
+                            ecx_siistring(&ec->context, str_name, slave, obj_name);
+
+                        printf("  [0x%4.4X.%1d] 0x%4.4X:0x%2.2X 0x%2.2X", abs_offset, abs_bit, obj_idx, obj_subidx,
+                               bitlen);
+                        printf(" %-12s %s\n", dtype2string(obj_datatype).c_str(), str_name);
+                    }
+                    bitoffset += bitlen;
+                    totalsize += bitlen;
+                }
+                PDO->SMbitsize[PDO->SyncM[PDO->nPDO]] += PDO->BitSize[PDO->nPDO];
+                Size += PDO->BitSize[PDO->nPDO];
+                c++;
+            } else /* PDO deactivated because SM is 0xff or > EC_MAXSM */
+            {
+                c += 4 * e;
+                a += 8 * e;
+                c++;
+            }
+            if (PDO->nPDO >= (EC_MAXEEPDO - 1)) c = PDO->Length; /* limit number of PDO entries in buffer */
+        } while (c < PDO->Length);
+    }
+    if (eectl) ecx_eeprom2pdi(&ec->context, slave); /* if eeprom control was previously pdi then restore */
+    return totalsize;
+}
+
+void EcatSegment::si_sdo(int cnt) {
+    int i, j;
+
+    ODlist.Entries = 0;
+    memset(&ODlist, 0, sizeof(ODlist));
+    if (ecx_readODlist(&ec->context, cnt, &ODlist)) {
+        printf(" CoE Object Description found, %d entries.\n", ODlist.Entries);
+        for (i = 0; i < ODlist.Entries; i++) {
+            ecx_readODdescription(&ec->context, i, &ODlist);
+            while (ec->ecaterror) printf("%s", ecx_elist2string(&ec->context));
+            printf(" Index: %4.4x Datatype: %4.4x Objectcode: %2.2x Name: %s\n",
+                   ODlist.Index[i], ODlist.DataType[i], ODlist.ObjectCode[i], ODlist.Name[i]);
+            memset(&OElist, 0, sizeof(OElist));
+            ecx_readOE(&ec->context, i, &ODlist, &OElist);
+            while (ec->ecaterror) printf("%s", ecx_elist2string(&ec->context));
+            for (j = 0; j < ODlist.MaxSub[i] + 1; j++) {
+                if ((OElist.DataType[j] > 0) && (OElist.BitLength[j] > 0)) {
+                    printf("  Sub: %2.2x Datatype: %4.4x Bitlength: %4.4x Obj.access: %4.4x Name: %s\n",
+                           j, OElist.DataType[j], OElist.BitLength[j], OElist.ObjAccess[j], OElist.Name[j]);
+                    if ((OElist.ObjAccess[j] & 0x0007)) {
+                        printf("          Value :%s\n", SDO2string(cnt, ODlist.Index[i], j, OElist.DataType[j]).c_str());
+                    }
+                }
+            }
+        }
+    } else {
+        while (ec->ecaterror) printf("%s", ecx_elist2string(&ec->context));
+    }
+}
+
+bool EcatSegment::init(bool printSDO) {
+    int cnt, i;
+    uint16 ssigen;
+
+    printf("Starting slaveinfo of segment %d\n", segmentId);
+
+    /* initialise SOEM, bind socket to ifname, and to if2name for cable redundancy */
+    int ok = if2Name.empty() ? ecx_init(&ec->context, ifName.c_str())
+                             : ecx_init_redundant(&ec->context, &ec->redport, ifName.c_str(), &if2Name[0]);
+    if (!ok) {
+        printf("No socket connection on %s\nExcecute as root\n", ifName.c_str());
+        return false;
+    }
+    if (if2Name.empty())
+        printf("ec_init on %s succeeded.\n", ifName.c_str());
+    else
+        printf("ec_init on %s, redundant on %s succeeded.\n", ifName.c_str(), if2Name.c_str());
+
+    if (!ecx_capture_init(&ec->port, FLAGS_capture))
+        printf("Capture ring of %d frames not available.\n", FLAGS_capture);
+
+    /* EEPROM categories of known slave types come from the SII cache */
+    if (!FLAGS_sii_cache_dir.empty())
+        printf("%d SII images loaded from %s\n", ec->loadSiiCache(FLAGS_sii_cache_dir), FLAGS_sii_cache_dir.c_str());
+
+    /* find and auto-config slaves, IOmap is allocated once with the size of the mapping */
+    auto configStart = std::chrono::steady_clock::now();
+    if (ecx_config_init(&ec->context, FALSE) <= 0) {
+        printf("No slaves found!\n");
+        return false;
+    }
+    IOmap = static_cast<uint8 *>(ecx_config_map_group_alloc(&ec->context, 0, FALSE, &IOmapSize));
+    if (ecx_configdc(&ec->context) && (FLAGS_dc_drift > 0)) {
+        /* static drift compensation, in batches of datagrams per frame */
+        auto driftStart = std::chrono::steady_clock::now();
+        dcDriftDatagrams = ecx_dcdrift(&ec->context, FLAGS_dc_drift);
+        printf("DC drift compensation: %d of %d datagrams in %.1f ms\n", dcDriftDatagrams, FLAGS_dc_drift,
+               std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - driftStart).count());
+    }
+    while (ec->ecaterror) printf("%s", ecx_elist2string(&ec->context));
+    printf("%d slaves found and configured in %.1f ms.\n", ec->slavecount,
+           std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - configStart).count());
+    printf("IOmap size %d bytes, %d frames per cycle\n", IOmapSize, ec->grouplist[0].nsegments);
+
+    expectedWKC = (ec->grouplist[0].outputsWKC * 2) + ec->grouplist[0].inputsWKC;
+    printf("Calculated workcounter %d\n", expectedWKC);
+    /* wait for all slaves to reach SAFE_OP state */
+    ecx_statecheck(&ec->context, 0, EC_STATE_SAFE_OP, EC_TIMEOUTSTATE * 3);
+    if (ec->slavelist[0].state != EC_STATE_SAFE_OP) {
+        printf("Not all slaves reached safe operational state.\n");
+        ecx_readstate(&ec->context);
+        for (i = 1; i <= ec->slavecount; i++) {
+            if (ec->slavelist[i].state != EC_STATE_SAFE_OP) {
+                printf("Slave %d State=%2x StatusCode=%4x : %s\n",
+                       i, ec->slavelist[i].state, ec->slavelist[i].ALstatuscode,
+                       ec_ALstatuscode2string(ec->slavelist[i].ALstatuscode));
+            }
+        }
+    }
+
+    uint16 map_1c12[2] = {0x0001, 0x1600};
+    uint16 map_1c13[2] = {0x0001, 0x1a00};
+
+    ecx_SDOwrite(&ec->context, 1, 0x1c12, 0x00, TRUE, sizeof(map_1c12), &map_1c12, EC_TIMEOUTSAFE);
+    ecx_SDOwrite(&ec->context, 1, 0x1c13, 0x00, TRUE, sizeof(map_1c13), &map_1c13, EC_TIMEOUTSAFE);
+
+    std::cout << "PD Input Size: byte -> " << ec->slavelist[0].Ibytes << "; bit -> " << ec->slavelist[0].Ibits
+              << std::endl;
+    std::cout << "PD Output Size: byte -> " << ec->slavelist[0].Obytes << "; bit -> " << ec->slavelist[0].Obits
+              << std::endl;
+
+    pEcm = new EcatConfigMaster(segmentId);
+    pEcm->createSharedMemory();
+    /* 从站表按实际从站数量分配 */
+    pEcm->createSlaveTable(ec->slavecount);
+    /* 创建PD Memory */
+    pEcm->createPdDataMemoryProvider(ec->slavelist[0].Ibytes, ec->slavelist[0].Obytes);
+    /* 输入数据直接从接收缓冲区拷贝到PD Memory */
+    if (FLAGS_direct_rx)
+        ecx_set_inputs_destination(&ec->context, 0, pEcm->pdInputPtr);
+    directRx = FLAGS_direct_rx;
+
+    ecx_readstate(&ec->context);
+    pEcm->ecatBus->slave_num = ec->slavecount;
+    pEcm->ecatBus->redundancy.enabled = (ec->port.redport != nullptr);
+    publishTopology();
+    for (cnt = 1; cnt <= ec->slavecount; cnt++) {
+
+        ssigen = ecx_siifind(&ec->context, cnt, ECT_SII_GENERAL);
+        /* SII general section */
+        if (ssigen) {
+            ec->slavelist[cnt].CoEdetails = ecx_siigetbyte(&ec->context, cnt, ssigen + 0x07);
+            ec->slavelist[cnt].FoEdetails = ecx_siigetbyte(&ec->context, cnt, ssigen + 0x08);
+            ec->slavelist[cnt].EoEdetails = ecx_siigetbyte(&ec->context, cnt, ssigen + 0x09);
+            ec->slavelist[cnt].SoEdetails = ecx_siigetbyte(&ec->context, cnt, ssigen + 0x0a);
+            if ((ecx_siigetbyte(&ec->context, cnt, ssigen + 0x0d) & 0x02) > 0) {
+                ec->slavelist[cnt].blockLRW = 1;
+                ec->slavelist[0].blockLRW++;
+            }
+            ec->slavelist[cnt].Ebuscurrent = ecx_siigetbyte(&ec->context, cnt, ssigen + 0x0e);
+            ec->slavelist[cnt].Ebuscurrent += ecx_siigetbyte(&ec->context, cnt, ssigen + 0x0f) << 8;
+            ec->slavelist[0].Ebuscurrent += ec->slavelist[cnt].Ebuscurrent;
+        }
+
+        if ((ec->slavelist[cnt].mbx_proto & ECT_MBXPROT_COE) && printSDO)
+            si_sdo(cnt);
+    }
+    // Print Map SDO
+    mapSlaves();
+    if (FLAGS_input_changes)
+        setupChangeMap();
+    /* 映射完成, 通知重启前的客户端重新连接 */
+    pEcm->publishSession();
+
+    printf("SII cache: %u bytes from cache, %u EEPROM reads, %d slave types\n", ec->siicache.hits,
+           ec->siicache.reads, ec->siicache.nimages);
+    if (!FLAGS_sii_cache_dir.empty() && (ec->saveSiiCache(FLAGS_sii_cache_dir) < 0))
+        printf("SII cache not saved to %s\n", FLAGS_sii_cache_dir.c_str());
+
+    return true;
+}
+
+bool EcatSegment::setupSync0(long cycleNs) {
+    if (!ec->slavelist[0].hasdc) {
+        printf("Segment %d has no DC slaves, Sync0 not activated\n", segmentId);
+        return false;
+    }
+    long marginNs = FLAGS_sync0_margin * 1000L;
+
+    /* the shift holds for this cycle time, margin and topology */
+    std::vector<uint32_t> key {(uint32_t) cycleNs, (uint32_t) marginNs, (uint32_t) ec->slavecount};
+    for (int slave = 1; slave <= ec->slavecount; slave++) {
+        key.push_back(ec->slavelist[slave].eep_man);
+        key.push_back(ec->slavelist[slave].eep_id);
+        key.push_back((uint32_t) ec->slavelist[slave].parent << 16 | ec->slavelist[slave].hasdc);
+    }
+
+    int32_t shift = 0;
+    long jitter = 0;
+    sync0Active = true;
+    if (!FLAGS_sync0_cache_dir.empty() && EcatSync0Calibration::load(FLAGS_sync0_cache_dir, key, shift)) {
+        printf("Sync0 shift %d us of segment %d from %s\n", shift / 1000, segmentId, FLAGS_sync0_cache_dir.c_str());
+    } else if (calibrateSync0(cycleNs, marginNs, shift, jitter)) {
+        if (!FLAGS_sync0_cache_dir.empty() && !EcatSync0Calibration::save(FLAGS_sync0_cache_dir, key, shift))
+            printf("Sync0 shift not saved to %s\n", FLAGS_sync0_cache_dir.c_str());
+    } else {
+        sync0Active = false;
+        return false;
+    }
+
+    for (int slave = 1; slave <= ec->slavecount; slave++) {
+        if (ec->slavelist[slave].hasdc)
+            ecx_dcsync0(&ec->context, slave, TRUE, cycleNs, shift);
+    }
+    pEcm->ecatBus->sync0_enabled = true;
+    pEcm->ecatBus->sync0_shift = shift;
+    pEcm->ecatBus->sync0_jitter = jitter;
+
+    return true;
+}
+
+bool EcatSegment::goOperational() {
+    /** going operational */
+    ec->slavelist[0].state = EC_STATE_OPERATIONAL;
+    int wkc = ecx_send_processdata(&ec->context);
+    std::cout << "ec_send_processdata returned wkc is: " << wkc << std::endl;
+    wkc = ecx_receive_processdata(&ec->context, EC_TIMEOUTRET100);
+    std::cout << "ec_receive_processdata returned wkc is: " << wkc << std::endl; //此处wkc为1，是因为处于Safe-Op，从站只能Tx
+
+    /* request OP state for all slaves */
+    ecx_writestate(&ec->context, 0); //将ec_slave[i].state状态写入各个slave
+    int chk = 40;
+    /* wait for all slaves to reach OP state */
+    do {
+        ecx_send_processdata(&ec->context);
+        ecx_receive_processdata(&ec->context, EC_TIMEOUTRET100);
+        ecx_statecheck(&ec->context, 0, EC_STATE_OPERATIONAL, EC_TIMEOUTSTATE);
+    } while (chk-- && (ec->slavelist[0].state != EC_STATE_OPERATIONAL));
+
+    if (ec->slavelist[0].state != EC_STATE_OPERATIONAL) {
+        std::cout << "Not all slaves of segment " << segmentId << " reached operational state." << std::endl;
+        return false;
+    }
+    std::cout << "Operational state reached for all slaves of segment " << segmentId << "." << std::endl;
+
+    expectedWKC = (ec->grouplist[0].outputsWKC * 2) + ec->grouplist[0].inputsWKC;
+    printf("Calculated workcounter %d\n", expectedWKC);
+    mapFrameSlaves();
+    checkDirectRx();
+    if (FLAGS_diagnosis)
+        diagnose(true);
+    if (FLAGS_status_decimation > 0) {
+        ecx_set_status_decimation(&ec->context, 0, FLAGS_status_decimation);
+        printf("AL status of the slaves in the cyclic frames every %d cycles\n", FLAGS_status_decimation);
+    }
+    pEcm->ecatBus->dc_drift_datagrams = dcDriftDatagrams;
+    if (ec->slavelist[0].hasdc && (FLAGS_dc_monitor > 0)) {
+        for (int slave = 1; slave <= ec->slavecount; slave++)
+            pEcm->ecatBus->slaves[slave - 1].dc.enabled = ec->slavelist[slave].hasdc;
+        ecx_set_dctime_decimation(&ec->context, 0, FLAGS_dc_monitor);
+        printf("DC system time difference in the cyclic frames every %d cycles\n", FLAGS_dc_monitor);
+    }
+    inOP = true;
+
+    return true;
+}
+
+int EcatSegment::cycle() {
+    /** PDO I/O refresh */
+    /* with direct_rx the frames are copied to the PD memory while they are received,
+     * also by the check thread if it receives while the frame is on the wire */
+    if (directRx)
+        beginInputUpdate();
+    ecx_send_processdata(&ec->context);
+    wkc = ecx_receive_processdata(&ec->context, EC_TIMEOUTRET100);
+    cycleCount++;
+    updateRedundancy();
+
+    if ((wkc < expectedWKC) || lastCycleFaulty)
+        attributeWkc();
+    if (wkc < expectedWKC) {
+        /* no output from the realtime thread, the check thread diagnoses the slaves */
+        if (directRx)
+            abortInputUpdate();
+        pEcm->ecatBus->wkc_error_count++;
+        wkcFaults++;
+        updateRxStatistics();
+        return wkc;
+    }
+
+    if (!directRx) {
+        beginInputUpdate();
+        memcpy(pEcm->pdInputPtr, ec->slavelist[0].inputs, ec->slavelist[0].Ibytes);   // Slave -> Master
+        ec->port.copystat.copies++;
+        ec->port.copystat.bytes += ec->slavelist[0].Ibytes;
+    }
+    updateChangeMap(); // good cycles only, the map of the last good image stays with its stamp
+    endInputUpdate();
+    copyOutputs(); // Master -> Slave
+    updateRxStatistics();
+
+    pEcm->updateSempahore();
+    pEcm->notifyCycle();
+
+    return wkc;
+}
+
+/** Mark the input image as being written, see EcatImageSync. */
+void EcatSegment::beginInputUpdate() {
+    rocos::EcatImageSync &image = pEcm->ecatBus->image;
+
+    image.input_seq.store(image.input_seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+/** Stamp the input image with the cycle and the DC time, and release it to the clients. */
+void EcatSegment::endInputUpdate() {
+    rocos::EcatImageSync &image = pEcm->ecatBus->image;
+
+    image.cycle = cycleCount;
+    image.dc_time = ec->slavelist[0].hasdc ? *ec->context.DCtime : 0;
+    image.input_seq.store(image.input_seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+/** Release the input image after a cycle with a low work counter. Direct
+ *  receive is only used when all inputs are in one frame, which reaches the
+ *  image only with its expected work counter. If it did not, the image is
+ *  unchanged and the counter is set back as if no update had started, the
+ *  clients keep the image of the last good cycle. Otherwise the low work
+ *  counter is in another frame and the image is complete. */
+void EcatSegment::abortInputUpdate() {
+    rocos::EcatImageSync &image = pEcm->ecatBus->image;
+
+    if (ec->context.grouplist[0].plan.rxframes == 0) {
+        image.input_seq.store(image.input_seq.load(std::memory_order_relaxed) - 1, std::memory_order_release);
+        return;
+    }
+    updateChangeMap();
+    endInputUpdate();
+}
+
+/** Assign the bits of the change map and allocate it in shared memory. */
+void EcatSegment::setupChangeMap() {
+    rocos::EcatBus *bus = pEcm->ecatBus;
+    int bytes = ec->slavelist[0].Ibytes;
+    int bit = (ec->slavecount + 63) / 64 * 64; // slave bits first
+
+    changeVars.clear();
+    for (int slave = 0; slave < ec->slavecount; slave++) {
+        rocos::Slave &pSlave = bus->slaves[slave];
+        pSlave.input_change_bit = bit;
+        for (int i = 0; i < pSlave.input_var_num; i++, bit++) {
+            const rocos::PdVar &var = pSlave.input_vars[i];
+            int size = std::max(1, var.size); // bit variables are checked by their byte
+            if ((var.offset >= 0) && (var.offset + size <= bytes))
+                changeVars.push_back({var.offset, size, bit, slave});
+        }
+    }
+
+    int words = (bit + 63) / 64;
+    previousInputs.assign((bytes + 15) / 16 * 16, 0);
+    changedBytes.assign(previousInputs.size() / 8 + 8, 0);
+    changeBits.assign(words, 0);
+    bus->input_changes.bits = pEcm->createChangeMap(words);
+    bus->input_changes.words = words;
+    printf("Input change map of %d variables, %d bytes\n", (int) changeVars.size(), words * 8);
+}
+
+/** Compare the input image with the one of the last good cycle and publish
+ *  the changed slaves and variables. Called while the image is marked as
+ *  being written, only in cycles with the expected work counter, so the
+ *  map and base_cycle always refer to images the clients were given. */
+void EcatSegment::updateChangeMap() {
+    rocos::EcatChangeMap &map = pEcm->ecatBus->input_changes;
+    if (map.words == 0)
+        return;
+    const uint8 *image = (const uint8 *) pEcm->pdInputPtr;
+    int bytes = ec->slavelist[0].Ibytes;
+    int chunk = 0;
+    bool any = false;
+
+    /* bit per changed byte, 16 bytes per compare */
+#ifdef __SSE2__
+    for (; 16 * (chunk + 1) <= bytes; chunk++) {
+        __m128i now = _mm_loadu_si128((const __m128i *) (image + 16 * chunk));
+        __m128i *prev = (__m128i *) &previousInputs[16 * chunk];
+        int changed = ~_mm_movemask_epi8(_mm_cmpeq_epi8(now, _mm_loadu_si128(prev))) & 0xffff;
+        changedBytes[2 * chunk] = (uint8) changed;
+        changedBytes[2 * chunk + 1] = (uint8) (changed >> 8);
+        _mm_storeu_si128(prev, now);
+        any |= (changed != 0);
+    }
+#endif
+    for (int i = 16 * chunk; i < bytes; i += 8)
+        changedBytes[i / 8] = 0;
+    for (int i = 16 * chunk; i < bytes; i++) {
+        if (image[i] != previousInputs[i]) {
+            changedBytes[i / 8] |= (uint8) (1 << (i % 8));
+            previousInputs[i] = image[i];
+            any = true;
+        }
+    }
+
+    std::fill(changeBits.begin(), changeBits.end(), 0);
+    if (any) {
+        for (const ChangeVar &var: changeVars) {
+            /* bits of the bytes of the variable, 56 at a time from a little endian word */
+            bool changed = false;
+            for (int first = var.offset; !changed && (first < var.offset + var.size); first += 56) {
+                int n = std::min(56, var.offset + var.size - first);
+                uint64_t word;
+                memcpy(&word, &changedBytes[first / 8], sizeof(word));
+                changed = ((word >> (first % 8)) & ((1ULL << n) - 1)) != 0;
+            }
+            if (changed) {
+                changeBits[var.bit / 64] |= 1ULL << (var.bit % 64);
+                changeBits[var.slave / 64] |= 1ULL << (var.slave % 64);
+            }
+        }
+    }
+
+    memcpy(map.bits.get(), changeBits.data(), changeBits.size() * sizeof(uint64));
+    map.base_cycle = lastImageCycle;
+    lastImageCycle = cycleCount;
+}
+
+/** Copy the outputs of the clients to the IOmap. A commit in progress is
+ *  retried a few times, after that the cycle is counted in output_skips. */
+void EcatSegment::copyOutputs() {
+    rocos::EcatImageSync &image = pEcm->ecatBus->image;
+
+    for (int tries = 0; tries < 3; tries++) {
+        uint32_t seq = image.output_seq.load(std::memory_order_acquire);
+        if (seq & 1)
+            continue;
+        memcpy(ec->slavelist[0].outputs, pEcm->pdOutputPtr, ec->slavelist[0].Obytes);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (image.output_seq.load(std::memory_order_relaxed) == seq)
+            return;
+    }
+    image.output_skips++;
+}
+
+void EcatSegment::check() {
+    int slave;
+    bool cyclicStates = false;
+
+    if (inOP && (FLAGS_status_decimation > 0) && (ecx_readstate_cyclic(&ec->context, currentgroup) >= 0)) {
+        /* AL states from the cyclic frames, a slave that left OP is found even with a good work counter */
+        cyclicStates = true;
+        if (ec->slavelist[0].state != EC_STATE_OPERATIONAL)
+            ec->grouplist[currentgroup].docheckstate = TRUE;
+    }
+    /* without new states from the cyclic frames wait for the next sweep, unless the frames do not return */
+    if (inOP && ((wkc < expectedWKC) || ec->grouplist[currentgroup].docheckstate) &&
+        (cyclicStates || (FLAGS_status_decimation <= 0) || (wkc <= 0))) {
+        /* one ore more slaves are not responding */
+        ec->grouplist[currentgroup].docheckstate = FALSE;
+        if (!cyclicStates)
+            ecx_readstate(&ec->context);
+        for (slave = 1; slave <= ec->slavecount; slave++) {
+            if ((ec->slavelist[slave].group == currentgroup) && (ec->slavelist[slave].state != EC_STATE_OPERATIONAL)) {
+                ec->grouplist[currentgroup].docheckstate = TRUE;
+                if (ec->slavelist[slave].state == (EC_STATE_SAFE_OP + EC_STATE_ERROR)) {
+                    printf("ERROR : slave %d is in SAFE_OP + ERROR, attempting ack.\n", slave);
+                    ec->slavelist[slave].state = (EC_STATE_SAFE_OP + EC_STATE_ACK);
+                    ecx_writestate(&ec->context, slave);
+                } else if (ec->slavelist[slave].state == EC_STATE_SAFE_OP) {
+                    printf("WARNING : slave %d is in SAFE_OP, change to OPERATIONAL.\n", slave);
+                    ec->slavelist[slave].state = EC_STATE_OPERATIONAL;
+                    ecx_writestate(&ec->context, slave);
+                } else if (ec->slavelist[slave].state > EC_STATE_NONE) {
+                    if (ecx_reconfig_slave(&ec->context, slave, EC_TIMEOUTMON)) {
+                        ec->slavelist[slave].islost = FALSE;
+                        printf("MESSAGE : slave %d reconfigured\n", slave);
+                        publishTopology();
+                    }
+                } else if (!ec->slavelist[slave].islost) {
+                    /* re-check state */
+                    ecx_statecheck(&ec->context, slave, EC_STATE_OPERATIONAL, EC_TIMEOUTRET);
+                    if (ec->slavelist[slave].state == EC_STATE_NONE) {
+                        ec->slavelist[slave].islost = TRUE;
+                        printf("ERROR : slave %d lost\n", slave);
+                    }
+                }
+            }
+            if (ec->slavelist[slave].islost) {
+                if (ec->slavelist[slave].state == EC_STATE_NONE) {
+                    if (ecx_recover_slave(&ec->context, slave, EC_TIMEOUTMON)) {
+                        ec->slavelist[slave].islost = FALSE;
+                        printf("MESSAGE : slave %d recovered\n", slave);
+                        publishTopology();
+                    }
+                } else {
+                    ec->slavelist[slave].islost = FALSE;
+                    printf("MESSAGE : slave %d found\n", slave);
+                }
+            }
+        }
+        if (!ec->grouplist[currentgroup].docheckstate)
+            printf("OK : all slaves resumed OPERATIONAL.\n");
+    }
+    if (inOP && FLAGS_diagnosis && (wkcFaults != diagnosedFaults)) {
+        diagnosedFaults = wkcFaults;
+        diagnose(false);
+    }
+    if (inOP)
+        updateDcMonitor();
+    updateRxCounters();
+}
+
+/********************************************************************************/
+/** Update the system time difference statistics of the DC slaves from the
+*   last sweep of the cyclic frames. Not called from the realtime thread.
+*
+* \return N/A
+*/
+void EcatSegment::updateDcMonitor() {
+    const double alpha = 1.0 / 64; // weight of a sample in the moving statistics
+    int32_t maxDiff = 0;
+
+    if (ecx_readdctime_cyclic(&ec->context, 0) <= 0)
+        return;
+    for (int slave = 1; slave <= ec->slavecount; slave++) {
+        if (!ec->slavelist[slave].hasdc)
+            continue;
+        rocos::SlaveDc &dc = pEcm->ecatBus->slaves[slave - 1].dc;
+        int32_t diff = ec->slavelist[slave].cyclicdctimediff;
+        if (dc.samples == 0) {
+            dc.min_diff = dc.max_diff = diff;
+            dc.mean_diff = diff;
+            dc.std_diff = 0.0;
+        } else {
+            double delta = diff - dc.mean_diff;
+            dc.min_diff = std::min(dc.min_diff, diff);
+            dc.max_diff = std::max(dc.max_diff, diff);
+            dc.mean_diff += alpha * delta;
+            dc.std_diff = std::sqrt((1.0 - alpha) * (dc.std_diff * dc.std_diff + alpha * delta * delta));
+        }
+        dc.time_diff = diff;
+        dc.samples++;
+        maxDiff = std::max(maxDiff, std::abs(diff));
+    }
+    pEcm->ecatBus->dc_max_diff = maxDiff;
+}
+
+/********************************************************************************/
+/** Publish the tree of the slaves, their ports and the propagation delays
+*   found by ecx_configdc in shared memory.
+*
+* \return N/A
+*/
+void EcatSegment::publishTopology() {
+    int refClock = ec->slavelist[0].hasdc ? ec->slavelist[0].DCnext : 0;
+
+    for (int slave = 1; slave <= ec->slavecount; slave++) {
+        const ec_slavet &s = ec->slavelist[slave];
+        rocos::SlaveTopology &topology = pEcm->ecatBus->slaves[slave - 1].topology;
+        int32 rt[4] = {s.DCrtA, s.DCrtB, s.DCrtC, s.DCrtD};
+
+        topology.parent = (int16_t) (s.parent - 1);
+        topology.entry_port = s.entryport;
+        topology.parent_port = s.parentport;
+        topology.active_ports = s.activeports;
+        topology.links = s.topology;
+        topology.has_dc = s.hasdc;
+        topology.reference_clock = (slave == refClock);
+        topology.propagation_delay = s.hasdc ? s.pdelay : 0;
+        topology.link_delay = 0;
+        for (int port = 0; port < 4; port++)
+            topology.port_times[port] = (s.hasdc && (s.activeports & (1 << port))) ? rt[port] - rt[s.entryport] : 0;
+        if (s.hasdc) {
+            /* the DC parent is the nearest slave with DC towards the master */
+            int parent = s.parent;
+            while ((parent > 0) && !ec->slavelist[parent].hasdc)
+                parent = ec->slavelist[parent].parent;
+            if (parent > 0)
+                topology.link_delay = s.pdelay - ec->slavelist[parent].pdelay;
+        }
+    }
+    pEcm->ecatBus->reference_clock = refClock - 1;
+    pEcm->ecatBus->topology_updates++;
+}
+
+/********************************************************************************/
+/** Measure the phase of the frames against the DC reference clock in SAFE_OP,
+*   on the calling thread, after the cycle start has settled on the DC cycle.
+*
+* \return true if the cycle time leaves room for a safe shift
+*/
+bool EcatSegment::calibrateSync0(long cycleNs, long marginNs, int32_t &shift, long &jitter) {
+    const int settleCycles = 1000;
+    EcatSync0Calibration calibration(cycleNs, cycleNs / 2, marginNs);
+    struct timespec wake, sent, received;
+    long offset = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &wake);
+    for (int n = -settleCycles; n < FLAGS_sync0_cycles; n++) {
+        wake.tv_nsec += cycleNs + offset;
+        while (wake.tv_nsec >= 1000000000L) {
+            wake.tv_nsec -= 1000000000L;
+            wake.tv_sec++;
+        }
+        while (wake.tv_nsec < 0) {
+            wake.tv_nsec += 1000000000L;
+            wake.tv_sec--;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, nullptr);
+
+        clock_gettime(CLOCK_MONOTONIC, &sent);
+        ecx_send_processdata(&ec->context);
+        wkc = ecx_receive_processdata(&ec->context, EC_TIMEOUTRET100);
+        clock_gettime(CLOCK_MONOTONIC, &received);
+        if ((n >= 0) && (wkc > 0))
+            calibration.addSample(*ec->context.DCtime, (received.tv_sec - sent.tv_sec) * 1000000000L +
+                                                       (received.tv_nsec - sent.tv_nsec));
+        offset = dcOffset(cycleNs);
+    }
+
+    jitter = calibration.jitter();
+    if (!calibration.shift(shift)) {
+        printf("Sync0 of segment %d not activated: %d us cycle too short for %ld us jitter, %ld us round trip\n",
+               segmentId, (int) (cycleNs / 1000), jitter / 1000, calibration.maxRoundTrip() / 1000);
+        return false;
+    }
+    printf("Sync0 shift %d us of segment %d calibrated over %d cycles: jitter %ld us, round trip %ld us\n",
+           shift / 1000, segmentId, calibration.samples(), jitter / 1000, calibration.maxRoundTrip() / 1000);
+
+    return true;
+}
+
+/********************************************************************************/
+/** PI controller of the cycle start on the DC time of the last frame, as in
+*   the SOEM examples. Frames are held in the middle of the DC cycle.
+*
+* \return correction of the next cycle start in ns
+*/
+long EcatSegment::dcOffset(long cycleNs) {
+    if (!sync0Active || (wkc <= 0))
+        return 0;
+
+    int64 delta = (*ec->context.DCtime - cycleNs / 2) % cycleNs;
+    if (delta > cycleNs / 2)
+        delta -= cycleNs;
+    if (delta > 0)
+        dcIntegral++;
+    if (delta < 0)
+        dcIntegral--;
+
+    return (long) (-(delta / 100) - (dcIntegral / 20));
+}
+
+/********************************************************************************/
+/** Turn direct receive off if the inputs are spread over several frames. A
+*   cycle with a low work counter in one of them would leave the inputs of the
+*   other frames in the image, mixed with those of the last good cycle. The
+*   inputs then go through the IOmap and are copied on good cycles only. Call
+*   after the first process data exchange.
+*
+* \return N/A
+*/
+void EcatSegment::checkDirectRx() {
+    const ec_plant &plan = ec->grouplist[0].plan;
+    int frames = 0;
+
+    if (!directRx)
+        return;
+    for (int frame = 0; frame < plan.nframes; frame++) {
+        if (plan.frame[frame].rxdest)
+            frames++;
+    }
+    if (frames > 1) {
+        ecx_set_inputs_destination(&ec->context, 0, nullptr);
+        directRx = false;
+        printf("Inputs of segment %d are in %d frames, direct receive is off\n", segmentId, frames);
+    }
+}
+
+/********************************************************************************/
+/** Find the slaves with data in each frame of the cycle, from the compiled
+*   frames of the group. Call after the first process data exchange.
+*
+* \return N/A
+*/
+void EcatSegment::mapFrameSlaves() {
+    const ec_plant &plan = ec->grouplist[0].plan;
+
+    frameSlaves.assign(plan.nframes, std::vector<uint16>());
+    for (int frame = 0; frame < plan.nframes; frame++) {
+        for (uint16 slave = 1; slave <= ec->slavecount; slave++) {
+            if (ecx_plan_slavewkc(&ec->context, 0, frame, slave) > 0)
+                frameSlaves[frame].push_back(slave);
+        }
+    }
+}
+
+/********************************************************************************/
+/** Mark the slaves behind every frame that returned with a low work counter.
+*   Called from the realtime thread, only writes shared memory.
+*
+* \return N/A
+*/
+void EcatSegment::attributeWkc() {
+    const ec_plant &plan = ec->grouplist[0].plan;
+    int faultFrames = 0;
+
+    if (lastCycleFaulty) {
+        for (int i = 0; i < ec->slavecount; i++)
+            pEcm->ecatBus->slaves[i].health.wkc_fault = false;
+    }
+    for (int frame = 0; frame < plan.nframes && frame < (int) frameSlaves.size(); frame++) {
+        if (plan.frame[frame].wkc >= plan.frame[frame].expectedwkc)
+            continue;
+        faultFrames++;
+        for (uint16 slave: frameSlaves[frame]) {
+            rocos::SlaveHealth &health = pEcm->ecatBus->slaves[slave - 1].health;
+            if (!health.wkc_fault) {
+                health.wkc_fault = true;
+                health.wkc_error_count++;
+            }
+        }
+    }
+    pEcm->ecatBus->wkc_fault_frames = faultFrames;
+    lastCycleFaulty = (faultFrames > 0);
+}
+
+/********************************************************************************/
+/** Read AL status and ESC error counters of all slaves into the health table.
+*   The first slave that is lost, not in OP or has rising error counters is
+*   published as suspect, else the first slave of a faulty frame. Not called
+*   from the realtime thread.
+*
+* \param baseline  only record the counters, f.e. when going operational
+* \return N/A
+*/
+void EcatSegment::diagnose(bool baseline) {
+    uint8 esc[ECT_REG_LLCNT + 4 - ECT_REG_RXERR];
+    int suspect = -1, wkcSuspect = -1;
+    long now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+
+    ecx_readstate(&ec->context);
+    for (int slave = 1; slave <= ec->slavecount; slave++) {
+        rocos::SlaveHealth &health = pEcm->ecatBus->slaves[slave - 1].health;
+        health.al_state = ec->slavelist[slave].state;
+        health.al_status_code = ec->slavelist[slave].ALstatuscode;
+        health.lost = ec->slavelist[slave].islost || (ec->slavelist[slave].state == EC_STATE_NONE);
+
+        /* 0x0300 invalid frame and rx error per port, 0x0308 forwarded rx error,
+         * 0x030C processing unit error, 0x030D PDI error, 0x0310 lost link */
+        memset(esc, 0, sizeof(esc));
+        if (ecx_FPRD(&ec->port, ec->slavelist[slave].configadr, ECT_REG_RXERR, sizeof(esc), esc,
+                     EC_TIMEOUTRET) > 0) {
+            uint8 processing = esc[ECT_REG_EPUECNT - ECT_REG_RXERR];
+            uint8 pdi = esc[ECT_REG_PECNT - ECT_REG_RXERR];
+            bool rising = (processing > health.processing_errors) || (pdi > health.pdi_errors);
+            for (int port = 0; port < 4; port++) {
+                uint8 invalid = esc[2 * port];
+                uint8 rx = esc[2 * port + 1];
+                uint8 forwarded = esc[ECT_REG_FRXERR - ECT_REG_RXERR + port];
+                uint8 lostLink = esc[ECT_REG_LLCNT - ECT_REG_RXERR + port];
+                rising = rising || (invalid > health.invalid_frames[port]) || (rx > health.rx_errors[port]) ||
+                         (forwarded > health.forwarded_errors[port]) || (lostLink > health.lost_links[port]);
+                health.invalid_frames[port] = invalid;
+                health.rx_errors[port] = rx;
+                health.forwarded_errors[port] = forwarded;
+                health.lost_links[port] = lostLink;
+            }
+            health.processing_errors = processing;
+            health.pdi_errors = pdi;
+            health.counters_rising = rising && !baseline;
+        }
+        health.timestamp = now;
+
+        if ((suspect < 0) && (health.lost || health.counters_rising ||
+                              ((health.al_state & 0x0f) != EC_STATE_OPERATIONAL)))
+            suspect = slave - 1;
+        if ((wkcSuspect < 0) && health.wkc_fault)
+            wkcSuspect = slave - 1;
+    }
+    pEcm->ecatBus->suspect_slave = baseline ? -1 : (suspect >= 0 ? suspect : wkcSuspect);
+}
+
+/********************************************************************************/
+/** Count a late cycle in shared memory. Called from the realtime thread.
+*
+* \param cycleNs  time the late cycle took
+* \return N/A
+*/
+void EcatSegment::reportOverrun(long cycleNs) {
+    if (!pEcm)
+        return;
+    pEcm->ecatBus->overrun_count++;
+    pEcm->ecatBus->last_overrun = cycleNs / 1000.0;
+}
+
+/********************************************************************************/
+/** Publish kernel receive counters in shared memory.
+*
+* \return N/A
+*/
+void EcatSegment::updateRxCounters() {
+    if (!pEcm)
+        return;
+
+    ec_rxstatt rxstat;
+    ecx_rxstats(&ec->port, &rxstat);
+    pEcm->ecatBus->rx_statistics.packets = rxstat.packets;
+    pEcm->ecatBus->rx_statistics.drops = rxstat.drops;
+    pEcm->ecatBus->rx_statistics.other_frames = rxstat.otherframes;
+}
+
+/********************************************************************************/
+/** Publish redundancy state of the last cycle in shared memory.
+*
+* \return N/A
+*/
+void EcatSegment::updateRedundancy() {
+    rocos::EcatRedundancy &red = pEcm->ecatBus->redundancy;
+    const ec_redstatt &stat = ec->port.redstat;
+
+    if (!red.enabled)
+        return;
+
+    red.line_break = stat.linebreak;
+    red.rx_ports = stat.rxports;
+    red.line_break_count = stat.linebreaks;
+    red.resend_count = stat.resends;
+    red.extra_latency = (stat.extratime - lastExtraTime) / 1000.0;
+    red.max_extra_latency = std::max(red.max_extra_latency, red.extra_latency);
+    lastExtraTime = stat.extratime;
+}
+
+/********************************************************************************/
+/** Publish work counter and receive copy statistics of the last cycle in shared memory.
+*
+* \return N/A
+*/
+void EcatSegment::updateRxStatistics() {
+    const ec_copystatt &stat = ec->port.copystat;
+
+    pEcm->ecatBus->wkc = wkc;
+    pEcm->ecatBus->expected_wkc = expectedWKC;
+    pEcm->ecatBus->rx_statistics.copies_per_cycle = stat.copies - lastCopyStat.copies;
+    pEcm->ecatBus->rx_statistics.copy_bytes_per_cycle = stat.bytes - lastCopyStat.bytes;
+    lastCopyStat = stat;
+}
+
+bool EcatSegment::captureRequested() {
+    if (!pEcm || !pEcm->ecatBus->capture_request)
+        return false;
+    pEcm->ecatBus->capture_request = false;
+    return true;
+}
+
+/********************************************************************************/
+/** Write the capture ring to a pcapng file, not from the realtime thread.
+*
+* \return number of frames written, -1 on error
+*/
+int EcatSegment::dumpCapture(const string &dir) {
+    char fileName[MAX_FILE_NAME_LEN];
+    snprintf(fileName, sizeof(fileName), "%s/rocos_soem%d_%ld.pcapng", dir.c_str(), segmentId,
+             (long) time(nullptr));
+    int frames = ecx_capture_dump(&ec->port, fileName);
+    if (frames < 0) {
+        std::cerr << "Capture dump to " << fileName << " failed" << std::endl;
+        return frames;
+    }
+    std::cout << "Capture dump: " << frames << " frames written to " << fileName << std::endl;
+    if (pEcm) {
+        snprintf(pEcm->ecatBus->capture_file, sizeof(pEcm->ecatBus->capture_file), "%s", fileName);
+        pEcm->ecatBus->capture_dump_count++;
+    }
+
+    return frames;
+}
+
+void EcatSegment::close() {
+    if (!ec->port.stack.link)
+        return;
+    inOP = false;
+    ecx_capture_close(&ec->port);
+    ecx_close(&ec->context);
+}
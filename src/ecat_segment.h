@@ -0,0 +1,173 @@
+/*
+Copyright 2021, Yang Luo"
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+@Author
+Yang Luo, PHD
+@email: yluo@hit.edu.cn
+
+@Created on: 2024.03.31
+@Last Modified: 2024.03.31
+*/
+
+#ifndef ROCOS_SOEM_ECAT_SEGMENT_H
+#define ROCOS_SOEM_ECAT_SEGMENT_H
+
+#include "ecat_context.h"
+#include "ecat_sdo_reader.h"
+#include <ecat_config_master.h>
+
+#include <string>
+#include <vector>
+
+/** One EtherCAT segment: the slaves behind one network interface, or behind a
+ * pair of interfaces with cable redundancy. Every segment has its own SOEM
+ * context and its own shared memory namespace (ecm<id>, pd_input<id>,
+ * pd_output<id>), so one process can run several segments.
+ */
+class EcatSegment {
+    using string = std::string;
+public:
+    EcatSegment(int id, const string &ifname, const string &if2name = "");
+    ~EcatSegment();
+
+    EcatSegment(const EcatSegment &) = delete;
+    EcatSegment &operator=(const EcatSegment &) = delete;
+
+    /** Open the interface, configure the slaves and publish them in shared memory. */
+    bool init(bool printSDO = false);
+
+    /** Activate Sync0 on the DC slaves, with the stored shift of this topology
+     *  and cycle time or with a shift calibrated in SAFE_OP. Call before goOperational(). */
+    bool setupSync0(long cycleNs);
+
+    /** Request OP for all slaves. */
+    bool goOperational();
+
+    /** One process data exchange, called by the realtime scheduler. @return work counter */
+    int cycle();
+
+    /** One pass of slave supervision, called from the non realtime check thread. */
+    void check();
+
+    /** Write the capture ring to a pcapng file in dir. @return number of frames or -1 */
+    int dumpCapture(const string &dir);
+
+    /** Take a capture dump request from shared memory. */
+    bool captureRequested();
+
+    /** Count a late cycle of the realtime scheduler in shared memory. */
+    void reportOverrun(long cycleNs);
+
+    /** Correction of the next cycle start in ns, so the frames pass the DC
+     *  reference clock in the middle of the DC cycle. 0 without Sync0. */
+    long dcOffset(long cycleNs);
+
+    void close();
+
+    int id() const { return segmentId; }
+    const string &ifname() const { return ifName; }
+    ecx_contextt *context() { return &ec->context; }
+    int slaveCount() const { return ec->slavecount; }
+    bool isOperational() const { return inOP; }
+    bool hasSync0() const { return sync0Active; }
+
+private:
+    string dtype2string(uint16 dtype);
+    string SDO2string(uint16 slave, uint16 index, uint8 subidx, uint16 dtype);
+    /** PDO mapping of one slave read over CoE, before it is published in shared memory */
+    struct SlaveMapping {
+        std::vector<rocos::PdVar> inputs;
+        std::vector<rocos::PdVar> outputs;
+        bool smTypeWorkaround {false};
+        std::vector<uint32_t> key;  // identity and configured mapping, empty if not cacheable
+        bool cached {false};        // taken from the PDO layout cache
+    };
+
+    /** Read PDO assign structure */
+    int si_PDOassign(uint16 slave, uint16 PDOassign, int mapoffset, int bitoffset, std::vector<rocos::PdVar> &pdVar);
+    int si_map_sdo(int slave, SlaveMapping &mapping);
+    bool readMappingKey(int slave, std::vector<uint32_t> &key);
+    void slaveOffsets(int slave, int &inOffset, int &outOffset);
+    void mapSlaves();
+    void publishMapping(int slave, const SlaveMapping &mapping);
+    int si_siiPDO(uint16 slave, uint8 t, int mapoffset, int bitoffset);
+    void si_sdo(int cnt);
+
+    void updateRedundancy();
+    void updateRxStatistics();
+    void beginInputUpdate();
+    void endInputUpdate();
+    void abortInputUpdate();
+    void setupChangeMap();
+    void updateChangeMap();
+    void copyOutputs();
+    void updateRxCounters();
+    void mapFrameSlaves();
+    void checkDirectRx();
+    void attributeWkc();
+    void diagnose(bool baseline);
+    void updateDcMonitor();
+    void publishTopology();
+    bool calibrateSync0(long cycleNs, long marginNs, int32_t &shift, long &jitter);
+
+    int segmentId;
+    string ifName;
+    string if2Name;
+
+    EcatContext *ec {nullptr};
+    EcatConfigMaster *pEcm {nullptr};
+    EcatSdoReader *sdoReader {nullptr}; // PDO assign and mapping, with complete access where supported
+
+    uint8 *IOmap {nullptr}; // sized to the mapping of the discovered slaves
+    int IOmapSize {0};
+
+    ec_ODlistt ODlist;
+    ec_OElistt OElist;
+    char usdo[128];
+
+    bool directRx {false};          // inputs are received into the PD memory, see --direct_rx
+    int expectedWKC {0};
+    volatile int wkc {0};
+    uint64 cycleCount {0};
+    volatile bool inOP {false};
+    volatile uint32 wkcFaults {0};   // cycles with a low work counter, written by the realtime thread
+    uint32 diagnosedFaults {0};
+    int dcDriftDatagrams {0};
+    bool sync0Active {false};       // the cycle start follows the DC reference clock
+    int64 dcIntegral {0};
+    uint8 currentgroup {0};
+
+    // input change map, see EcatChangeMap
+    struct ChangeVar {
+        int offset;
+        int size;
+        int bit;
+        int slave;
+    };
+    std::vector<ChangeVar> changeVars;
+    std::vector<uint8> previousInputs;  // input image of the previous cycle, whole vectors
+    std::vector<uint8> changedBytes;    // bit per byte of the image that changed, 8 bytes spare for word reads
+    std::vector<uint64> changeBits;
+    uint64 lastImageCycle {0};
+
+    uint64 lastExtraTime {0};
+    ec_copystatt lastCopyStat {0, 0};
+
+    std::vector<std::vector<uint16>> frameSlaves; // slaves with data in each frame of the cycle
+    bool lastCycleFaulty {false};
+};
+
+
+#endif //ROCOS_SOEM_ECAT_SEGMENT_H
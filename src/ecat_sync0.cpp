@@ -0,0 +1,108 @@
+//
+// Created by think on 3/31/24.
+//
+
+#include "ecat_sync0.h"
+
+#include <cinttypes>
+#include <cstdio>
+#include <sys/stat.h>
+
+EcatSync0Calibration::EcatSync0Calibration(long cycleNs, long phaseNs, long marginNs)
+        : cycle(cycleNs), phase(phaseNs), margin(marginNs) {
+}
+
+void EcatSync0Calibration::addSample(int64_t dcTime, long roundTripNs) {
+    /* phase of the frame relative to the held phase, in (-cycle / 2, cycle / 2] */
+    long d = (long) ((dcTime - phase) % cycle);
+    if (d < 0)
+        d += cycle;
+    if (d > cycle / 2)
+        d -= cycle;
+
+    if (count == 0) {
+        minPhase = maxPhase = d;
+        maxRtt = roundTripNs;
+    } else {
+        if (d < minPhase)
+            minPhase = d;
+        if (d > maxPhase)
+            maxPhase = d;
+        if (roundTripNs > maxRtt)
+            maxRtt = roundTripNs;
+    }
+    count++;
+}
+
+bool EcatSync0Calibration::shift(int32_t &shiftNs) const {
+    if (count == 0)
+        return false;
+    /* Sync0 before the earliest frame, and a cycle later after the latest frame left the last slave */
+    long latest = phase + minPhase - margin;
+    long earliest = phase + maxPhase + maxRtt / 2 + margin - cycle;
+    if (latest < earliest)
+        return false;
+    shiftNs = (int32_t) latest;
+
+    return true;
+}
+
+EcatSync0Calibration::string EcatSync0Calibration::fileName(const string &dir, const std::vector<uint32_t> &key) {
+    /* FNV-1a of the key */
+    uint32_t hash = 2166136261u;
+    for (uint32_t k: key) {
+        for (int b = 0; b < 4; b++) {
+            hash ^= (k >> (8 * b)) & 0xff;
+            hash *= 16777619u;
+        }
+    }
+    char name[32];
+    snprintf(name, sizeof(name), "/sync0_%08x.txt", hash);
+
+    return dir + name;
+}
+
+bool EcatSync0Calibration::load(const string &dir, const std::vector<uint32_t> &key, int32_t &shiftNs) {
+    FILE *f = fopen(fileName(dir, key).c_str(), "r");
+    if (!f)
+        return false;
+
+    /* key words, then the shift */
+    bool ok = true;
+    unsigned int n = 0;
+    ok = (fscanf(f, "%u", &n) == 1) && (n == key.size());
+    for (size_t i = 0; ok && i < key.size(); i++) {
+        unsigned int k;
+        ok = (fscanf(f, "%x", &k) == 1) && (k == key[i]);
+    }
+    int32_t value;
+    ok = ok && (fscanf(f, "%" SCNd32, &value) == 1);
+    fclose(f);
+    if (ok)
+        shiftNs = value;
+
+    return ok;
+}
+
+bool EcatSync0Calibration::save(const string &dir, const std::vector<uint32_t> &key, int32_t shiftNs) {
+    mkdir(dir.c_str(), 0755);
+
+    string name = fileName(dir, key);
+    string tmpName = name + ".tmp";
+    FILE *f = fopen(tmpName.c_str(), "w");
+    if (!f)
+        return false;
+
+    bool ok = fprintf(f, "%u\n", (unsigned int) key.size()) > 0;
+    for (uint32_t k: key)
+        ok = ok && (fprintf(f, "%08x\n", k) > 0);
+    ok = ok && (fprintf(f, "%" PRId32 "\n", shiftNs) > 0);
+    ok = (fclose(f) == 0) && ok;
+    /* replace the old file only with a complete one */
+    if (!ok || (rename(tmpName.c_str(), name.c_str()) != 0)) {
+        remove(tmpName.c_str());
+        return false;
+    }
+
+    return true;
+}
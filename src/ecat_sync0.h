@@ -0,0 +1,76 @@
+/*
+Copyright 2021, Yang Luo"
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+@Author
+Yang Luo, PHD
+@email: yluo@hit.edu.cn
+
+@Created on: 2024.03.31
+@Last Modified: 2024.03.31
+*/
+
+#ifndef ROCOS_SOEM_ECAT_SYNC0_H
+#define ROCOS_SOEM_ECAT_SYNC0_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/** Sync0 shift calibration. Collects, per cycle, the phase at which the frame
+ * passed the DC reference clock and the round trip of the frame. The latest
+ * safe Sync0 shift fires margin before the earliest frame, so the inputs are
+ * latched just before they are read. The outputs of the frame are applied at
+ * the next Sync0, which must come margin after the latest frame passed the
+ * last slave, estimated as half of the longest round trip.
+ *
+ * A calibrated shift is stored per key (cycle time, margin and topology), so a
+ * changed network or cycle time is calibrated again.
+ */
+class EcatSync0Calibration {
+    using string = std::string;
+public:
+    /** Frames are held at phase of the DC cycle by the master, see EcatSegment::dcOffset(). */
+    EcatSync0Calibration(long cycleNs, long phaseNs, long marginNs);
+
+    /** One cycle: DC system time read by the frame and the round trip in ns. */
+    void addSample(int64_t dcTime, long roundTripNs);
+
+    int samples() const { return count; }
+    long jitter() const { return count ? maxPhase - minPhase : 0; }  //!< spread of the phase, ns
+    long maxRoundTrip() const { return maxRtt; }                      //!< ns
+
+    /** Latest safe Sync0 shift in ns. @return false if the cycle is too short for round trip, jitter and margin */
+    bool shift(int32_t &shiftNs) const;
+
+    /** Calibrated shift of key in dir. @return true if found */
+    static bool load(const string &dir, const std::vector<uint32_t> &key, int32_t &shiftNs);
+
+    /** Store the shift of key in dir. @return true if written */
+    static bool save(const string &dir, const std::vector<uint32_t> &key, int32_t shiftNs);
+
+private:
+    static string fileName(const string &dir, const std::vector<uint32_t> &key);
+
+    long cycle;
+    long phase;
+    long margin;
+    int count {0};
+    long minPhase {0};   // relative to phase, ns
+    long maxPhase {0};
+    long maxRtt {0};
+};
+
+
+#endif //ROCOS_SOEM_ECAT_SYNC0_H
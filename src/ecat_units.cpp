@@ -0,0 +1,236 @@
+//
+// Created by think on 2024/04/03.
+//
+
+#include <ecat_units.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define UNITS_X86
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define UNITS_NEON
+#endif
+
+using namespace rocos;
+
+UnitConverter::UnitConverter(int imageSize, bool vectorised) : imageSize(imageSize) {
+#if defined(UNITS_X86)
+    if (vectorised && __builtin_cpu_supports("avx2"))
+        kernelType = KERNEL_AVX2;
+#elif defined(UNITS_NEON)
+    if (vectorised)
+        kernelType = KERNEL_NEON;
+#else
+    (void) vectorised;
+#endif
+}
+
+int UnitConverter::addChannel(int byteOffset, Type type, double scale, double offset, double gear) {
+    int bytes = (type == INT16) ? 2 : 4;
+    if ((byteOffset < 0) || (byteOffset + bytes > imageSize))
+        return -1;
+
+    /* the vector kernels load the 32 bit word holding the channel, an INT16
+     * in the low half if the word fits in the image, else in the high half */
+    int32_t word = byteOffset, left = 0, right = 0;
+    if (type == INT16) {
+        if (byteOffset + 4 <= imageSize) {
+            left = 16;
+            right = 16;
+        } else if (byteOffset >= 2) {
+            word = byteOffset - 2;
+            right = 16;
+        } else {
+            kernelType = KERNEL_SCALAR; // image of less than 4 bytes
+        }
+    }
+
+    this->type.push_back((uint8_t) type);
+    this->byteOffset.push_back(byteOffset);
+    window.push_back(word);
+    shiftLeft.push_back(left);
+    shiftRight.push_back(right);
+    factor.push_back(scale / gear);
+    this->offset.push_back(offset);
+    inverse.push_back(gear / scale);
+    rawOffset.push_back(-offset * gear / scale);
+    rawMin.push_back(type == INT16 ? INT16_MIN : INT32_MIN);
+    rawMax.push_back(type == INT16 ? INT16_MAX : INT32_MAX);
+
+    return size() - 1;
+}
+
+const char *UnitConverter::kernel() const {
+    switch (kernelType) {
+        case KERNEL_AVX2:
+            return "avx2";
+        case KERNEL_NEON:
+            return "neon";
+        default:
+            return "scalar";
+    }
+}
+
+void UnitConverter::toUnits(const void *image, double *values) const {
+    const uint8_t *bytes = static_cast<const uint8_t *>(image);
+
+    switch (kernelType) {
+        case KERNEL_AVX2:
+            toUnitsAvx2(bytes, values);
+            break;
+        case KERNEL_NEON:
+            toUnitsNeon(bytes, values);
+            break;
+        default:
+            toUnitsScalar(bytes, values, 0);
+            break;
+    }
+}
+
+void UnitConverter::toRaw(const double *values, void *image) const {
+    uint8_t *bytes = static_cast<uint8_t *>(image);
+
+    switch (kernelType) {
+        case KERNEL_AVX2:
+            toRawAvx2(values, bytes);
+            break;
+        case KERNEL_NEON:
+            toRawNeon(values, bytes);
+            break;
+        default:
+            toRawScalar(values, bytes, 0);
+            break;
+    }
+}
+
+/** Channels from first to the end, also the tail of the vector kernels. */
+void UnitConverter::toUnitsScalar(const uint8_t *image, double *values, int first) const {
+    for (int i = first; i < size(); ++i) {
+        int32_t raw;
+        if (type[i] == INT16) {
+            int16_t v;
+            memcpy(&v, image + byteOffset[i], sizeof(v));
+            raw = v;
+        } else {
+            memcpy(&raw, image + byteOffset[i], sizeof(raw));
+        }
+        values[i] = raw * factor[i] + offset[i];
+    }
+}
+
+void UnitConverter::toRawScalar(const double *values, uint8_t *image, int first) const {
+    for (int i = first; i < size(); ++i) {
+        double r = std::min(std::max(values[i] * inverse[i] + rawOffset[i], rawMin[i]), rawMax[i]);
+        if (type[i] == INT16) {
+            int16_t v = (int16_t) std::lrint(r);
+            memcpy(image + byteOffset[i], &v, sizeof(v));
+        } else {
+            int32_t v = (int32_t) std::lrint(r);
+            memcpy(image + byteOffset[i], &v, sizeof(v));
+        }
+    }
+}
+
+#if defined(UNITS_X86)
+
+/* four channels per vector. The words are loaded one by one, the gather
+ * instruction is slower for four elements on most CPUs. */
+__attribute__((target("avx2")))
+void UnitConverter::toUnitsAvx2(const uint8_t *image, double *values) const {
+    int i = 0;
+    for (; i + 4 <= size(); i += 4) {
+        int32_t words[4];
+        for (int j = 0; j < 4; ++j)
+            memcpy(&words[j], image + window[i + j], sizeof(int32_t));
+        __m128i raw = _mm_loadu_si128((const __m128i *) words);
+        raw = _mm_sllv_epi32(raw, _mm_loadu_si128((const __m128i *) &shiftLeft[i]));
+        raw = _mm_srav_epi32(raw, _mm_loadu_si128((const __m128i *) &shiftRight[i]));
+        __m256d v = _mm256_cvtepi32_pd(raw);
+        v = _mm256_add_pd(_mm256_mul_pd(v, _mm256_loadu_pd(&factor[i])), _mm256_loadu_pd(&offset[i]));
+        _mm256_storeu_pd(&values[i], v);
+    }
+    _mm256_zeroupper(); // the tail runs SSE code
+    toUnitsScalar(image, values, i);
+}
+
+/* four channels per vector, rounded to nearest by the conversion */
+__attribute__((target("avx2")))
+void UnitConverter::toRawAvx2(const double *values, uint8_t *image) const {
+    int i = 0;
+    for (; i + 4 <= size(); i += 4) {
+        __m256d r = _mm256_add_pd(_mm256_mul_pd(_mm256_loadu_pd(&values[i]), _mm256_loadu_pd(&inverse[i])),
+                                  _mm256_loadu_pd(&rawOffset[i]));
+        r = _mm256_min_pd(_mm256_max_pd(r, _mm256_loadu_pd(&rawMin[i])), _mm256_loadu_pd(&rawMax[i]));
+        int32_t raw[4];
+        _mm_storeu_si128((__m128i *) raw, _mm256_cvtpd_epi32(r));
+        for (int j = 0; j < 4; ++j)
+            memcpy(image + byteOffset[i + j], &raw[j], type[i + j] == INT16 ? 2 : 4);
+    }
+    _mm256_zeroupper();
+    toRawScalar(values, image, i);
+}
+
+#else
+
+void UnitConverter::toUnitsAvx2(const uint8_t *image, double *values) const {
+    toUnitsScalar(image, values, 0);
+}
+
+void UnitConverter::toRawAvx2(const double *values, uint8_t *image) const {
+    toRawScalar(values, image, 0);
+}
+
+#endif
+
+#if defined(UNITS_NEON)
+
+/* four channels per iteration, two per vector */
+void UnitConverter::toUnitsNeon(const uint8_t *image, double *values) const {
+    int i = 0;
+    for (; i + 4 <= size(); i += 4) {
+        int32_t words[4];
+        for (int j = 0; j < 4; ++j)
+            memcpy(&words[j], image + window[i + j], sizeof(int32_t));
+        int32x4_t raw = vld1q_s32(words);
+        raw = vshlq_s32(raw, vld1q_s32(&shiftLeft[i]));
+        raw = vshlq_s32(raw, vnegq_s32(vld1q_s32(&shiftRight[i]))); // arithmetic right shift
+        float64x2_t lo = vcvtq_f64_s64(vmovl_s32(vget_low_s32(raw)));
+        float64x2_t hi = vcvtq_f64_s64(vmovl_high_s32(raw));
+        lo = vaddq_f64(vmulq_f64(lo, vld1q_f64(&factor[i])), vld1q_f64(&offset[i]));
+        hi = vaddq_f64(vmulq_f64(hi, vld1q_f64(&factor[i + 2])), vld1q_f64(&offset[i + 2]));
+        vst1q_f64(&values[i], lo);
+        vst1q_f64(&values[i + 2], hi);
+    }
+    toUnitsScalar(image, values, i);
+}
+
+void UnitConverter::toRawNeon(const double *values, uint8_t *image) const {
+    int i = 0;
+    for (; i + 2 <= size(); i += 2) {
+        float64x2_t r = vaddq_f64(vmulq_f64(vld1q_f64(&values[i]), vld1q_f64(&inverse[i])),
+                                  vld1q_f64(&rawOffset[i]));
+        r = vminq_f64(vmaxq_f64(r, vld1q_f64(&rawMin[i])), vld1q_f64(&rawMax[i]));
+        int64x2_t q = vcvtnq_s64_f64(r); // rounded to nearest
+        int32_t raw[2] = {(int32_t) vgetq_lane_s64(q, 0), (int32_t) vgetq_lane_s64(q, 1)};
+        for (int j = 0; j < 2; ++j)
+            memcpy(image + byteOffset[i + j], &raw[j], type[i + j] == INT16 ? 2 : 4);
+    }
+    toRawScalar(values, image, i);
+}
+
+#else
+
+void UnitConverter::toUnitsNeon(const uint8_t *image, double *values) const {
+    toUnitsScalar(image, values, 0);
+}
+
+void UnitConverter::toRawNeon(const double *values, uint8_t *image) const {
+    toRawScalar(values, image, 0);
+}
+
+#endif
@@ -0,0 +1,84 @@
+/*
+Copyright 2021, Yang Luo"
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+@Author
+Yang Luo, PHD
+@email: yluo@hit.edu.cn
+*/
+
+
+/*-----------------------------------------------------------------------------
+ * bench_image.cpp
+ * Description              Cycle time cost against network size
+ *
+ * Runs the process data cycle over an in-process mem link with 10, 100 and 500
+ * simulated slaves. The IOmap and the input image are allocated with the size
+ * of the mapping, as the master does after configuration, so the cycle cost
+ * follows the process image while the frame pool and group tables keep their
+ * compile time size. Usage: bench_image [cycles] [pdbytes per slave]
+ *---------------------------------------------------------------------------*/
+
+#include "sim_bus.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace sim;
+
+int main(int argc, char *argv[]) {
+    int cycles = argc > 1 ? atoi(argv[1]) : 20000;
+    int pdbytes = argc > 2 ? atoi(argv[2]) : 8;
+    const int sizes[] = {10, 100, 500};
+
+    printf("%d cycles, %d bytes process data per slave and direction\n", cycles, pdbytes);
+    printf("compile time maxima: EC_MAXBUF %d, EC_MAXIOSEGMENTS %d, port %zu bytes, group %zu bytes\n",
+           EC_MAXBUF, EC_MAXIOSEGMENTS, sizeof(ecx_portt), sizeof(ec_groupt));
+
+    for (int slaves: sizes) {
+        if (!ec_init("mem:bench_image")) {
+            printf("mem link not available\n");
+            return 1;
+        }
+        SimBus bus(slaves);
+        ec_memlink_sethook("bench_image", simHook, &bus);
+
+        /* IOmap of the exact size, as ec_config_map_alloc allocates it */
+        uint8 *IOmap = static_cast<uint8 *>(calloc(1, 2 * slaves * pdbytes));
+        int expectedWKC = setupGroup(slaves, slaves * pdbytes, slaves * pdbytes, IOmap);
+        if (expectedWKC < 0 || ec_group[0].nsegments >= EC_MAXBUF) {
+            printf("%4d slaves: process image does not fit EC_MAXIOSEGMENTS/EC_MAXBUF\n", slaves);
+            free(IOmap);
+            ec_close();
+            continue;
+        }
+        /* inputs straight into an image of the mapped size, as the master does */
+        std::vector<uint8> inputs(ec_group[0].Ibytes);
+        ec_set_inputs_destination(0, inputs.data());
+
+        Result r = runCycles(cycles, expectedWKC);
+        int image = ec_group[0].Obytes + ec_group[0].Ibytes;
+        printf("%4d slaves: IOmap %6d bytes, %2d frames  avg %7.2f us  p50 %7.2f us  p99 %7.2f us  max %8.2f us"
+               "  %6.2f ns/byte  wkc errors %d\n",
+               slaves, image, ec_group[0].nsegments, r.avg, r.p50, r.p99, r.max,
+               r.avg * 1e3 / image, r.errors);
+
+        ec_set_inputs_destination(0, nullptr);
+        ec_close();
+        free(IOmap);
+    }
+
+    return 0;
+}
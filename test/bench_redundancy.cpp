@@ -0,0 +1,90 @@
+/*
+Copyright 2021, Yang Luo"
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+@Author
+Yang Luo, PHD
+@email: yluo@hit.edu.cn
+*/
+
+
+/*-----------------------------------------------------------------------------
+ * bench_redundancy.cpp
+ * Description              Cycle time cost of cable redundancy
+ *
+ * Runs the process data cycle over in-process mem links with simulated slaves
+ * and compares single port, redundant with closed ring and redundant with
+ * line break. Usage: bench_redundancy [cycles] [slaves] [pdbytes]
+ *---------------------------------------------------------------------------*/
+
+#include "sim_bus.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+using namespace sim;
+
+namespace {
+
+    uint8 IOmap[EC_MAXBUF * EC_MAXLRWDATA];
+
+    void printResult(const char *name, const Result &r, double base) {
+        printf("%-22s avg %7.2f us  p50 %7.2f us  p99 %7.2f us  max %8.2f us  +%6.2f us/cycle  wkc errors %d\n",
+               name, r.avg, r.p50, r.p99, r.max, r.avg - base, r.errors);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int cycles = argc > 1 ? atoi(argv[1]) : 100000;
+    int slaves = argc > 2 ? atoi(argv[2]) : 16;
+    int pdbytes = argc > 3 ? atoi(argv[3]) : 256;
+
+    SimBus line(slaves);
+    SimBus ring(slaves, true);
+    ec_memlink_sethook("bench_line", simHook, &line);
+    ec_memlink_sethook("bench_ring", simHook, &ring);
+
+    printf("%d cycles, %d slaves, %d bytes process data per direction\n", cycles, slaves, pdbytes);
+
+    /* single port, last slave closes the line */
+    if (!ec_init("mem:bench_line")) {
+        printf("mem link not available\n");
+        return 1;
+    }
+    int expectedWKC = setupGroup(slaves, pdbytes, pdbytes, IOmap);
+    Result single = runCycles(cycles, expectedWKC);
+    ec_close();
+    printResult("single port", single, single.avg);
+
+    /* redundant, both ports on the same ring */
+    char if2name[] = "mem:bench_ring";
+    if (!ec_init_redundant("mem:bench_ring", if2name)) {
+        printf("redundant mem link not available\n");
+        return 1;
+    }
+    expectedWKC = setupGroup(slaves, pdbytes, pdbytes, IOmap);
+    Result closed = runCycles(cycles, expectedWKC);
+    printResult("redundant, ring closed", closed, single.avg);
+
+    ec_memlink_setbroken("bench_ring", 1);
+    Result broken = runCycles(cycles, expectedWKC);
+    ec_memlink_setbroken("bench_ring", 0);
+    printResult("redundant, line break", broken, single.avg);
+    printf("line breaks %u, resends %u, resend time %.2f us/cycle\n",
+           ecx_port.redstat.linebreaks, ecx_port.redstat.resends,
+           ecx_port.redstat.extratime / 1e3 / cycles);
+    ec_close();
+
+    return 0;
+}
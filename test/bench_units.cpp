@@ -0,0 +1,126 @@
+/*
+Copyright 2021, Yang Luo"
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+@Author
+Yang Luo, PHD
+@email: yluo@hit.edu.cn
+*/
+
+
+/*-----------------------------------------------------------------------------
+ * bench_units.cpp
+ * Description              Unit conversion cost against number of axes
+ *
+ * Converts the process image of 6, 24 and 96 drives with the scalar kernel
+ * and with the vector kernel of the CPU. Every drive has position and velocity
+ * (int32) and torque (int16) inputs, velocity (int32) and torque (int16)
+ * outputs, laid out as in the PDOs of the drive. The results of both kernels
+ * are compared. Usage: bench_units [iterations]
+ *---------------------------------------------------------------------------*/
+
+#include <ecat_units.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+using rocos::UnitConverter;
+
+namespace {
+
+    const int inputBytes = 12;   // int32 position, int32 velocity, int16 torque, uint16 statusword
+    const int outputBytes = 8;   // int32 target velocity, int16 target torque, uint16 controlword
+    const double countToRad = 2 * 3.14159265358979323846 / 131072; // 17 bit encoder
+
+    double nowNs() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1e9 + ts.tv_nsec;
+    }
+
+    void addInputs(UnitConverter &c, int axes) {
+        for (int a = 0; a < axes; a++) {
+            double gear = 50.0 + a;
+            c.addChannel(a * inputBytes, UnitConverter::INT32, countToRad, 0.01 * a, gear); // rad
+            c.addChannel(a * inputBytes + 4, UnitConverter::INT32, countToRad, 0.0, gear);  // rad/s
+            c.addChannel(a * inputBytes + 8, UnitConverter::INT16, 0.001 * 2.5, 0.0);  // Nm
+        }
+    }
+
+    void addOutputs(UnitConverter &c, int axes) {
+        for (int a = 0; a < axes; a++) {
+            double gear = 50.0 + a;
+            c.addChannel(a * outputBytes, UnitConverter::INT32, countToRad, 0.0, gear);
+            c.addChannel(a * outputBytes + 4, UnitConverter::INT16, 0.001 * 2.5, 0.0);
+        }
+    }
+
+    /** ns per call of f */
+    template<typename F>
+    double measure(int iterations, F f) {
+        double t0 = nowNs();
+        for (int i = 0; i < iterations; i++)
+            f();
+        return (nowNs() - t0) / iterations;
+    }
+
+}
+
+int main(int argc, char *argv[]) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 200000;
+    const int sizes[] = {6, 24, 96};
+
+    printf("%d iterations, vector kernel: %s\n", iterations, UnitConverter(4).kernel());
+
+    for (int axes: sizes) {
+        std::vector<uint8_t> in(axes * inputBytes), out(axes * outputBytes), outScalar(axes * outputBytes);
+        for (size_t i = 0; i < in.size(); i++)
+            in[i] = (uint8_t) rand();
+
+        UnitConverter scalarIn(in.size(), false), vectorIn(in.size());
+        UnitConverter scalarOut(out.size(), false), vectorOut(out.size());
+        addInputs(scalarIn, axes);
+        addInputs(vectorIn, axes);
+        addOutputs(scalarOut, axes);
+        addOutputs(vectorOut, axes);
+
+        std::vector<double> units(scalarIn.size()), unitsScalar(scalarIn.size());
+        std::vector<double> commands(scalarOut.size());
+        for (size_t i = 0; i < commands.size(); i++)
+            commands[i] = (rand() % 20001 - 10000) * 0.01;
+
+        /* both kernels give the same result */
+        scalarIn.toUnits(in.data(), unitsScalar.data());
+        vectorIn.toUnits(in.data(), units.data());
+        scalarOut.toRaw(commands.data(), outScalar.data());
+        vectorOut.toRaw(commands.data(), out.data());
+        bool same = (memcmp(units.data(), unitsScalar.data(), units.size() * sizeof(double)) == 0) &&
+                    (out == outScalar);
+
+        double tScalarIn = measure(iterations, [&] { scalarIn.toUnits(in.data(), units.data()); });
+        double tVectorIn = measure(iterations, [&] { vectorIn.toUnits(in.data(), units.data()); });
+        double tScalarOut = measure(iterations, [&] { scalarOut.toRaw(commands.data(), out.data()); });
+        double tVectorOut = measure(iterations, [&] { vectorOut.toRaw(commands.data(), out.data()); });
+
+        printf("%3d axes: inputs %3d ch  scalar %7.1f ns  %-6s %7.1f ns  outputs %3d ch  scalar %7.1f ns  %-6s %7.1f ns"
+               "  %s\n",
+               axes, scalarIn.size(), tScalarIn, vectorIn.kernel(), tVectorIn, scalarOut.size(), tScalarOut,
+               vectorOut.kernel(), tVectorOut, same ? "results equal" : "RESULTS DIFFER");
+    }
+
+    return 0;
+}
@@ -0,0 +1,183 @@
+/*
+Copyright 2021, Yang Luo"
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+@Author
+Yang Luo, PHD
+@email: yluo@hit.edu.cn
+*/
+
+
+/*-----------------------------------------------------------------------------
+ * link_test.cpp
+ * Description              Process data cycle over simulated slaves
+ *
+ * Work counter, cable redundancy and direct receive of the inputs, run over
+ * in-process mem links, so no network is needed.
+ *---------------------------------------------------------------------------*/
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <test/doctest.h>
+
+#include "sim_bus.h"
+
+using namespace sim;
+
+namespace {
+
+    const int slaves = 4;
+    const int pdbytes = 64;
+
+    uint8 IOmap[2 * pdbytes];
+
+    /** Slave list to the simulated group, each slave has an equal part of the image. */
+    void setupSlaves() {
+        int bytes = pdbytes / slaves;
+
+        ec_slavecount = slaves;
+        for (int i = 1; i <= slaves; i++) {
+            ec_slave[i].group = 0;
+            ec_slave[i].Obits = 8 * bytes;
+            ec_slave[i].Obytes = bytes;
+            ec_slave[i].outputs = ec_group[0].outputs + (i - 1) * bytes;
+            ec_slave[i].Ibits = 8 * bytes;
+            ec_slave[i].Ibytes = bytes;
+            ec_slave[i].inputs = ec_group[0].inputs + (i - 1) * bytes;
+        }
+    }
+
+    int exchange() {
+        ec_send_processdata();
+        return ec_receive_processdata(EC_TIMEOUTRET);
+    }
+
+    bool imageIs(const std::vector<uint8> &image, uint8 value) {
+        return std::all_of(image.begin(), image.end(), [value](uint8 v) { return v == value; });
+    }
+}
+
+TEST_CASE("work counter of the simulated slaves") {
+    SimBus bus(slaves);
+    ec_memlink_sethook("link_test_wkc", simHook, &bus);
+    REQUIRE(ec_init("mem:link_test_wkc"));
+    int expectedWKC = setupGroup(slaves, pdbytes, pdbytes, IOmap);
+    REQUIRE(expectedWKC == 3 * slaves);
+    setupSlaves();
+
+    CHECK(exchange() == expectedWKC);
+    REQUIRE(ec_group[0].plan.nframes == 1);
+    CHECK(ec_group[0].plan.frame[0].expectedwkc == expectedWKC);
+    for (int i = 1; i <= slaves; i++)
+        CHECK(ecx_plan_slavewkc(&ecx_context, 0, 0, i) == 3);
+
+    bus.dead = 1;
+    CHECK(exchange() == expectedWKC - 3);
+    CHECK(ec_group[0].plan.frame[0].wkc == expectedWKC - 3);
+
+    bus.dead = 0;
+    CHECK(exchange() == expectedWKC);
+    ec_slavecount = 0;
+    ec_close();
+}
+
+TEST_CASE("line break on a redundant ring") {
+    SimBus bus(slaves, true);
+    ec_memlink_sethook("link_test_ring", simHook, &bus);
+    char if2name[] = "mem:link_test_ring";
+    REQUIRE(ec_init_redundant("mem:link_test_ring", if2name));
+    int expectedWKC = setupGroup(slaves, pdbytes, pdbytes, IOmap);
+
+    uint32 linebreaks = ecx_port.redstat.linebreaks;
+
+    SUBCASE("closed ring") {
+        CHECK(exchange() == expectedWKC);
+        CHECK_FALSE(ecx_port.redstat.linebreak);
+        CHECK(ecx_port.redstat.linebreaks == linebreaks);
+    }
+
+    SUBCASE("open ring") {
+        ec_memlink_setbroken("link_test_ring", 1);
+        /* each side of the break processes the frames of its port */
+        CHECK(exchange() == expectedWKC);
+        CHECK(ecx_port.redstat.linebreak);
+        CHECK(ecx_port.redstat.linebreaks == linebreaks + 1);
+        CHECK(ecx_port.redstat.rxports == (EC_REDRX_PRIMARY | EC_REDRX_SECONDARY));
+
+        ec_memlink_setbroken("link_test_ring", 0);
+        CHECK(exchange() == expectedWKC);
+        CHECK_FALSE(ecx_port.redstat.linebreak);
+    }
+    ec_close();
+}
+
+TEST_CASE("direct receive keeps the image on a low work counter") {
+    SimBus bus(slaves);
+    ec_memlink_sethook("link_test_rx", simHook, &bus);
+    REQUIRE(ec_init("mem:link_test_rx"));
+    int expectedWKC = setupGroup(slaves, pdbytes, pdbytes, IOmap);
+    setupSlaves();
+    bus.inputs = ec_group[0].logstartaddr + pdbytes;
+
+    std::vector<uint8> image(pdbytes, 0);
+    ec_set_inputs_destination(0, image.data());
+
+    bus.value = 1;
+    CHECK(exchange() == expectedWKC);
+    CHECK(ec_group[0].plan.rxframes == 1);
+    CHECK(imageIs(image, 1));
+
+    /* one slave lost, the others still write their inputs */
+    bus.value = 2;
+    bus.dead = 1;
+    CHECK(exchange() < expectedWKC);
+    CHECK(ec_group[0].plan.rxframes == 0);
+    CHECK(imageIs(image, 1));
+
+    bus.dead = 0;
+    CHECK(exchange() == expectedWKC);
+    CHECK(ec_group[0].plan.rxframes == 1);
+    CHECK(imageIs(image, 2));
+
+    ec_set_inputs_destination(0, nullptr);
+    ec_slavecount = 0;
+    ec_close();
+}
+
+TEST_CASE("redundant receive keeps the image on a low work counter") {
+    SimBus bus(slaves, true);
+    ec_memlink_sethook("link_test_redrx", simHook, &bus);
+    char if2name[] = "mem:link_test_redrx";
+    REQUIRE(ec_init_redundant("mem:link_test_redrx", if2name));
+    int expectedWKC = setupGroup(slaves, pdbytes, pdbytes, IOmap);
+    setupSlaves();
+    bus.inputs = ec_group[0].logstartaddr + pdbytes;
+
+    /* frames of both ports are merged in the rx buffers and copied from there */
+    std::vector<uint8> image(pdbytes, 0);
+    ec_set_inputs_destination(0, image.data());
+
+    bus.value = 1;
+    CHECK(exchange() == expectedWKC);
+    CHECK(imageIs(image, 1));
+
+    bus.value = 2;
+    bus.dead = 1;
+    CHECK(exchange() < expectedWKC);
+    CHECK(ec_group[0].plan.rxframes == 0);
+    CHECK(imageIs(image, 1));
+
+    ec_set_inputs_destination(0, nullptr);
+    ec_slavecount = 0;
+    ec_close();
+}
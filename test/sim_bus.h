@@ -0,0 +1,174 @@
+/*
+Copyright 2021, Yang Luo"
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+@Author
+Yang Luo, PHD
+@email: yluo@hit.edu.cn
+*/
+
+
+/*-----------------------------------------------------------------------------
+ * sim_bus.h
+ * Description              Simulated slaves behind an in-process mem link
+ *
+ * Shared by the benchmarks and the tests. The slaves only process logical
+ * datagrams: they add their work counter and write their inputs, so the
+ * process data cycle of the legacy API can run without a network.
+ *---------------------------------------------------------------------------*/
+
+#ifndef ROCOS_SOEM_SIM_BUS_H
+#define ROCOS_SOEM_SIM_BUS_H
+
+#include "ethercat.h"
+#include "linkdrv.h"
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+namespace sim {
+
+    struct SimBus {
+        int    slaves;          // number of simulated slaves
+        bool   ring {false};    // channel connects primary and secondary port
+        int    dead {0};        // slaves that do not process frames, f.e. after a power loss
+        uint32 inputs {0};      // logical address of the inputs, 0 = the slaves write no inputs
+        uint8  value {0};       // value the slaves write to their inputs
+
+        explicit SimBus(int slaves, bool ring = false) : slaves(slaves), ring(ring) {}
+    };
+
+    /** Slaves add their work counter to every logical datagram passing forward. */
+    inline void processFrame(uint8 *frame, int length, int slaves, const SimBus &bus) {
+        int pos = ETH_HEADERSIZE + EC_ELENGTHSIZE;
+        bool more = true;
+
+        while (more && (pos + (int) (EC_HEADERSIZE - EC_ELENGTHSIZE + EC_WKCSIZE) <= length)) {
+            uint8 cmd = frame[pos];
+            uint32 adr = frame[pos + 2] | (frame[pos + 3] << 8) | (frame[pos + 4] << 16) | ((uint32) frame[pos + 5] << 24);
+            uint16 dlength = frame[pos + 6] | (frame[pos + 7] << 8);
+            int len = dlength & 0x07ff;
+            more = (dlength & 0x8000) != 0;
+            int dpos = pos + EC_HEADERSIZE - EC_ELENGTHSIZE;
+            int wpos = dpos + len;
+            if (wpos + (int) EC_WKCSIZE > length)
+                break;
+            int inc = 0;
+            if (cmd == EC_CMD_LRW)
+                inc = 3 * slaves;
+            else if ((cmd == EC_CMD_LRD) || (cmd == EC_CMD_LWR) || (cmd == EC_CMD_BRD))
+                inc = slaves;
+            if (slaves && bus.inputs && ((cmd == EC_CMD_LRW) || (cmd == EC_CMD_LRD))) {
+                for (int i = 0; i < len; i++) {
+                    if (adr + i >= bus.inputs)
+                        frame[dpos + i] = bus.value;
+                }
+            }
+            uint16 wkc = (frame[wpos] | (frame[wpos + 1] << 8)) + inc;
+            frame[wpos] = wkc & 0xff;
+            frame[wpos + 1] = wkc >> 8;
+            pos = wpos + EC_WKCSIZE;
+        }
+    }
+
+    /**
+     * Mem link hook, arg is the SimBus. Frames leaving the primary port pass
+     * all slaves. Frames leaving the secondary port pass the slaves backwards,
+     * which does not process them. On a line break each port gets its frames
+     * back, processed by the slaves on its side of the break.
+     */
+    inline int simHook(void *frame, int length, int from, int to, void *arg) {
+        const SimBus *bus = static_cast<const SimBus *>(arg);
+        int alive = bus->slaves - bus->dead;
+
+        if (!bus->ring || (from == 0 && to == 1))
+            processFrame(static_cast<uint8 *>(frame), length, alive, *bus);
+        else if (from == to)
+            processFrame(static_cast<uint8 *>(frame), length, from == 0 ? alive / 2 : alive - alive / 2, *bus);
+
+        return 0;
+    }
+
+    /**
+     * Build group 0 as ec_config_map_alloc would for a process image of obytes
+     * outputs and ibytes inputs in the IOmap, every slave has data in every
+     * segment.
+     * @return expected work counter, -1 if the image does not fit EC_MAXIOSEGMENTS
+     */
+    inline int setupGroup(int slaves, int obytes, int ibytes, uint8 *IOmap) {
+        ec_groupt &grp = ec_group[0];
+        const int segsize = EC_MAXLRWDATA - EC_FIRSTDCDATAGRAM;
+
+        memset(&grp, 0, sizeof(grp));
+        grp.logstartaddr = 0x10000;
+        grp.Obytes = obytes;
+        grp.Ibytes = ibytes;
+        grp.outputs = IOmap;
+        grp.inputs = IOmap + obytes;
+        grp.Isegment = obytes / segsize;
+        grp.Ioffset = obytes % segsize;
+        int total = obytes + ibytes;
+        while (total > 0 && grp.nsegments < EC_MAXIOSEGMENTS) {
+            grp.IOsegment[grp.nsegments++] = std::min(total, segsize);
+            total -= segsize;
+        }
+        if (total > 0)
+            return -1;
+        grp.outputsWKC = slaves * grp.nsegments;
+        grp.inputsWKC = slaves * grp.nsegments;
+
+        return grp.outputsWKC * 2 + grp.inputsWKC;
+    }
+
+    inline double nowUs() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+    }
+
+    struct Result {
+        double avg, p50, p99, max;
+        int    errors;
+    };
+
+    /** Run the cycle and collect the cycle time statistics. */
+    inline Result runCycles(int cycles, int expectedWKC) {
+        std::vector<double> t;
+        t.reserve(cycles);
+        Result r{};
+
+        for (int i = 0; i < cycles; i++) {
+            double t0 = nowUs();
+            ec_send_processdata();
+            int wkc = ec_receive_processdata(EC_TIMEOUTRET);
+            t.push_back(nowUs() - t0);
+            if (wkc != expectedWKC)
+                r.errors++;
+        }
+        std::sort(t.begin(), t.end());
+        double sum = 0;
+        for (double v: t)
+            sum += v;
+        r.avg = sum / cycles;
+        r.p50 = t[cycles / 2];
+        r.p99 = t[(cycles * 99) / 100];
+        r.max = t.back();
+
+        return r;
+    }
+}
+
+#endif //ROCOS_SOEM_SIM_BUS_H
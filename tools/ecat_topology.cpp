@@ -0,0 +1,103 @@
+/*
+Copyright 2021, Yang Luo"
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+@Author
+Yang Luo, PHD
+@email: yluo@hit.edu.cn
+*/
+
+
+/*-----------------------------------------------------------------------------
+ * ecat_topology.cpp
+ * Description              Topology of a running master
+ *
+ * Renders the slave tree published by the master in shared memory: the port
+ * each slave is connected on, its linked ports, DC capability, the reference
+ * clock and the propagation delays. The time a frame spends behind a slave is
+ * the latest port time, so the slaves on the path of the largest delays are
+ * the ones that set the round trip. Usage: ecat_topology [id]
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <ecat_config.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace rocos;
+
+static EcatConfig *config = nullptr;
+static std::vector<std::vector<int>> children;
+
+/** ns a frame spends in the ports behind the entry port of a slave */
+static int32_t behind(const SlaveTopology &t) {
+    return *std::max_element(t.port_times, t.port_times + 4);
+}
+
+static void printSlave(int id, const std::string &prefix, bool last) {
+    SlaveTopology t = config->getSlaveTopology(id);
+    std::string ports;
+
+    for (int port = 0; port < 4; port++) {
+        if (t.active_ports & (1 << port)) {
+            ports += ports.empty() ? "" : ",";
+            ports += std::to_string(port);
+        }
+    }
+    printf("%s%s%d %-20.20s in %d, ports %-7s", prefix.c_str(), last ? "`-" : "+-", id,
+           config->getSlaveName(id).c_str(), t.entry_port, ports.c_str());
+    if (t.reference_clock)
+        printf(" DC reference clock, %d ns behind", behind(t));
+    else if (t.has_dc)
+        printf(" DC %6d ns, link %4d ns on port %d, %d ns behind", t.propagation_delay, t.link_delay,
+               t.parent_port, behind(t));
+    printf("\n");
+
+    for (size_t k = 0; k < children[id].size(); k++)
+        printSlave(children[id][k], prefix + (last ? "  " : "| "), k + 1 == children[id].size());
+}
+
+int main(int argc, char *argv[]) {
+    int id = argc > 1 ? atoi(argv[1]) : 0;
+
+    config = EcatConfig::getInstance(id);
+    int slaves = config->getSlaveNum();
+    int ref = config->getReferenceClock();
+
+    printf("Master %d: %d slaves, ", id, slaves);
+    if (ref >= 0)
+        printf("reference clock %d, frames spend %d ns behind it\n", ref,
+               behind(config->getSlaveTopology(ref)));
+    else
+        printf("no DC\n");
+
+    /* slaves in the order of the segment, each under its parent */
+    std::vector<int> roots;
+    children.assign(slaves, std::vector<int>());
+    for (int slave = 0; slave < slaves; slave++) {
+        int parent = config->getSlaveTopology(slave).parent;
+        if ((parent >= 0) && (parent < slaves))
+            children[parent].push_back(slave);
+        else
+            roots.push_back(slave);
+    }
+    for (size_t k = 0; k < roots.size(); k++)
+        printSlave(roots[k], "", k + 1 == roots.size());
+
+    return 0;
+}